@@ -0,0 +1,60 @@
+// allocstats.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Allocation accounting : with MVBTN_ALLOCSTATS defined, replaces the global operator new/delete (include it in one
+// translation unit only). Each block carries its size in a header, so frees are accounted for too : live bytes, and
+// their peak. Without it, allocations cost nothing more and the counts stay 0 (allocStats::on : false).
+//
+//   allocStats::snap a = allocStats::now();  ..  auto d = allocStats::now() - a;  // d.count allocations, d.bytes ..
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+
+struct allocStats{
+#ifdef MVBTN_ALLOCSTATS
+  static constexpr bool on = true;
+#else
+  static constexpr bool on = false;
+#endif
+  static inline std::atomic<unsigned long long> count{ 0 }, frees{ 0 }, bytes{ 0 }, live{ 0 }, peak{ 0 };
+  struct snap{ unsigned long long count, frees, bytes, live, peak;
+    snap operator-(const snap &o) const { return { count-o.count, frees-o.frees, bytes-o.bytes, live, peak }; } };
+  static snap now(){ return { count.load(), frees.load(), bytes.load(), live.load(), peak.load() }; }
+  static void resetPeak(){ peak = live.load(); }
+};
+
+#ifdef MVBTN_ALLOCSTATS
+static const size_t allocHdr = alignof(std::max_align_t) < sizeof(size_t) ? sizeof(size_t) : alignof(std::max_align_t);
+
+inline void* allocCounted(size_t n, bool nothrow){
+  void *p;
+  while(nullptr == (p = malloc(n + allocHdr))){
+    std::new_handler h = std::get_new_handler();
+    if(h) h(); else if(nothrow) return nullptr; else throw std::bad_alloc();
+  }
+  *(size_t*) p = n;
+  allocStats::count++; allocStats::bytes += n;
+  unsigned long long l = allocStats::live += n, pk = allocStats::peak.load();
+  while(l > pk && !allocStats::peak.compare_exchange_weak(pk, l));
+  return (char*) p + allocHdr;
+}
+inline void freeCounted(void *p){
+  if(!p) return;
+  p = (char*) p - allocHdr;
+  allocStats::frees++; allocStats::live -= *(size_t*) p;
+  free(p);
+}
+
+void* operator new(size_t n){ return allocCounted(n, false); }
+void* operator new[](size_t n){ return allocCounted(n, false); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { try{ return allocCounted(n, true); } catch(...){ return nullptr; } }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { try{ return allocCounted(n, true); } catch(...){ return nullptr; } }
+void operator delete(void *p) noexcept { freeCounted(p); }
+void operator delete[](void *p) noexcept { freeCounted(p); }
+void operator delete(void *p, size_t) noexcept { freeCounted(p); }
+void operator delete[](void *p, size_t) noexcept { freeCounted(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { freeCounted(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { freeCounted(p); }
+#endif
@@ -0,0 +1,96 @@
+// batch.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Batch of operations (--batch <file>) : one per line, its arguments as in a response file (optArgs::tokenize(), opt.hpp
+// included before : blank-separated, "double quotes" around those with blanks, # : comment to end of line). After each operation done, a checkpoint : how many
+// are done, the groups they changed with their hash once changed (snapshot.hpp), and the logon session. A run
+// interrupted is resumed (--resume) from the first operation not done, once those groups are found as they were left.
+//
+// Checkpoint file : "MVCK" then numbers as LEB128 varints, strings as length + UTF-16 code units :
+//   ops done session  then per group : tb appId hash      ops : hash of the operations done, appId "" : the group order
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <filesystem>
+
+using namespace std;
+
+struct batchLine{ int line = 0; vector<string> args; };
+
+inline vector<batchLine> batchParse(const string &text){
+  vector<batchLine> v; int line = 0;
+  for(size_t at = 0, end; at < text.size(); at = end + 1){
+    end = text.find('\n', at); if(end == string::npos) end = text.size();
+    batchLine b{ ++line, {} }; string s = text.substr(at, end - at);
+    optArgs::tokenize(s.data(), s.data() + s.size(), [&b](char *arg, char *w){ b.args.emplace_back(arg, w); });
+    if(!b.args.empty()) v.push_back(move(b));
+  }
+  return v;
+}
+
+// Hash of the first n operations (their arguments) : those not done yet can be changed before a resume
+inline uint64_t batchHashOps(const vector<batchLine> &lines, size_t n){
+  uint64_t h = 0xCBF29CE484222325ull;
+  for(size_t i = 0; i < n && i < lines.size(); i++){ for(auto &a : lines[i].args) h = snapHashBytes(h, a.c_str(), a.size()+1); h = snapHashBytes(h, "\n", 1); }
+  return h;
+}
+
+// Hash of group appId in s (0 : none), appId "" : of the order of the groups
+inline uint64_t batchHashOf(const snapshot &s, const wstring &appId){
+  if(appId.empty()){ uint64_t h = 0xCBF29CE484222325ull; for(auto &g : s.groups) h = snapHashStr(h, g.appId); return h; }
+  for(auto &g : s.groups) if(g.appId == appId) return g.hash;
+  return 0;
+}
+// Groups an operation changed (its undo session), and their hash in after (snapRehash()'d)
+inline vector<pair<wstring, uint64_t>> batchChanged(const snapshot &after, const undoSession &ss){
+  vector<pair<wstring, uint64_t>> v;
+  for(auto &id : ss.appIds) v.emplace_back(id, batchHashOf(after, id));
+  if(any_of(ss.ops.begin(), ss.ops.end(), [](const undoOp &op){ return op.kind=='G'; })) v.emplace_back(L"", batchHashOf(after, L""));
+  return v;
+}
+
+struct batchCheckpoint{
+  uint64_t ops = 0, done = 0;  // ops : batchHashOps() of those done, done : the next one's index
+  uint32_t session = 0;
+  map<pair<uint32_t, wstring>, uint64_t> groups;  // (taskbar, AppId) -> hash once last changed
+
+  bool load(const filesystem::path &p){
+    string s; if(!undoReadAll(p, s) || s.compare(0, 4, "MVCK")) return false;
+    size_t at = 4; uint64_t sess, tb, h; wstring appId;
+    if(!undoGet(s, at, ops) || !undoGet(s, at, done) || !undoGet(s, at, sess)) return false;
+    session = (uint32_t) sess; groups.clear();
+    while(at < s.size()){
+      if(!undoGet(s, at, tb) || !traceGetStr(s, at, appId) || !undoGet(s, at, h)){ groups.clear(); return false; }
+      groups[{ (uint32_t) tb, appId }] = h;
+    }
+    return true;
+  }
+  // Written aside, then renamed over the previous one : a run stopped meanwhile leaves one or the other, whole
+  bool save(const filesystem::path &p) const {
+    string s = "MVCK"; undoPut(s, ops); undoPut(s, done); undoPut(s, session);
+    for(auto &[key, h] : groups){ undoPut(s, key.first); tracePutStr(s, key.second); undoPut(s, h); }
+    error_code ec; filesystem::create_directories(p.parent_path(), ec);
+    filesystem::path tmp = p; tmp += ".tmp";
+    FILE *f = undoOpen(tmp, "wb"); if(!f) return false;
+    bool ok = fwrite(s.data(), 1, s.size(), f) == s.size();
+    if(fclose(f) || !ok) return false;
+    filesystem::rename(tmp, p, ec); return !ec;
+  }
+};
+
+// Reloads deferred : a cross-group move to a position within the target waits for TTLib to see the buttons regrouped
+// (a reload). In a batch, a run of them sets all their AppIds first, then TTLib is reloaded once and each one's buttons
+// moved to their position (regroupFlush()) : a reload for the run, not one per operation. An operation on a group the
+// run changed waits for it to be done (conflict : run again then), as does any other kind of operation.
+struct regroupMove{ uint32_t tb = 0; wstring appId; vector<HWND> hwnds; ULONG to = 0; };  // to : 1-based, within appId's group
+struct regroupRun{
+  vector<regroupMove> moves;            // repositionings pending
+  set<pair<uint32_t, wstring>> groups;  // (taskbar, AppId) changed by the run's operations
+  size_t deferred = 0, reloads = 0;     // reloads deferred (one per operation), done for the runs
+  bool conflict = false;
+
+  bool touches(uint32_t tb, const wstring &appId) const { return groups.count({ tb, appId }) > 0; }
+};
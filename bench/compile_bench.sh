@@ -0,0 +1,39 @@
+#!/bin/sh
+# compile_bench.sh
+# Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+# v0.1 2022.07
+# Compile time and code size of mv_tb_btn.cpp, simulated build (MVBTN_TTSIM, posix.hpp : any Linux compiler), at -O0
+# and -O2 : best of a few compiles, the object's .text, and processArgs() (where the option tables expand, opt.hpp).
+# With a git revision : the same for that revision's tree, side by side (one with posix.hpp : from user-033 on).
+#   bench/compile_bench.sh [revision] [compiles=3]    CXX : the compiler (default g++)
+
+cxx=${CXX:-g++}; rev=$1; n=${2:-3}
+top=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d); trap 'rm -rf "$work"' EXIT
+
+# tree opt -> "seconds text processArgs"
+measure(){
+  best=""; i=0
+  while [ $i -lt "$n" ]; do
+    t0=$(date +%s%N)
+    "$cxx" -std=c++20 -$2 -DMVBTN_TTSIM -w -c "$1/mv_tb_btn.cpp" -o "$work/o.o" || return 1
+    t1=$(date +%s%N); t=$(( (t1 - t0) / 1000000 ))
+    [ -z "$best" ] || [ $t -lt $best ] && best=$t
+    i=$((i + 1))
+  done
+  text=$(size -A "$work/o.o" | awk '$1 ~ /^\.text/ { s += $2 } END { print s }')
+  pa=$(nm -C -S -t d "$work/o.o" | awk '/ processArgs\(/ { s += $2 } END { print s + 0 }')
+  echo "$best $text $pa"
+}
+report(){  # label tree
+  for o in O0 O2; do
+    r=$(measure "$2" $o) || exit 1
+    echo "$r" | awk -v l="$1" -v o=$o '{ printf "%-12s -%s  compile %6.2f s  .text %8d B  processArgs %6d B\n", l, o, $1 / 1000, $2, $3 }'
+  done
+}
+
+if [ -n "$rev" ]; then
+  mkdir "$work/rev" && git -C "$top" archive "$rev" | tar -x -C "$work/rev" || exit 1
+  report "$rev" "$work/rev"
+fi
+report "working tree" "$top"
@@ -0,0 +1,38 @@
+#!/bin/sh
+# startup_bench.sh
+# Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+# v0.1 2022.07
+# Cold start of the simulated build (MVBTN_TTSIM) : time from main() to the first backend call (json "first_call_ms"),
+# the whole run (exec to exit), medians of a number of runs, and the binary's size (file, and its code : .text).
+# With a baseline file : rc 1 when a figure grew past its margin (sizes 5%, times 25% and 0.2 ms), -u rewrites it.
+#   bench/startup_bench.sh <mv_tb_btn_sim> [runs=200] [baseline=bench/startup.baseline] [-u]
+
+bin=$1; runs=${2:-200}; base=${3:-$(dirname "$0")/startup.baseline}; update=$4
+[ -x "$bin" ] || { echo "usage: $0 <mv_tb_btn_sim> [runs] [baseline] [-u]"; exit 2; }
+
+data=$(mktemp -d); trap 'rm -rf "$data"' EXIT
+export LOCALAPPDATA="$data" MVBTN_SIM_TASKBAR="Notepad=a.txt,b.txt,c.txt;Explorer=Docs" MVBTN_COALESCE_MS=0
+
+median(){ sort -n | awk '{ v[NR] = $1 } END { print NR ? v[int((NR+1)/2)] : 0 }'; }
+
+i=0; : > "$data/first"; : > "$data/wall"
+while [ $i -lt "$runs" ]; do
+  t0=$(date +%s%N)
+  out=$("$bin" -g Notepad -f 1 -t 3 --json)
+  t1=$(date +%s%N)
+  echo "$out" | sed -n 's/.*"first_call_ms":\([0-9.]*\).*/\1/p' >> "$data/first"
+  echo "$t0 $t1" | awk '{ printf "%.3f\n", ($2 - $1) / 1e6 }' >> "$data/wall"
+  i=$((i + 1))
+done
+
+first=$(median < "$data/first"); wall=$(median < "$data/wall")
+file=$(wc -c < "$bin" | tr -d ' '); text=$(size -A "$bin" 2>/dev/null | awk '$1 == ".text" { print $2 }')
+printf "first_call_ms %s\nrun_ms %s\nfile_bytes %s\ntext_bytes %s\n" "$first" "$wall" "$file" "${text:-0}" > "$data/now"
+echo "$runs runs (medians) :"; cat "$data/now"
+
+if [ "$update" = "-u" ]; then cp "$data/now" "$base"; echo "baseline written : $base"; exit 0; fi
+[ -f "$base" ] || exit 0
+awk 'NR == FNR { was[$1] = $2; next }
+  $1 in was { lim = $1 ~ /_ms$/ ? was[$1] * 1.25 + 0.2 : was[$1] * 1.05
+    if($2 > lim){ printf "regression : %s %s (baseline %s)\n", $1, $2, was[$1]; bad = 1 } }
+  END { exit bad }' "$base" "$data/now"
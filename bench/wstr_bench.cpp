@@ -0,0 +1,75 @@
+// wstr_bench.cpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// wstrFindI() (wstr.hpp) against a StrStrIW()-like search (towlower() on every code unit, at every position) and its own
+// scalar loop, over a long list of AppIds, in UTF-16 (char16_t, as WCHAR on Windows). Both must find the same first match everywhere.
+//   wstr_bench [AppIds=4000] [rounds=200]    rc 0 : same positions (times : stdout)
+
+#include "../wstr.hpp"
+#include <cwctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// What group resolution did before : fold both sides with towlower() (the C locale : ASCII only, as the needles here)
+static ptrdiff_t refFindI(const char16_t *hay, size_t n, const char16_t *pat, size_t m){
+  if(m > n) return m ? -1 : 0;
+  for(size_t i = 0; i + m <= n; i++){
+    size_t k = 0; while(k < m && towlower(hay[i+k]) == towlower(pat[k])) k++;
+    if(k == m) return (ptrdiff_t) i;
+  }
+  return -1;
+}
+// wstrFindI() without its SSE2 filter : the same folding, a code unit at a time
+static ptrdiff_t scalarFindI(const char16_t *hay, size_t n, const char16_t *pat, size_t m){
+  if(m > n) return m ? -1 : 0;
+  const char16_t f0 = wstrFold(pat[0]);
+  for(size_t i = 0; i + m <= n; i++) if(wstrFold(hay[i]) == f0){
+    size_t k = 1; while(k < m && wstrFold(hay[i+k]) == wstrFold(pat[k])) k++;
+    if(k == m) return (ptrdiff_t) i;
+  }
+  return -1;
+}
+
+int main(int argc, char **argv){
+  size_t nIds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4000, rounds = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200;
+  const char *vendors[] = { "Microsoft", "Mozilla", "Google", "JetBrains", "Adobe", "VideoLAN", "Notepad++", "7-Zip" };
+  const char *apps[] = { "Windows.Explorer", "Office.EXCEL.EXE.15", "Firefox.308046B0AF4A39CB", "Chrome.UserData.Default",
+    "IntelliJIdea.2022.1", "Acrobat.Reader.DC", "VLC.MediaPlayer", "Editor.Plugins" };
+  vector<u16string> ids; srand(7);
+  for(size_t i = 0; i < nIds; i++){
+    string s = string(vendors[rand() % 8]) + "." + apps[rand() % 8] + "." + to_string(rand()) + ".Instance" + to_string(i);
+    ids.emplace_back(s.begin(), s.end());
+  }
+  vector<u16string> needles;
+  for(const char *s : { "explorer", "EXCEL", "firefox.308046b0af4a39cb", "instance3999", "zzz", "e", "chrome.userdata.DEFAULT" })
+    needles.emplace_back(s, s + strlen(s));
+
+  size_t mismatches = 0; long long sum = 0;
+  for(auto &id : ids) for(auto &p : needles){
+    ptrdiff_t a = wstrFindI(id.data(), id.size(), p.data(), p.size()), b = refFindI(id.data(), id.size(), p.data(), p.size()),
+      c = scalarFindI(id.data(), id.size(), p.data(), p.size());
+    if((a != b || a != c) && !mismatches++) printf("mismatch : %td vs %td, %td\n", a, b, c);
+  }
+
+  auto time = [&](auto find){
+    auto t0 = chrono::steady_clock::now();
+    for(size_t r = 0; r < rounds; r++) for(auto &p : needles) for(auto &id : ids) sum += find(id.data(), id.size(), p.data(), p.size());
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+  };
+  double ref = time(refFindI), scalar = time(scalarFindI), fast = time(wstrFindI<char16_t>);
+  printf("%zu AppIds x %zu needles x %zu rounds : towlower %.1f ms, scalar %.1f ms, wstrFindI %.1f ms (x%.1f, x%.1f)%s, %zu mismatches (%lld)\n",
+    nIds, needles.size(), rounds, ref, scalar, fast, ref / fast, scalar / fast,
+#ifdef WSTR_SSE2
+    " SSE2",
+#else
+    " scalar",
+#endif
+    mismatches, sum);
+  return mismatches ? 1 : 0;
+}
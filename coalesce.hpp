@@ -0,0 +1,227 @@
+// coalesce.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Session lock, and hand-over of operations between invocations running at the same moment :
+// the lock holder collects the operations of the others for a short window, runs them along with its own in one
+// session, and answers each caller. Windows : named mutex + named pipe. Elsewhere (tests) : flock() + unix socket.
+//
+//   sessLockState lk = sessLock(0);
+//   while(lk == sessBusy){                             // someone holds the session
+//     if(sessSubmit(myOp, reply)) return done(reply);  // handed over, and answered
+//     lk = sessLock(10);                               // holder gone : we hold the session now
+//   }
+//   if(lk == sessNone) windowMs = 0;                   // no lock to take : run alone, nothing handed over
+//   sessServer srv; srv.start(windowMs);   ...   for(auto &req : srv.finish()){ run(req.op); sessAnswer(req, out); }
+//   sessUnlock();
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#ifndef _WIN32
+  #include <cerrno>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <unistd.h>
+  #include <sys/file.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+#endif
+
+using namespace std;
+
+// sessLock() : held by another invocation (still, past the wait), ours, or none to take (cannot be created)
+enum sessLockState{ sessBusy, sessHeld, sessNone };
+
+// Scope of the session lock : the logon session, or narrower (a run on simulated taskbars of its own : ttsim.hpp)
+inline thread_local string sessScope;
+
+// Messages : u32 length + bytes. Same helpers for the fields of a message.
+inline void packU32(string &s, uint32_t v){ s.append((const char *) &v, 4); }
+inline void packStr(string &s, const void *p, size_t n){ packU32(s, (uint32_t) n); if(n) s.append((const char *) p, n); }
+inline bool unpackU32(const string &s, size_t &at, uint32_t &v){
+  if(at+4 > s.size()) return false;
+  memcpy(&v, s.data()+at, 4); at += 4; return true;
+}
+inline bool unpackStr(const string &s, size_t &at, string &v){
+  uint32_t n; if(!unpackU32(s, at, n) || at+n > s.size()) return false;
+  v.assign(s, at, n); at += n; return true;
+}
+
+#ifdef _WIN32
+typedef HANDLE sessConn;
+static const sessConn sessNoConn = INVALID_HANDLE_VALUE;
+static thread_local HANDLE sessMutex = nullptr;  // held by the thread running the session
+
+// Logon session : the scope of the session lock, and of batch checkpoints
+inline uint32_t sessId(){ DWORD sid = 0; ProcessIdToSessionId(GetCurrentProcessId(), &sid); return sid; }
+inline wstring sessName(){
+  return L"mv_tb_btn.session." + to_wstring(sessId()) + (sessScope.empty() ? L"" : L"." + wstring(sessScope.begin(), sessScope.end()));
+}
+inline wstring sessPipe(){ return L"\\\\.\\pipe\\" + sessName(); }
+
+// Overlapped read/write of n bytes (works on both overlapped and plain handles), false on error or timeout
+inline bool sessIO(HANDLE h, bool write, char *buf, DWORD n, DWORD ms){
+  while(n){
+    OVERLAPPED ov{}; ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr); DWORD done = 0;
+    BOOL ok = write ? WriteFile(h, buf, n, nullptr, &ov) : ReadFile(h, buf, n, nullptr, &ov);
+    if(!ok && GetLastError()==ERROR_IO_PENDING){
+      if(WAIT_OBJECT_0 != WaitForSingleObject(ov.hEvent, ms)){ CancelIo(h); GetOverlappedResult(h, &ov, &done, TRUE); CloseHandle(ov.hEvent); return false; }
+      ok = TRUE;
+    }
+    ok = ok && GetOverlappedResult(h, &ov, &done, FALSE); CloseHandle(ov.hEvent);
+    if(!ok || done==0) return false;
+    buf += done; n -= done;
+  }
+  return true;
+}
+inline void sessClose(sessConn c){ if(c != sessNoConn){ FlushFileBuffers(c); DisconnectNamedPipe(c); CloseHandle(c); } }
+
+// Session lock, waiting up to ms. An abandoned lock (holder crashed) is ours.
+inline sessLockState sessLock(DWORD ms){
+  if(!sessMutex && !(sessMutex = CreateMutexW(nullptr, FALSE, (L"Local\\" + sessName()).c_str()))) return sessNone;
+  DWORD rc = WaitForSingleObject(sessMutex, ms);
+  return rc==WAIT_OBJECT_0 || rc==WAIT_ABANDONED ? sessHeld : rc==WAIT_TIMEOUT ? sessBusy : sessNone;
+}
+inline void sessUnlock(){ if(sessMutex){ ReleaseMutex(sessMutex); CloseHandle(sessMutex); sessMutex = nullptr; } }
+
+#else
+typedef int sessConn;
+static const sessConn sessNoConn = -1;
+static thread_local int sessLockFd = -1;  // held by the thread running the session
+
+inline uint32_t sessId(){ return (uint32_t) getuid(); }
+inline string sessPath(LPCSTR ext){
+  LPCSTR dir = getenv("XDG_RUNTIME_DIR");
+  return string(dir ? dir : "/tmp") + "/mv_tb_btn.session." + to_string(sessId()) + (sessScope.empty() ? "" : "." + sessScope) + ext;
+}
+inline bool sessIO(int fd, bool write, char *buf, DWORD n, DWORD ms){
+  while(n){
+    pollfd pfd{ fd, (short) (write ? POLLOUT : POLLIN), 0 };
+    if(poll(&pfd, 1, ms==INFINITE ? -1 : (int) ms) <= 0) return false;
+    ssize_t done = write ? ::write(fd, buf, n) : ::read(fd, buf, n);
+    if(done <= 0) return false;
+    buf += done; n -= (DWORD) done;
+  }
+  return true;
+}
+inline void sessClose(sessConn c){ if(c != sessNoConn) close(c); }
+
+inline sessLockState sessLock(DWORD ms){
+  if(sessLockFd < 0 && (sessLockFd = open(sessPath(".lock").c_str(), O_RDWR | O_CREAT, 0600)) < 0) return sessNone;
+  auto until = chrono::steady_clock::now() + chrono::milliseconds(ms);
+  for(;;){
+    if(0 == flock(sessLockFd, LOCK_EX | LOCK_NB)) return sessHeld;
+    if(errno != EWOULDBLOCK && errno != EINTR){ close(sessLockFd); sessLockFd = -1; return sessNone; }
+    if(chrono::steady_clock::now() >= until) return sessBusy;
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+}
+inline void sessUnlock(){ if(sessLockFd >= 0){ flock(sessLockFd, LOCK_UN); close(sessLockFd); sessLockFd = -1; } }
+#endif
+
+inline bool sessSend(sessConn c, const string &msg, DWORD ms = INFINITE){
+  uint32_t n = (uint32_t) msg.size();
+  return sessIO(c, true, (char *) &n, 4, ms) && (n==0 || sessIO(c, true, (char *) msg.data(), n, ms));
+}
+inline bool sessRecv(sessConn c, string &msg, DWORD ms = INFINITE){
+  uint32_t n = 0; if(!sessIO(c, false, (char *) &n, 4, ms) || n > (64u << 20)) return false;
+  msg.resize(n); return n==0 || sessIO(c, false, msg.data(), n, ms);
+}
+
+// Hand an operation over to the session holder, and wait for its answer. False : no holder listening (anymore).
+inline bool sessSubmit(const string &op, string &reply){
+#ifdef _WIN32
+  wstring pipe = sessPipe();
+  HANDLE h = CreateFileW(pipe.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+  if(h==INVALID_HANDLE_VALUE && WaitNamedPipeW(pipe.c_str(), 20))
+    h = CreateFileW(pipe.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+  if(h==INVALID_HANDLE_VALUE) return false;
+  bool ok = sessSend(h, op) && sessRecv(h, reply);
+  CloseHandle(h);
+#else
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0); if(fd < 0) return false;
+  sockaddr_un addr{}; addr.sun_family = AF_UNIX;
+  string path = sessPath(".sock"); strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+  bool ok = 0==connect(fd, (sockaddr *) &addr, sizeof(addr)) && sessSend(fd, op) && sessRecv(fd, reply);
+  close(fd);
+#endif
+  return ok;
+}
+
+struct sessRequest{ sessConn conn; string op; };
+
+// Collects operations handed over by other invocations, in the background, until the window closes
+class sessServer{
+  thread th; mutex mx; atomic<bool> stop{ false };
+  vector<sessRequest> reqs;
+  string scope;  // sessScope of the thread that started it
+  chrono::steady_clock::time_point deadline;
+
+  DWORD msLeft(){
+    auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+    return left > 0 ? (DWORD) left : 0;
+  }
+  void take(sessConn c){
+    string op; if(!sessRecv(c, op, 1000)){ sessClose(c); return; }
+    lock_guard<mutex> lk(mx); reqs.push_back({ c, move(op) });
+  }
+  void collect(){
+    sessScope = scope;
+#ifdef _WIN32
+    wstring pipe = sessPipe();
+    while(!stop && msLeft()){
+      HANDLE h = CreateNamedPipeW(pipe.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+        PIPE_UNLIMITED_INSTANCES, 1 << 16, 1 << 16, 0, nullptr);
+      if(h==INVALID_HANDLE_VALUE) return;
+      OVERLAPPED ov{}; ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+      BOOL connected = ConnectNamedPipe(h, &ov); DWORD err = GetLastError(), done;
+      if(!connected) connected = err==ERROR_PIPE_CONNECTED;
+      if(!connected && err==ERROR_IO_PENDING){
+        if(WAIT_OBJECT_0 == WaitForSingleObject(ov.hEvent, msLeft())) connected = GetOverlappedResult(h, &ov, &done, FALSE);
+        else{ CancelIo(h); GetOverlappedResult(h, &ov, &done, TRUE); }
+      }
+      CloseHandle(ov.hEvent);
+      if(connected) take(h); else CloseHandle(h);
+    }
+#else
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0); if(fd < 0) return;
+    sockaddr_un addr{}; addr.sun_family = AF_UNIX;
+    string path = sessPath(".sock"); strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+    unlink(path.c_str());  // we hold the lock : any socket left is stale
+    if(0!=bind(fd, (sockaddr *) &addr, sizeof(addr)) || 0!=listen(fd, 16)){ close(fd); return; }
+    while(!stop && msLeft()){
+      pollfd pfd{ fd, POLLIN, 0 };
+      if(poll(&pfd, 1, (int) msLeft()) <= 0) continue;
+      int c = accept(fd, nullptr, nullptr); if(c >= 0) take(c);
+    }
+    close(fd); unlink(path.c_str());
+#endif
+  }
+
+public:
+  void start(DWORD windowMs){
+    deadline = chrono::steady_clock::now() + chrono::milliseconds(windowMs); scope = sessScope;
+    if(windowMs) th = thread(&sessServer::collect, this);
+  }
+  // Waits for the window to close, returns the operations collected
+  vector<sessRequest> finish(){
+    if(th.joinable()){ this_thread::sleep_for(chrono::milliseconds(msLeft())); stop = true; th.join(); }
+    lock_guard<mutex> lk(mx); return move(reqs);
+  }
+  ~sessServer(){ stop = true; if(th.joinable()) th.join(); }
+};
+
+// Answer to a caller : rc + its stdout and stderr text
+inline void sessAnswer(sessRequest &req, int rc, const string &out, const string &err){
+  string reply; packU32(reply, (uint32_t) rc); packStr(reply, out.data(), out.size()); packStr(reply, err.data(), err.size());
+  sessSend(req.conn, reply, 5000); sessClose(req.conn); req.conn = sessNoConn;
+}
+inline bool sessAnswered(const string &reply, int &rc, string &out, string &err){
+  size_t at = 0; uint32_t u;
+  if(!unpackU32(reply, at, u) || !unpackStr(reply, at, out) || !unpackStr(reply, at, err)) return false;
+  rc = (int) u; return true;
+}
@@ -0,0 +1,93 @@
+// deadline.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Time limits of a run, in total and per phase (load, enumerate, execute, snapshot, unload), kept by a watchdog thread.
+// Past a limit the run is cancelled : the operation stops at its next safe point (cancelled() checked between backend
+// calls) and goes through the unload path. Stuck in a backend call instead, it gets graceMs, then the watchdog runs
+// onHang (the unload path) itself, and ends the process with rcTimeout graceMs later.
+//
+//   deadlines d; deadlinesParse("load=3000,total=10000", d);
+//   watchdog wd; wd.onHang = unload; wd.onExit = flush;  wd.start(d);  wd.phase("load");  ..  wd.finish();
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+
+using namespace std;
+
+static const int rcTimeout = 124;  // as timeout(1)
+
+struct deadlines{ DWORD total = 0; vector<pair<string, DWORD>> phases; };  // ms, 0 : none
+
+// "8000" : 8 s in total.  "load=3000,execute=5000,total=10000" : per phase, and in total. False if malformed.
+inline bool deadlinesParse(const string &spec, deadlines &d){
+  d = {}; size_t at = 0;
+  do{
+    size_t end = spec.find(',', at); if(end == string::npos) end = spec.size();
+    string item = spec.substr(at, end-at); size_t eq = item.find('=');
+    string name = eq == string::npos ? "total" : item.substr(0, eq), val = eq == string::npos ? item : item.substr(eq+1);
+    if(val.empty() || name.empty() || val.find_first_not_of("0123456789") != string::npos) return false;  // no sign, no blanks
+    errno = 0; unsigned long long ms = strtoull(val.c_str(), nullptr, 10);
+    if(errno == ERANGE || ms > 0xFFFFFFFFull) return false;  // a DWORD
+    if(name == "total") d.total = (DWORD) ms; else d.phases.emplace_back(name, (DWORD) ms);
+    at = end+1;
+  } while(at <= spec.size());
+  return true;
+}
+
+class watchdog{
+  using clock = chrono::steady_clock;
+  thread th; mutex mx; condition_variable cv;
+  deadlines lim; clock::time_point runEnd, phaseEnd; string cur, hit;
+  bool done = true; atomic<bool> expired{ false }, unloading{ false };
+
+  void watch(){
+    unique_lock<mutex> lk(mx);
+    while(!done){
+      auto until = min(runEnd, phaseEnd);
+      if(until == clock::time_point::max()){ cv.wait(lk); continue; }
+      cv.wait_until(lk, until);
+      if(done || clock::now() < min(runEnd, phaseEnd)) continue;  // finished, or phase changed
+      hit = clock::now() >= phaseEnd ? cur : "total"; expired = true;
+      if(cv.wait_for(lk, chrono::milliseconds(graceMs), [this]{ return done; })) return;
+      if(!unloading && onHang) thread(onHang).detach();  // stuck in a backend call
+      if(cv.wait_for(lk, chrono::milliseconds(graceMs), [this]{ return done; })) return;
+      lk.unlock(); if(onExit) onExit();
+      fflush(stdout); fflush(stderr); _Exit(rcTimeout);
+    }
+  }
+
+public:
+  function<void()> onHang, onExit; DWORD graceMs = 2000;
+
+  void start(const deadlines &d){
+    finish();
+    lock_guard<mutex> lk(mx);
+    lim = d; done = false; expired = false; unloading = false; cur.clear(); hit.clear();
+    runEnd = d.total ? clock::now() + chrono::milliseconds(d.total) : clock::time_point::max(); phaseEnd = clock::time_point::max();
+    if(d.total || !d.phases.empty()) th = thread(&watchdog::watch, this);
+  }
+  // Entering a phase : its limit (if any) starts
+  void phase(const char *name){
+    lock_guard<mutex> lk(mx);
+    unloading = string(name) == "unload"; if(expired) return;
+    cur = name; phaseEnd = clock::time_point::max();
+    for(auto &[p, ms] : lim.phases) if(p == cur && ms) phaseEnd = clock::now() + chrono::milliseconds(ms);
+    cv.notify_all();
+  }
+  bool cancelled() const { return expired; }
+  string expiredIn(){ lock_guard<mutex> lk(mx); return hit; }
+  void finish(){
+    { lock_guard<mutex> lk(mx); done = true; } cv.notify_all();
+    if(th.joinable()) th.join();
+  }
+  ~watchdog(){ finish(); }
+};
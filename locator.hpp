@@ -0,0 +1,80 @@
+// locator.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Button locator : window -> (group, position), title -> windows. Built with the enumeration (build()), kept in step
+// with the moves made (moved(), groupMoved()) : selectors resolve without scanning the groups. A title pattern (* and ?,
+// case insensitive : wstrFold(), wstr.hpp included before) is tried on each distinct title once.
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+using namespace std;
+
+// Wildcard match : * any run, ? any character, case insensitive (backtracks to the last * only : linear in practice)
+inline bool titleMatch(const WCHAR *p, const WCHAR *s){
+  const WCHAR *star = nullptr, *resume = nullptr;
+  while(*s){
+    if(*p == L'*'){ star = p++; resume = s; }
+    else if(*p == L'?' || (*p && (*p == *s || wstrFold(*p) == wstrFold(*s)))){ p++; s++; }
+    else if(star){ p = star + 1; s = ++resume; }
+    else return false;
+  }
+  while(*p == L'*') p++;
+  return !*p;
+}
+
+struct btnPos{ int grp = -1, pos = -1; };
+
+class btnLocator{
+  vector<vector<HWND>> order;                  // windows of each group, in taskbar order
+  unordered_map<HWND, btnPos> at;
+  unordered_map<wstring, vector<HWND>> titled;
+
+  bool has(int grp) const { return grp >= 0 && grp < (int) order.size(); }
+
+public:
+  void clear(){ order.clear(); at.clear(); titled.clear(); }
+  void build(const vector<vector<HWND>> &hwnds, const vector<vector<wstring>> &titles){
+    clear(); order = hwnds;
+    for(int g = 0; g < (int) order.size(); g++) for(int p = 0; p < (int) order[g].size(); p++){
+      at[order[g][p]] = { g, p };
+      if(g < (int) titles.size() && p < (int) titles[g].size()) titled[titles[g][p]].push_back(order[g][p]);
+    }
+  }
+  // Button of group grp moved from -> to (0-based) : those in between shift by one
+  void moved(int grp, int from, int to){
+    if(!has(grp)) return;
+    auto &o = order[grp]; if(from < 0 || to < 0 || from >= (int) o.size() || to >= (int) o.size()) return;
+    HWND h = o[from]; o.erase(o.begin()+from); o.insert(o.begin()+to, h);
+    for(int p = min(from, to); p <= max(from, to); p++) at[o[p]].pos = p;
+  }
+  void groupMoved(int from, int to){
+    if(!has(from) || !has(to)) return;
+    auto g = move(order[from]); order.erase(order.begin()+from); order.insert(order.begin()+to, move(g));
+    for(int i = min(from, to); i <= max(from, to); i++) for(HWND h : order[i]) at[h].grp = i;
+  }
+
+  btnPos find(HWND h) const { auto it = at.find(h); return it == at.end() ? btnPos{} : it->second; }
+  // Buttons titled title (exact), in group grp (-1 : any), by group and position
+  vector<btnPos> find(const wstring &title, int grp = -1) const {
+    vector<btnPos> v; auto it = titled.find(title); if(it == titled.end()) return v;
+    add(v, it->second, grp); return sorted(v);
+  }
+  // Buttons whose title matches pattern (titleMatch())
+  vector<btnPos> match(const wstring &pattern, int grp = -1) const {
+    vector<btnPos> v;
+    for(auto &[title, hwnds] : titled) if(titleMatch(pattern.c_str(), title.c_str())) add(v, hwnds, grp);
+    return sorted(v);
+  }
+
+private:
+  void add(vector<btnPos> &v, const vector<HWND> &hwnds, int grp) const {
+    for(HWND h : hwnds){ btnPos p = find(h); if(p.grp >= 0 && (grp < 0 || p.grp == grp)) v.push_back(p); }
+  }
+  static vector<btnPos> sorted(vector<btnPos> &v){
+    sort(v.begin(), v.end(), [](const btnPos &a, const btnPos &b){ return a.grp != b.grp ? a.grp < b.grp : a.pos < b.pos; });
+    return move(v);
+  }
+};
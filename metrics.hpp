@@ -0,0 +1,163 @@
+// metrics.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Latency histograms (HDR-style : log-linear buckets, 32 per power of 2, ~3% precision, up to 2^45 µs), per operation
+// kind and per phase, accumulated across runs in a file, and exported as text, JSON or Prometheus text format.
+//
+// File : "MVHM" then, per histogram, numbers as LEB128 varints :
+//   'O' | 'P'  name  n sum min max  nBuckets (index delta, count)..     'O' : operation kind, 'P' : phase
+
+#include <string>
+#include <vector>
+#include <map>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cinttypes>
+
+using namespace std;
+
+class latHisto{
+  static constexpr int subBits = 5, half = 1 << subBits, nBuckets = 40;
+  static constexpr uint64_t top = (1ull << (nBuckets + subBits)) - 1;
+  static int index(uint64_t v){ int b = (int) bit_width(v | (2*half - 1)) - 1 - subBits; return b*half + (int) (v >> b); }
+  static uint64_t highest(int i){ int b = max(0, i/half - 1); return (((uint64_t) (i - b*half) + 1) << b) - 1; }
+
+public:
+  vector<uint64_t> counts = vector<uint64_t>((nBuckets + 1) * half);
+  uint64_t n = 0, sum = 0, lo = 0, hi = 0;  // µs
+
+  void record(uint64_t us){
+    us = min(us, top); counts[index(us)]++;
+    lo = n ? min(lo, us) : us; hi = max(hi, us); n++; sum += us;
+  }
+  void merge(const latHisto &o){
+    if(!o.n) return;
+    for(size_t i = 0; i < counts.size(); i++) counts[i] += o.counts[i];
+    lo = n ? min(lo, o.lo) : o.lo; hi = max(hi, o.hi); n += o.n; sum += o.sum;
+  }
+  // Value at quantile q (0..1) : highest value of its bucket, within [lo, hi]
+  uint64_t quantile(double q) const {
+    if(!n) return 0;
+    uint64_t rank = max<uint64_t>(1, (uint64_t) ceil(q * (double) n)), c = 0;
+    for(size_t i = 0; i < counts.size(); i++) if((c += counts[i]) >= rank) return max(lo, min(hi, highest((int) i)));
+    return hi;
+  }
+
+  void put(string &s) const {
+    undoPut(s, n); undoPut(s, sum); undoPut(s, lo); undoPut(s, hi);
+    size_t nz = 0; for(auto c : counts) nz += c != 0; undoPut(s, nz);
+    size_t last = 0; for(size_t i = 0; i < counts.size(); i++) if(counts[i]){ undoPut(s, i - last); undoPut(s, counts[i]); last = i; }
+  }
+  bool get(const string &s, size_t &at){
+    uint64_t nz, d, c; size_t i = 0;
+    if(!undoGet(s, at, n) || !undoGet(s, at, sum) || !undoGet(s, at, lo) || !undoGet(s, at, hi) || !undoGet(s, at, nz)) return false;
+    while(nz--){ if(!undoGet(s, at, d) || !undoGet(s, at, c) || (i += d) >= counts.size()) return false; counts[i] = c; }
+    return true;
+  }
+};
+
+struct latMetrics{
+  map<string, latHisto> ops, phases;
+
+  bool empty() const { return ops.empty() && phases.empty(); }
+  void merge(const latMetrics &o){ for(auto &[k, h] : o.ops) ops[k].merge(h); for(auto &[k, h] : o.phases) phases[k].merge(h); }
+
+  bool load(const filesystem::path &p){
+    string s; if(!undoReadAll(p, s) || s.compare(0, 4, "MVHM")) return false;
+    size_t at = 4; uint64_t len;
+    while(at < s.size()){
+      char kind = s[at++]; if((kind != 'O' && kind != 'P') || !undoGet(s, at, len) || at + len > s.size()) return false;
+      string name = s.substr(at, len); at += len;
+      if(!(kind=='O' ? ops : phases)[name].get(s, at)) return false;
+    }
+    return true;
+  }
+  bool save(const filesystem::path &p) const {
+    string s = "MVHM";
+    for(auto [kind, m] : { pair{ 'O', &ops }, pair{ 'P', &phases } })
+      for(auto &[name, h] : *m){ s += kind; undoPut(s, name.size()); s += name; h.put(s); }
+    error_code ec; filesystem::create_directories(p.parent_path(), ec);
+    FILE *f = undoOpen(p, "wb"); if(!f) return false;
+    bool ok = fwrite(s.data(), 1, s.size(), f) == s.size();
+    return fclose(f)==0 && ok;
+  }
+
+  // Exports : "text" (a table), "json", "prom" (Prometheus text format : summaries, in seconds)
+  string format(const string &fmt) const {
+    static const double qs[] = { 0.5, 0.9, 0.99, 0.999 };
+    string s; char buf[256];
+    if(fmt == "json"){
+      s = "{"; const char *sep = "";
+      for(auto [key, m] : { pair{ "ops", &ops }, pair{ "phases", &phases } }){
+        s += sep; s += "\""; s += key; s += "\":{"; sep = ",";
+        const char *sep2 = "";
+        for(auto &[name, h] : *m){
+          snprintf(buf, sizeof(buf), "%s\"%s\":{\"count\":%" PRIu64 ",\"sum_us\":%" PRIu64 ",\"min_us\":%" PRIu64 ",\"p50_us\":%" PRIu64 ",\"p90_us\":%" PRIu64
+            ",\"p99_us\":%" PRIu64 ",\"p999_us\":%" PRIu64 ",\"max_us\":%" PRIu64 "}",
+            sep2, name.c_str(), h.n, h.sum, h.lo, h.quantile(.5), h.quantile(.9), h.quantile(.99), h.quantile(.999), h.hi);
+          s += buf; sep2 = ",";
+        }
+        s += "}";
+      }
+      return s += "}\n";
+    }
+    if(fmt == "prom"){
+      for(auto [kind, m] : { pair{ "op", &ops }, pair{ "phase", &phases } }){
+        snprintf(buf, sizeof(buf), "# HELP mvtb_%s_latency_seconds Latency per %s kind.\n# TYPE mvtb_%s_latency_seconds summary\n", kind, kind, kind);
+        s += buf;
+        for(auto &[name, h] : *m){
+          for(double q : qs){ snprintf(buf, sizeof(buf), "mvtb_%s_latency_seconds{%s=\"%s\",quantile=\"%g\"} %.6f\n", kind, kind, name.c_str(), q, h.quantile(q)/1e6); s += buf; }
+          snprintf(buf, sizeof(buf), "mvtb_%s_latency_seconds_sum{%s=\"%s\"} %.6f\nmvtb_%s_latency_seconds_count{%s=\"%s\"} %" PRIu64 "\n",
+            kind, kind, name.c_str(), h.sum/1e6, kind, kind, name.c_str(), h.n);
+          s += buf;
+        }
+      }
+      return s;
+    }
+    s = "\n  Latency (ms)             count       p50       p90       p99     p99.9       max\n";
+    for(auto [kind, m] : { pair{ "op", &ops }, pair{ "phase", &phases } }) for(auto &[name, h] : *m){
+      snprintf(buf, sizeof(buf), "  %-5s %-16s %9" PRIu64 " %9.1f %9.1f %9.1f %9.1f %9.1f\n", kind, name.c_str(), h.n,
+        h.quantile(.5)/1e3, h.quantile(.9)/1e3, h.quantile(.99)/1e3, h.quantile(.999)/1e3, h.hi/1e3);
+      s += buf;
+    }
+    return s += "\n";
+  }
+};
+
+// Cost model : mean latency (µs) of each backend primitive ("move", "appid", "reload", "group-move"), a moving average
+// over the last 32 samples, kept in a calibration file : "MVCM" then, per primitive, name n mean (LEB128 varints).
+// Not measured yet : a default. The planner weighs equivalent strategies with it.
+struct costModel{
+  map<string, pair<uint64_t, double>> prims;  // name -> (samples, mean µs)
+  vector<pair<string, uint64_t>> pending;     // this run's samples, not saved yet
+
+  static double byDefault(const string &p){ return p=="reload" ? 150000 : p=="appid" ? 3000 : 1000; }
+  double cost(const string &p) const { auto it = prims.find(p); return it == prims.end() ? byDefault(p) : it->second.second; }
+  void add(const string &p, uint64_t us){ auto &[n, m] = prims[p]; n++; m += ((double) us - m) / (double) min<uint64_t>(n, 32); }
+  void record(const string &p, uint64_t us){ add(p, us); pending.emplace_back(p, us); }
+
+  bool load(const filesystem::path &p){
+    string s; if(!undoReadAll(p, s) || s.compare(0, 4, "MVCM")) return false;
+    size_t at = 4; uint64_t len, n, m; prims.clear();
+    while(at < s.size()){
+      if(!undoGet(s, at, len) || at + len > s.size()) return false;
+      string name = s.substr(at, len); at += len;
+      if(!undoGet(s, at, n) || !undoGet(s, at, m)) return false;
+      prims[name] = { n, (double) m };
+    }
+    return true;
+  }
+  // This run's samples, added to the file's (written by other runs meanwhile) : session held
+  bool save(const filesystem::path &p){
+    if(pending.empty()) return true;
+    costModel file; file.load(p); for(auto &[name, us] : pending) file.add(name, us);
+    pending.clear(); prims = file.prims;
+    string s = "MVCM";
+    for(auto &[name, nm] : prims){ undoPut(s, name.size()); s += name; undoPut(s, nm.first); undoPut(s, (uint64_t) llround(nm.second)); }
+    error_code ec; filesystem::create_directories(p.parent_path(), ec);
+    FILE *f = undoOpen(p, "wb"); if(!f) return false;
+    bool ok = fwrite(s.data(), 1, s.size(), f) == s.size();
+    return fclose(f)==0 && ok;
+  }
+};
@@ -9,31 +9,60 @@
   #define UNICODE
 #endif
 
-#include <windows.h>
-#include <strsafe.h>
-
-#include <propsys.h>
-#include <propkey.h>
-#include <shlwapi.h>
-#include "TTLib/TTLib.h"
+#ifdef _WIN32
+  #include <windows.h>
+  #include <strsafe.h>
+
+  #include <propsys.h>
+  #include <propkey.h>
+  #include <shlwapi.h>
+#elif defined(MVBTN_TTSIM)
+  #include "posix.hpp"  // the few Win32 types and calls used, for the simulated build elsewhere
+#else
+  #error "Windows only : elsewhere, build with MVBTN_TTSIM defined (simulated taskbars)"
+#endif
+#ifdef MVBTN_TTSIM
+  #include "ttsim.hpp"  // simulated taskbars, see ttsim.hpp
+  #define GetWindowTextW ttsimWindowText
+  #define GetWindowThreadProcessId ttsimWndPid
+#else
+  #include "TTLib/TTLib.h"
+#endif
 
 BOOL TTLib_unload_reload(bool onlyUnload);
 #define clean_exit(ec) { TTLib_unload_reload(true); exit(ec); }
 #include "utils.hpp"
+#include "coalesce.hpp"
+#include "wstr.hpp"
+#include "undolog.hpp"
+#include "snapshot.hpp"
+#include "deadline.hpp"
+#include "trace.hpp"
+#include "locator.hpp"
+#include "verify.hpp"
+#include "metrics.hpp"
+#include "allocstats.hpp"
+#include "procinfo.hpp"
 
 #include <set>
 #include <ranges>
 #include <string_view>
-#include <variant>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <filesystem>
 
 #define MVBTN_VERSION "0.1"
 using namespace std;
   
 int usage(int rc = 0);
 #include "opt.hpp"
+#include "batch.hpp"
 int usage(int rc){
-  cout << ""
-  "\n Move task bar buttons (v"<<MVBTN_VERSION<<")\n"
+  if(outSink().mode == outMode::json) return rc;  // the error alone, in the record
+  outLocale();
+  fputs(""
+  "\n Move task bar buttons (v" MVBTN_VERSION ")\n"
   "\n Usage :\n"
   "\n * Between groups :"
   "\n prg.exe -cg -fg <from group label> -f <position from|0> -tg <to group label|[NEW,RAND]> [-t <position to=end|start|end>]"
@@ -41,6 +70,13 @@ int usage(int rc){
   "\n prg.exe -cg -fg Notepad -f 4 -tg [NEW] : move button 4 of group Notepad to a new group named random_xxxxx"
   "\n prg.exe -cg -fg Notepad -f all -tg [RAND] : move ALL buttons of group Notepad to a new group named random_xxxxx (rename group)"
   "\n Group label can be a partial match, if it's unique. See taskbar selection in following paragraph :"
+  "\n prg.exe --split <group label> by <exe|selector;selector;..> [-tb <taskbar ID=0>] : by exe : a new group per executable"
+  "\n   (<AppId>.<exe name>), the first one's buttons stay ; by selectors (as -b : title, pattern, exe=<pattern>) : a new group"
+  "\n   per selector (<AppId>.<n>), with the buttons it selects first.  prg.exe --split Chrome by \"*Work*;*Personal*\""
+  "\n prg.exe --merge <group label,group label,..> into <group label> [-tb <taskbar ID=0>] : their buttons to the end of"
+  "\n   that group (none labeled so : a new group of that name, in the first merged group's place)."
+  "\n   Both set every AppId in one pass, then wait for one regroup (a TTLib reload), then place the new groups next to"
+  "\n   where they come from, with the fewest group moves."
   "\n "
   "\n * Within a group : by position"
   "\n prg.exe -g <group label> -f <start position> [-t <position to=end|start|end>] [-s|-swap] [-tb <taskbar ID=0>]"
@@ -48,11 +84,29 @@ int usage(int rc){
   "\n prg.exe -g Notepad -f 5 -t 2 -tb 3 : move button 5 to position 2 in group Notepad of 3rd secondary taskbar."
   "\n Taskbars are numbered : Primary = 0, Secondary = 1, 2, .. . If omitted : primary taskbar."
   "\n Arguments are case insensitive. Swap indicator : -s or -swap."
+  "\n prg.exe -g Notepad -f 5 -t 1 -f 2 -t 6 -f 1 -t 3 : several -f/-t pairs (with -s : swaps), each on the order left by the"
+  "\n   previous ones, made as one : moves undoing each other dropped, the rest as one reordering, with the fewest moves."
   "\n "
   "\n * Within a group: by button label"
   "\n prg.exe -g <group label> -b <button exact label> -t <position to=end|start|end> [-tb <taskbar ID=0>]"
   "\n     (button label is case sensitive)"
   "\n prg.exe -g explorer -b Computer -t 1 : move button labeled \"Computer\" to position 1 within grp \"explorer\" in primary taskbar."
+  "\n Label with * or ? : a pattern (case insensitive) if no title is that label. Without -g, all groups are searched :"
+  "\n prg.exe -b \"*report*\" : every button matching, with its group, position and window.  With -t : the button is moved"
+  "\n   within its group (it must be the only match)."
+  "\n prg.exe -b exe=excel.exe : the buttons of the windows of an executable (its name, or a pattern ; with a \\ : its path)."
+  "\n   Processes are cached by PID and start time, in %LOCALAPPDATA%\\mv_tb_btn\\procs.bin (MVBTN_PROC_CACHE=0 : not kept)."
+  "\n"
+  "\n * Within a group: by window"
+  "\n prg.exe -w <window handle> [-g <group label>] [-t <position to=end|start|end>] [-tb <taskbar ID=0>]"
+  "\n prg.exe -w 0x1A2B -t start : move the button of window 0x1A2B to the start of its group (-g : it must be in that group)."
+  "\n"
+  "\n * Within a group: sort"
+  "\n prg.exe -g <group label> --sort <title|natural|hwnd|creation|exe> [--desc] [-tb <taskbar ID=0>]"
+  "\n prg.exe -g explorer --sort natural : sort buttons of group \"explorer\" by title, numbers compared by value (\"Doc 2\" < \"Doc 10\")."
+  "\n   title : case insensitive,  hwnd : window handle,  creation : start time of the window's process,"
+  "\n   exe : name of its executable (grouped by executable)."
+  "\n   Sort is stable, buttons already in sorted order are not moved (fewest possible moves)."
   "\n"
   "\n * Position designation : "
   "\n   -f 3 : third button,   -t start : first button/start of group,  -t end : end of group"
@@ -62,143 +116,318 @@ int usage(int rc){
   "\n If target position is omitted (or invalid and MVBTN_GRACEFUL=1), button is moved to end of (target) group."
   "\n When moving multiple buttons, their order before move is kept (even when repositioned in target group)."
   "\n"
+  "\n * Undo :"
+  "\n prg.exe --undo [n=1] : undo the changes of the last n operations (latest first), with the fewest moves."
+  "\n   Changes are logged in %LOCALAPPDATA%\\mv_tb_btn\\undo.log. An operation failing midway is rolled back."
+  "\n"
+  "\n * Listing, shell completion :"
+  "\n prg.exe --list [group label] [-tb <taskbar ID=0>] : groups and their buttons (groups whose label contains the filter)."
+  "\n prg.exe --complete [prefix] [-g <group label>] : group labels containing prefix, one per line (with -g : button labels"
+  "\n   of that group). Both read the snapshot published by the last operation, or a resident process, if it is less than"
+  "\n   MVBTN_SNAPSHOT_TTL ms old (default 5000) : TTLib is not loaded. Else the taskbar is read, and the snapshot published."
+  "\n prg.exe --diff [-tb <taskbar ID=0>] : changes (groups/buttons added, removed, moved, retitled) since that snapshot."
+  "\n prg.exe --dump [tsv|jsonl] [-tb <taskbar ID=0>] : every button, one line each, written as read (first lines out after"
+  "\n   the first group) : for logs and audits, whatever the taskbar size. tsv : taskbar, group, appId, button, hwnd, title."
+  "\n prg.exe --resident [ms=2000] : publish the snapshots of all taskbars every ms, until Ctrl+C."
+  "\n"
+  "\n * Time limits :"
+  "\n   --timeout <ms> : the whole run.  --timeout load=3000,execute=5000,total=10000 : per phase (load, enumerate, execute,"
+  "\n   snapshot, unload) and in total. Default : env. var. MVBTN_TIMEOUT, same format. Past a limit, the operation stops"
+  "\n   between two changes (no rollback, see --undo), TTLib is unloaded, and the exit code is 124."
+  "\n"
+  "\n * Latency histograms :"
+  "\n prg.exe --metrics [text|json|prom|reset] : percentiles (p50 .. p99.9, max) of the latencies recorded by past runs, per"
+  "\n   operation kind (move, swap, cross-group, new-group, ..) and per phase (load, enumerate, execute, reload, ..). prom :"
+  "\n   Prometheus text format. Kept in %LOCALAPPDATA%\\mv_tb_btn\\metrics.bin (env. var. MVBTN_METRICS=0 : not kept)."
+  "\n"
+  "\n * Traces :"
+  "\n   --record-trace <file> : the operation, the taskbar as enumerated and every TTLib call (arguments, result, latency)."
+  "\n prg.exe --replay-trace <file> : (build on the simulated TTLib, MVBTN_TTSIM) the traced operation, rerun on the traced"
+  "\n   taskbar with the traced latencies : calls and time of both runs, and where the replay parts from the recording."
+  "\n"
+  "\n * Verification :"
+  "\n   --verify : after the moves, the positions they changed are read back (those only) and compared with the expected"
+  "\n   ones. A button found a few places off is moved again, once. Still off : reported, and the operation rolled back."
+  "\n"
+  "\n * Output :"
+  "\n   -q, --quiet : errors only.   --json : one JSON record per operation on stdout (op, group, from, to, result, rc,"
+  "\n   timings in ms per phase, error text as \"message\")."
+  "\n   --stats : the operation's allocations (count, bytes) and the peak of live heap bytes (json : \"alloc\" ; builds with"
+  "\n   MVBTN_ALLOCSTATS, as Debug), the strategy"
+  "\n   chosen where there is a choice (direct moves or end-staging, ..), with its estimated and actual cost (json : \"strategy\"). Estimates come"
+  "\n   from the latencies of moves, AppId changes and reloads measured by past runs (%LOCALAPPDATA%\\mv_tb_btn\\calib.bin)."
+  "\n   And the time from process creation to the first TTLib call, by phase (json : \"first_call_ms\", and \"exec\", \"init\","
+  "\n   \"parse\" in \"ms\"; --metrics : phase \"startup\")."
+  "\n"
+  "\n * Batches :"
+  "\n prg.exe --batch <file> [--resume] : the operations of file, one per line (its arguments, as above ; # : comment), in"
+  "\n   one TTLib session. -q, --json, --stats, --verify, --timeout : for all of them. The first failing stops the batch."
+  "\n   After each one done, a checkpoint (%LOCALAPPDATA%\\mv_tb_btn\\batch.ckpt) : the groups changed so far, as left."
+  "\n   --resume : a batch interrupted goes on from the first operation not done, if those groups are found as left."
+  "\n   Successive cross-group moves (-cg) share one TTLib reload : all their AppIds set, then the reload, then each one's"
+  "\n   buttons moved to their position ; one on a group changed by the previous ones waits for them (the reloads made,"
+  "\n   and those made one by one, are reported)."
+  "\n"
+  "\n * Response files :"
+  "\n   @<file> : stands for the arguments held in file (blank-separated, \"double quotes\" around those with blanks, # : comment"
+  "\n   to end of line).  prg.exe -g Notepad -f @positions.txt : positions.txt holding a long list (1,4,9-12,..)."
+  "\n"
+  "\n Concurrent invocations : the first one holds the session, and runs the operations of those arriving within"
+  "\n MVBTN_COALESCE_MS (default 20, 0 : none) of it, in the same TTLib session. Each invocation gets its own result."
+  "\n"
   "\n Env. var. MVBTN_GRACEFUL=1 : extra arguments and unsupported options ignored."
   "\n   prg.exe -g explorer -b Computer -t 20000"
   "\n     MVBTN_GRACEFUL=1 : move button \"Computer\" to end of group explorer.exe"
   "\n     MVBTN_GRACEFUL=  : error\n"
-  "\n"
-  <<flush;
+  "\n", stdout);
+  fflush(stdout);
   return rc;
 }
 
-#include <regex>  // This belongs in utils.hpp, but VS2019/c++20 bugs on this include
+enum class sortKey{ title, natural, hwnd, creation, exe };
+struct moveOp{ set<ULONG> from; ULONG from1 = 0, to = 0; };
+struct planState{ vector<pair<string, double>> options; int chosen = -1; chrono::steady_clock::time_point t0; double actualUs = -1; };
+
+// The taskbar, as enumerated (getButtonGroups(ctx))
+struct tbEnumerated{
+  int activGrp = 0, nGroups = 0;
+  vector<HANDLE> btnGrps;
+  vector<int> btnCnts;
+  vector<TTLIB_GROUPTYPE> btnGrpTyps;
+  vector<vector<wstring>> btnLabels;
+  vector<vector<HWND>> btnWNHs;
+  vector<wstring> appIds;
+  btnLocator locator;  // kept in step with the moves
+
+  void clear(){
+    btnGrps.clear(); btnCnts.clear(); btnGrpTyps.clear(); btnLabels.clear(); btnWNHs.clear(); appIds.clear(); locator.clear();
+    activGrp = nGroups = 0;
+  }
+};
+// The operations of a session (the holder's, those handed over) : each taskbar enumerated once, by the first to work on
+// it, then as the last one left it (re-enumerated after its changes). Dropped when one fails or undoes.
+typedef map<ULONG, tbEnumerated> tbShared;
+
+// An operation's context : what it does (parsed from the command line, or handed over by another invocation : pack(),
+// unpack()), the taskbar as enumerated, and what is kept in step with its changes. Passed to all that works on it : no
+// state shared by two operations but their invocation's (output, watchdog, undo log, cost model, process cache : inv),
+// and their session's enumeration (shared).
+struct opContext : tbEnumerated{
+  bool chgGroup = false, GRACEFUL = false;
+  LPWSTR group = nullptr, grpFrom = nullptr, grpTo = nullptr, button = nullptr;
+  bool BTN_LABEL = false, SWAP = false, NEW_GROUP = false, SORT = false, SORT_DESC = false, QUIET = false, JSON = false, UNDO = false;
+  bool LIST = false, COMPLETE = false, DIFF = false, STATS = false, BY_HWND = false, DUMP = false, VERIFY = false,
+    FIND = false,      // FIND : -b without -g nor -t, matches listed
+    SPLIT = false, MERGE = false,  // --split : group, button (its selector) ; --merge : grpFrom (the groups), grpTo
+    IN_BATCH = false;  // a line of a --batch file
+  LPWSTR listArg = nullptr;     // --list filter, --complete prefix
+  LPWSTR timeoutArg = nullptr;  // --timeout spec
+  sortKey sortBy = sortKey::title;
+  ULONG tbId = 0, iBtn1 = 0, iBtn2 = 0, undoCount = 0;
+  ULONGLONG selHwnd = 0;  // -w : button by window handle
+  set<ULONG> iBtn1s;
+  vector<moveOp> moveOps;  // several -f/-t pairs, in one group : one plan (mvTaskbarButtonsMulti(ctx))
+  wstring strs[6];         // storage of the strings unpacked
+
+  btnExpect expect;    // --verify
+  wstring grpNames[3];  // group, grpFrom, grpTo once resolved
+  planState plan;       // strategy chosen (planChoose()), for --stats
+  vector<pair<wstring, uint64_t>> changed;  // groups changed, and their hash once changed (--batch checkpoints)
+  regroupRun *regroups = nullptr;           // --batch : reloads deferred to the end of a run of cross-group moves
+  tbShared *shared = nullptr;               // session holder : the taskbars as enumerated, for the operations that follow
+
+  // How the invocation runs (not handed over)
+  bool RESIDENT = false, REPLAY = false, METRICS = false, BATCH = false, RESUME = false;
+  LPWSTR recordArg = nullptr, replayArg = nullptr, batchArg = nullptr;  // --record-trace, --replay-trace, --batch files
+  string metricsArg = "text", dumpArg = "tsv";                           // --metrics, --dump formats
+  ULONG residentMs = 0;
+  wstring envTimeout;  // MVBTN_TIMEOUT, when timeoutArg
+
+  string pack() const;
+  bool unpack(const string &s);
+};
+
+// TTLib's state. TTLib itself is loaded into Explorer once per process (ttProcess) : the invocations of a process take
+// turns on it (run). Simulated (ttsim.hpp) : each invocation has taskbars of its own, and runs in parallel with the others.
+struct ttBackend{
+  BOOL init = FALSE, explorer = FALSE, manip = FALSE;
+  mutex run, reload;  // an operation at a time ; load/unload : the watchdog may unload too (run stuck in a backend call)
+#ifdef MVBTN_TTSIM
+  ttsimState sim;
+#endif
+};
+static ttBackend ttProcess;
+
+// An invocation : its output, time limits and timings, the files of its data directory it keeps in step (undo log, cost
+// model, process cache), its trace, and its backend. The threads working for it are bound to it (invBind : inv) : several
+// invocations can run in one process, each on a thread of its own. What stays process-wide : the allocation counters
+// (allocstats.hpp), Ctrl+C (residentStop), and a time limit with no response, which ends the process.
+struct invocation{
+  filesystem::path dir;  // data directory (empty : %LOCALAPPDATA%\mv_tb_btn, appDataDir())
+  string scope;          // of its session lock (sessScope)
+#ifdef MVBTN_TTSIM
+  ttBackend own; ttBackend *tt = &own;
+#else
+  ttBackend *tt = &ttProcess;
+#endif
+  outBuffer out;
+  deadlines limits; watchdog wd; bool timeoutTold = false;
+  allocStats::snap allocAt;  // --stats : counts since
+  chrono::steady_clock::time_point tPhase = chrono::steady_clock::now(), tOp = tPhase;
+  string phaseMs;            // "phase":ms,.. for the json record
+  latMetrics latency;        // its latencies, added to the file's (latencySave())
+  struct{ uint64_t exec = 0, init = 0, parse = 0, firstCall = 0; bool done = false; } startup;  // startupBegin()
+  costModel calib; bool calibLoaded = false;
+  procCache procs; bool procsKept = true, procsLoaded = false;
+  undoLog changeLog;
+  traceState tracer;
+  size_t ttReloads = 0;
+  bool replay = false;       // --replay-trace : on the taskbars of a trace
+};
+static thread_local invocation *inv = nullptr;
+
+// Binds the calling thread to invocation i (and the modules' current state : output, trace, simulated taskbars, session
+// scope) for its lifetime. A thread working for an invocation (pool, watchdog) binds to it first.
+class invBind{
+  invocation *was; outBuffer *outWas; traceState *trWas; string scopeWas;
+#ifdef MVBTN_TTSIM
+  ttsimState *simWas;
+#endif
+public:
+  explicit invBind(invocation &i) : was(inv), outWas(outAt), trWas(tracerAt), scopeWas(sessScope){
+    inv = &i; outAt = &i.out; tracerAt = &i.tracer; sessScope = i.scope;
+#ifdef MVBTN_TTSIM
+    simWas = ttsimAt; ttsimAt = &i.tt->sim;
+#endif
+  }
+  ~invBind(){
+    inv = was; outAt = outWas; tracerAt = trWas; sessScope = scopeWas;
+#ifdef MVBTN_TTSIM
+    ttsimAt = simWas;
+#endif
+  }
+  invBind(const invBind &) = delete;
+};
 
-template<typename T1, typename CharType>
-std::basic_string<CharType>
-regexSubst(const T1 str, const CharType *find, const CharType *rep = nullptr, const regex_constants::syntax_option_type reType = regex::egrep){
+static const bool aYes = true, aNo = false;
+static const bool zeroOK = true, noZero = false;
+static const bool withRanges = true, noRanges = false;
 
-  if constexpr(is_same_v<T1, string>)
-    return regex_replace(str, basic_regex<CharType>(find, reType), rep?rep:"");
-  
-  if constexpr(is_same_v<T1, string_view>){
-    string s;
-    regex_replace(back_inserter(s), str.cbegin(), str.cend(), basic_regex<CharType>(find, reType), rep ? rep : "");
-    return s;
-  }
 
-  return regex_replace(basic_string<CharType>(str), basic_regex<CharType>(find, reType), rep ? rep : "");
+inline uint64_t usSince(chrono::steady_clock::time_point t0){
+  return (uint64_t) chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+}
+inline uint64_t phaseDone(LPCSTR phase){
+  auto t = chrono::steady_clock::now(); char buf[64]; uint64_t us = usSince(inv->tPhase);
+  snprintf(buf, sizeof(buf), "%s\"%s\":%.3f", inv->phaseMs.empty() ? "" : ",", phase, chrono::duration<double, milli>(t - inv->tPhase).count());
+  inv->phaseMs += buf; inv->latency.phases[phase].record(us); inv->tPhase = t;
+  return us;
 }
 
-template<typename strType, typename CharType>
-unique_ptr<pair<bool, vector<string_view>>>
-regexMatches(const strType input, const CharType * regx, const regex_constants::syntax_option_type reType = regex::egrep){
-
-  vector<string_view> result;
-  match_results<string_view::const_iterator> match;
+// Startup : process creation to first backend call (time to first call), by phase. exec : loader, CRT and static
+// initialization (known on Windows only, from the process creation time), then init, parse, and the start of load.
 
-  if(regex_match(input.cbegin(), input.cend(), match, regex(regx, reType))){
-    for(size_t i=1; i < match.size(); i++)
-      result.emplace_back(match[i].first, match[i].second);
-    return make_unique<pair<bool, vector<string_view>>>(make_pair(true,result));;
-  } // for_each(match.begin()+1, match.end(), [&args](const auto& m) {result.emplace_back(m.first, m.second);});
+inline uint64_t usSinceCreation(){
+#ifdef _WIN32
+  FILETIME c, x, k, u, now; if(!GetProcessTimes(GetCurrentProcess(), &c, &x, &k, &u)) return 0;
+  GetSystemTimeAsFileTime(&now);
+  auto t = [](const FILETIME &f){ return (uint64_t) f.dwHighDateTime << 32 | f.dwLowDateTime; };  // 100 ns units
+  return t(now) > t(c) ? (t(now) - t(c)) / 10 : 0;
+#else
+  return 0;
+#endif
+}
+// At main()'s start : creation to static initialization, as the "exec" phase
+inline void startupBegin(){
+  uint64_t toMain = usSinceCreation(), since = usSince(inv->tOp); if(toMain <= since) return;
+  inv->startup.exec = toMain - since; inv->latency.phases["exec"].record(inv->startup.exec);
+  char buf[64]; snprintf(buf, sizeof(buf), "\"exec\":%.3f", inv->startup.exec/1e3); inv->phaseMs = buf;
+}
+inline void startupFirstCall(){
+  if(inv->startup.done) return;
+  inv->startup.done = true; inv->startup.firstCall = inv->startup.exec + usSince(inv->tOp); inv->latency.phases["startup"].record(inv->startup.firstCall);
+}
 
-  return make_unique<pair<bool, vector<string_view>>>(make_pair(false,result));
+// Where the tool keeps its files : %LOCALAPPDATA%\mv_tb_btn, or the invocation's own
+filesystem::path appDataDir(){
+  if(!inv->dir.empty()) return inv->dir;
+  wstring val; if(getEnvVar(L"LOCALAPPDATA", val) && !val.empty()) return filesystem::path(val) / L"mv_tb_btn";
+  return filesystem::temp_directory_path() / L"mv_tb_btn";
 }
 
-//template<typename CharType>
-bool regexMatch(
-  const variant< string, string_view, const char*, const WCHAR* >& str,
-  const variant< const char *, const WCHAR * > &find,
-  const regex_constants::syntax_option_type reType = regex::egrep
-){
-  
-  if(char const* const* s = get_if<const char*>(&str)) 
-    if(char const* const* f = get_if<const char*>(&find))
-    //if(is_same<CharType, char>::value)
-    return regex_search(*s, basic_regex<char>(*f, reType));
-  if(WCHAR const *const *s = get_if<const WCHAR*>(&str))
-    if(WCHAR const* const* f = get_if<const WCHAR*>(&find))
-    return regex_search(std::basic_string<WCHAR>(*s), basic_regex<WCHAR>(*f, reType));
-
-  if(string const *s = get_if<string>(&str))
-    if(char const *const *f = get_if<const char *>(&find))
-    return regex_search(s->cbegin(), s->cend(), basic_regex<char>(*f, reType));
-  if(string const *s = get_if<string>(&str))
-    if(WCHAR const *const *f = get_if<const WCHAR *>(&find))
-      return regex_search(s->cbegin(), s->cend(), basic_regex<WCHAR>(*f, reType));
-
-  if(string_view const *s = get_if<string_view>(&str))
-    if(char const *const *f = get_if<const char *>(&find))
-    return regex_search(s->cbegin(), s->cend(), basic_regex<char>(*f, reType));
-  if(string_view const *s = get_if<string_view>(&str))
-    if(WCHAR const *const *f = get_if<const WCHAR *>(&find))
-      return regex_search(s->cbegin(), s->cend(), basic_regex<WCHAR>(*f, reType));
-
-  return false;
-
-}
-
-static bool swap = false, chgGroup = false, GRACEFUL = false;
-static LPWSTR group, grpFrom, grpTo, button;
-static bool BTN_LABEL = false, SWAP = false, NEW_GROUP = false;
-static ULONG tbId = 0, iBtn1 = 0, iBtn2 = 0;
-static set<ULONG> iBtn1s;
-static int activGrp = 0, nGroups = 0;
-
-static vector<HANDLE> btnGrps;
-static vector<int> btnCnts;
-static vector<TTLIB_GROUPTYPE> btnGrpTyps;
-static vector<vector<LPWSTR>> btnLabels;
-static vector<vector<HWND>> btnWNHs;
-static vector<LPWSTR> appIds;
-
-static bool alpha = false;
-static const bool aYes = true, aNo = false;
-static const bool zeroOK = true, noZero = false;
-static const bool withRanges = true, noRanges = false;
-static char *gStr = nullptr;
+// Backend primitives' latencies (%LOCALAPPDATA%\mv_tb_btn\calib.bin : inv->calib), and the strategy chosen with them
+// (ctx.plan) : --stats
+
+// A primitive's estimated µs (the model loaded on first use)
+inline double planCost(LPCSTR prim){
+  if(!inv->calibLoaded){ inv->calib.load(appDataDir() / L"calib.bin"); inv->calibLoaded = true; }
+  return inv->calib.cost(prim);
+}
+// The cheapest of equivalent strategies (name, estimated µs) : its index. Its cost is measured from now on. Only where
+// there is a choice : an operation done one way only reports no strategy.
+inline int planChoose(opContext &ctx, initializer_list<pair<string, double>> options){
+  ctx.plan.options = options; ctx.plan.chosen = 0; ctx.plan.actualUs = -1;
+  for(int i = 1; i < (int) ctx.plan.options.size(); i++) if(ctx.plan.options[i].second < ctx.plan.options[ctx.plan.chosen].second) ctx.plan.chosen = i;
+  ctx.plan.t0 = chrono::steady_clock::now();
+  return ctx.plan.chosen;
+}
+inline double moveCost(size_t n = 1){ return (double) n * planCost("move"); }
 
-static BOOL TTInit = FALSE, TTExplorer = FALSE, TTManip = FALSE;
 static const bool unLoadOnly = true;
 
-inline BOOL TTLibLoad(){
-  
-  if(!TTInit && TTLIB_OK!=TTLib_Init()){ cerr <<"\n Error: TTLib_Init() failed\n\n"; exit(220); }
-  TTInit = TRUE;
+// Safe point : true once the run is past a time limit (what follows is skipped, down to the unload)
+inline bool timedOut(){
+  if(!inv->wd.cancelled()) return false;
+  if(!inv->timeoutTold){ inv->timeoutTold = true; flushErr("\n Error: time limit reached (%s), stopping.\n", inv->wd.expiredIn().c_str()); }
+  return true;
+}
 
-  if(!TTExplorer && TTLIB_OK!=TTLib_LoadIntoExplorer()){ 
-    cerr <<"\n Error: TTLib_LoadIntoExplorer() failed\n\n"; exit(221); }
-  TTExplorer = TRUE;
+inline BOOL TTLibLoad(){
+  startupFirstCall();
+  if(!inv->tt->init && TTLIB_OK!=TTLib_Init()){ flushErr("\n Error: TTLib_Init() failed\n\n"); outFlush(); exit(220); }
+  inv->tt->init = TRUE;
+  if(timedOut()) return FALSE;
+
+  if(!inv->tt->explorer && TTLIB_OK!=TTLib_LoadIntoExplorer()){ 
+    flushErr("\n Error: TTLib_LoadIntoExplorer() failed\n\n"); outFlush(); clean_exit(221); }
+  inv->tt->explorer = TRUE;
+  if(timedOut()) return FALSE;
   
-  if(!TTManip && !TTLib_ManipulationStart()){
-    cerr <<"\n Error: TTLib_ManipulationStart() failed\n\n"; exit(222);
+  if(!inv->tt->manip && !TTLib_ManipulationStart()){
+    flushErr("\n Error: TTLib_ManipulationStart() failed\n\n"); outFlush(); clean_exit(222);
   }
-  TTExplorer = TRUE;
+  inv->tt->manip = TRUE;
 
   return TRUE;
 }
 
 inline BOOL TTLib_unload_reload(bool onlyUnload = false){
-  BOOL success = TRUE;
+  lock_guard<mutex> lk(inv->tt->reload);
+  BOOL success = TRUE; auto t0 = chrono::steady_clock::now();
 
-  if(TTManip  && !(success = TTLib_ManipulationEnd())) cerr <<"\n Error: TTLib_ManipulationEnd() failed\n";
-  if(success) TTManip = FALSE;
+  if(inv->tt->manip  && !(success = TTLib_ManipulationEnd())) flushErr("\n Error: TTLib_ManipulationEnd() failed\n");
+  if(success) inv->tt->manip = FALSE;
   
-  if(TTExplorer && !TTLib_UnloadFromExplorer()){
-    cerr <<"\n Error: TTLib_UnloadFromExplorer() failed\n\n";
-    if(TTInit) TTLib_Uninit(); exit(210);
-  }; TTExplorer = FALSE;
+  if(inv->tt->explorer && !TTLib_UnloadFromExplorer()){
+    flushErr("\n Error: TTLib_UnloadFromExplorer() failed\n\n"); outFlush();
+    if(inv->tt->init) TTLib_Uninit(); exit(210);
+  }; inv->tt->explorer = FALSE;
   
-  if(TTInit && !TTLib_Uninit()){ cerr <<"\n Error: TTLib_Uninit() failed\n\n";
+  if(inv->tt->init && !TTLib_Uninit()){ flushErr("\n Error: TTLib_Uninit() failed\n\n"); outFlush();
     exit(211);
-  }; TTInit = FALSE;
+  }; inv->tt->init = FALSE;
   
   if(success && onlyUnload) return success;
-  return TTLibLoad();
+  if(timedOut()) return FALSE;
+  success = TTLibLoad(); inv->latency.phases["reload"].record(usSince(t0)); inv->calib.record("reload", usSince(t0));
+  return success;
 }
 
 BOOL WndSetAppId(HWND hWnd, LPCWSTR pAppId)
 {
+#ifdef MVBTN_TTSIM
+  return ttsimSetAppId(hWnd, pAppId);
+#else
   IPropertyStore* pps;
   PROPVARIANT pv;
   HRESULT hr;
@@ -227,98 +456,251 @@ BOOL WndSetAppId(HWND hWnd, LPCWSTR pAppId)
   }
 
   return SUCCEEDED(hr);
+#endif
+}
+
+// The AppUserModelID set on the window itself ("" : none, Windows groups it by process)
+wstring WndGetAppId(HWND hWnd){
+#ifdef MVBTN_TTSIM
+  return ttsimGetAppId(hWnd);
+#else
+  IPropertyStore* pps; PROPVARIANT pv; wstring appId;
+  if(FAILED(SHGetPropertyStoreForWindow(hWnd, IID_IPropertyStore, (void**)&pps))) return appId;
+  PropVariantInit(&pv);
+  if(SUCCEEDED(pps->GetValue(PKEY_AppUserModel_ID, &pv)) && pv.vt==VT_LPWSTR && pv.pwszVal) appId = pv.pwszVal;
+  PropVariantClear(&pv); pps->Release();
+  return appId;
+#endif
+}
+
+// Start time of process pid (FILETIME, 0 : gone, or not allowed)
+uint64_t procStart(DWORD pid){
+#ifdef MVBTN_TTSIM
+  return ttsimProcStart(pid);
+#else
+  HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid); if(!hProc) return 0;
+  FILETIME c, x, k, u; uint64_t t = 0;
+  if(GetProcessTimes(hProc, &c, &x, &k, &u)) t = (uint64_t) c.dwHighDateTime << 32 | c.dwLowDateTime;
+  CloseHandle(hProc);
+  return t;
+#endif
+}
+// Image path, and command line (ProcessCommandLineInformation, Windows 8.1+ : limited access is enough)
+void procQuery(DWORD pid, procInfo &p){
+#ifdef MVBTN_TTSIM
+  return ttsimProcQuery(pid, p.path, p.cmdLine);
+#else
+  HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid); if(!hProc) return;
+  WCHAR path[1024]; DWORD n = 1024;
+  if(QueryFullProcessImageNameW(hProc, 0, path, &n)) p.path.assign(path, n);
+  typedef LONG (WINAPI *ntQuery)(HANDLE, ULONG, void*, ULONG, ULONG*);
+  struct uniStr{ USHORT len, max; LPWSTR buf; };
+  static auto query = (ntQuery) GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQueryInformationProcess");
+  ULONG len = 0;
+  if(query && (query(hProc, 60, nullptr, 0, &len), len >= sizeof(uniStr))){
+    vector<ULONG_PTR> buf(len / sizeof(ULONG_PTR) + 1);
+    if(query(hProc, 60, buf.data(), len, &len) >= 0){ auto us = (uniStr*) buf.data(); if(us->buf) p.cmdLine.assign(us->buf, us->len / 2); }
+  }
+  CloseHandle(hProc);
+#endif
+}
+
+// Process owning a window : cached (procinfo.hpp, inv->procs), the cache kept in %LOCALAPPDATA%\mv_tb_btn\procs.bin
+// (session held). Env. var. MVBTN_PROC_CACHE=0 : not kept.
+const procInfo& wndProcess(HWND hWnd){
+  if(!inv->procsLoaded){
+    wstring val; inv->procsKept = !(getEnvVar(L"MVBTN_PROC_CACHE", val) && val == L"0");
+    if(inv->procsKept) inv->procs.load(appDataDir() / L"procs.bin");
+    inv->procsLoaded = true;
+  }
+  DWORD pid = 0; GetWindowThreadProcessId(hWnd, &pid);
+  return inv->procs.get(pid, procStart, procQuery);
+}
+
+// Taskbar changes go through these : each one done is logged with what it takes to undo it (inv->changeLog), and with
+// --verify, applied to the expected state of the groups it changes. Past a time limit, they fail.
+
+inline expectGroup& expectOf(opContext &ctx, LPCWSTR appId){
+  int g = -1; for(int i = 0; i < (int) ctx.appIds.size(); i++) if(ctx.appIds[i] == appId){ g = i; break; }
+  return ctx.expect.group(appId, g, g >= 0 ? ctx.btnWNHs[g] : vector<HWND>{});
+}
+inline BOOL ttMove(opContext &ctx, int grp, int from, int to){
+  if(timedOut()) return FALSE;
+  auto t0 = chrono::steady_clock::now();
+  if(!TTLib_ButtonMoveInButtonGroup(ctx.btnGrps[grp], from, to)) return FALSE;
+  inv->calib.record("move", usSince(t0));
+  inv->changeLog.move(ctx.appIds[grp].c_str(), from, to); ctx.locator.moved(grp, from, to);
+  if(ctx.VERIFY) ctx.expect.moved(expectOf(ctx, ctx.appIds[grp].c_str()), from, to);
+  return TRUE;
+}
+inline BOOL ttSetAppId(opContext &ctx, HWND hWnd, LPCWSTR pAppId){
+  if(timedOut()) return FALSE;
+  wstring prior = inv->changeLog.enabled ? WndGetAppId(hWnd) : L"";
+  auto t0 = chrono::steady_clock::now();
+  if(!traceCall("SetAppId", WndSetAppId, hWnd, pAppId)) return FALSE;
+  inv->calib.record("appid", usSince(t0));
+  inv->changeLog.setAppId((ULONG_PTR) hWnd, prior.c_str(), pAppId);
+  if(btnPos at = ctx.locator.find(hWnd); ctx.VERIFY && pAppId && at.grp >= 0) ctx.expect.regrouped(hWnd, expectOf(ctx, ctx.appIds[at.grp].c_str()), expectOf(ctx, pAppId));
+  return TRUE;
+}
+// TTLib reloaded (it then sees the windows regrouped)
+inline BOOL ttReload(opContext &ctx){
+  inv->ttReloads++; if(!TTLib_unload_reload()) return FALSE;
+  ctx.expect.unseen = false; return TRUE;
+}
+// --batch : an operation on group appId ("" : any), changed by the run of deferred reloads, waits for it to be done
+inline bool regroupWaits(opContext &ctx, const wstring &appId){
+  if(!ctx.regroups || ctx.regroups->moves.empty() || (!appId.empty() && !ctx.regroups->touches(ctx.tbId, appId))) return false;
+  return ctx.regroups->conflict = true;
+}
+// --batch : the regrouped buttons moved to position to within the target group once the run's reload done
+inline BOOL regroupDefer(opContext &ctx, vector<HWND> hwnds){
+  ctx.regroups->moves.push_back({ (uint32_t) ctx.tbId, ctx.grpTo, move(hwnds), ctx.iBtn2 }); ctx.regroups->deferred++;
+  flushOut(" .. deferred (one reload for the batch's run)\n\n"); return TRUE;
+}
+inline BOOL ttGroupMove(opContext &ctx, HANDLE hTaskbar, int from, int to){
+  if(timedOut()) return FALSE;
+  auto t0 = chrono::steady_clock::now();
+  if(!TTLib_ButtonGroupMove(hTaskbar, from, to)) return FALSE;
+  inv->calib.record("group-move", usSince(t0));
+  inv->changeLog.groupMove(from, to); ctx.locator.groupMoved(from, to);
+  return TRUE;
 }
 
-void getButtons(int k, HANDLE hTaskbar, HANDLE hButtonGroup, int nCount)
+void getButtons(opContext &ctx, int k, HANDLE hTaskbar, HANDLE hButtonGroup, int nCount)
 {
-  vector<LPWSTR> cbtnLabels; vector<HWND> cbtnHandles;
+  vector<HWND> cbtnHandles;
     for(int i = 0; i < nCount; i++)
     {
       HANDLE hButton = TTLib_GetButton(hButtonGroup, i);
       HWND hWnd = TTLib_GetButtonWindow(hButton);
       cbtnHandles.push_back(hWnd);
-
-      WCHAR szWindowTitle[MAX_APPID_LENGTH+1];
-      GetWindowTextW(hWnd, szWindowTitle, MAX_APPID_LENGTH);
-      cbtnLabels.push_back(*catWstr({ szWindowTitle }));
     }
-    btnLabels.push_back(cbtnLabels);
-    btnWNHs.push_back(cbtnHandles);
+    ctx.btnLabels.emplace_back(nCount);  // titles : fetchTitles(ctx)
+    ctx.btnWNHs.push_back(cbtnHandles);
 }
 
-void getButtonGroups(HANDLE hTaskbar)
+// Window titles of all groups, fetched by a pool of workers taking a group at a time (TTLib is only called from the
+// main thread). Below 64 buttons a worker, or traced (calls in a reproducible order) : the main thread alone.
+void fetchTitles(opContext &ctx){
+  size_t n = ctx.btnWNHs.size(), total = 0; for(auto &g : ctx.btnWNHs) total += g.size();
+  size_t nw = inv->tracer.on || inv->replay ? 1 : min<size_t>({ (size_t) max(1u, thread::hardware_concurrency()), 8, n, total/64 + 1 });
+  atomic<size_t> next{ 0 };
+  auto work = [&]{
+    WCHAR szWindowTitle[MAX_APPID_LENGTH+1];
+    for(size_t g; (g = next++) < n && !inv->wd.cancelled(); )
+      for(size_t j = 0; j < ctx.btnWNHs[g].size(); j++){
+        szWindowTitle[0] = 0; traceCall("GetWindowText", GetWindowTextW, ctx.btnWNHs[g][j], szWindowTitle, MAX_APPID_LENGTH);
+        ctx.btnLabels[g][j] = szWindowTitle;
+      }
+  };
+  invocation *self = inv;
+  vector<thread> pool; for(size_t i = 1; i < nw; i++) pool.emplace_back([&work, self]{ invBind in(*self); work(); });
+  work(); for(auto &t : pool) t.join();
+}
+
+void getButtonGroups(opContext &ctx, HANDLE hTaskbar)
 {
   HANDLE hActiveButtonGroup = TTLib_GetActiveButtonGroup(hTaskbar);
 
   int btnCnt;
   TTLIB_GROUPTYPE nButtonGroupType;
 
-  if(TTLib_GetButtonGroupCount(hTaskbar, &nGroups))
+  if(TTLib_GetButtonGroupCount(hTaskbar, &ctx.nGroups))
   {
-    for(int i = 0; i < nGroups; i++)
+    for(int i = 0; i < ctx.nGroups && !timedOut(); i++)
     {
       HANDLE hButtonGroup = TTLib_GetButtonGroup(hTaskbar, i);
-      btnGrps.push_back(hButtonGroup);
+      ctx.btnGrps.push_back(hButtonGroup);
 
-      if(hButtonGroup == hActiveButtonGroup) activGrp = i;
+      if(hButtonGroup == hActiveButtonGroup) ctx.activGrp = i;
 
       if(TTLib_GetButtonGroupType(hButtonGroup, &nButtonGroupType))
-        btnGrpTyps.push_back(nButtonGroupType);
-      else btnGrpTyps.push_back(TTLIB_GROUPTYPE_UNKNOWN);
+        ctx.btnGrpTyps.push_back(nButtonGroupType);
+      else ctx.btnGrpTyps.push_back(TTLIB_GROUPTYPE_UNKNOWN);
 
       WCHAR szAppId[MAX_APPID_LENGTH];
       TTLib_GetButtonGroupAppId(hButtonGroup, szAppId, MAX_APPID_LENGTH);
-      appIds.push_back(*catWstr({szAppId}));
+      ctx.appIds.push_back(szAppId);
 
       if(TTLib_GetButtonCount(hButtonGroup, &btnCnt)) {
-        btnCnts.push_back(btnCnt);
-        if(btnCnt>0) getButtons(i, hTaskbar, hButtonGroup, btnCnt);
+        ctx.btnCnts.push_back(btnCnt);
+        if(btnCnt>0) getButtons(ctx, i, hTaskbar, hButtonGroup, btnCnt);
         else{ 
-          vector<LPWSTR> v; btnLabels.push_back(v); 
-          vector<HWND> y; btnWNHs.push_back(y);
+          vector<wstring> v; ctx.btnLabels.push_back(v); 
+          vector<HWND> y; ctx.btnWNHs.push_back(y);
         }
       }
-      else btnCnts.push_back(-1);
+      else ctx.btnCnts.push_back(-1);
+    }
+    if(timedOut()) ctx.nGroups = (int) ctx.btnGrps.size();
+    fetchTitles(ctx); inv->procs.newRun();
+    ctx.locator.build(ctx.btnWNHs, ctx.btnLabels);
+  }
+
+}
+
+// Streaming enumeration : each group, then its buttons, handed over as read from TTLib, nothing kept (memory does not
+// grow with the taskbar). onGroup(grp, appId, nButtons), onButton(grp, pos, hWnd, title) : false stops the visit.
+template <typename G, typename B>
+BOOL visitButtons(HANDLE hTaskbar, G onGroup, B onButton){
+  int n = 0, nb;
+  if(!TTLib_GetButtonGroupCount(hTaskbar, &n)) return FALSE;
+  WCHAR szAppId[MAX_APPID_LENGTH], szWindowTitle[MAX_APPID_LENGTH+1];
+  for(int i = 0; i < n && !timedOut(); i++){
+    HANDLE hButtonGroup = TTLib_GetButtonGroup(hTaskbar, i);
+    szAppId[0] = 0; TTLib_GetButtonGroupAppId(hButtonGroup, szAppId, MAX_APPID_LENGTH);
+    if(!TTLib_GetButtonCount(hButtonGroup, &nb)) nb = 0;
+    if(!onGroup(i, szAppId, nb)) return TRUE;
+    for(int j = 0; j < nb; j++){
+      HWND hWnd = TTLib_GetButtonWindow(TTLib_GetButton(hButtonGroup, j));
+      szWindowTitle[0] = 0; traceCall("GetWindowText", GetWindowTextW, hWnd, szWindowTitle, MAX_APPID_LENGTH);
+      if(!onButton(i, j, hWnd, szWindowTitle)) return TRUE;
     }
   }
+  return !timedOut();
+}
 
+// List a group's buttons, to help the reader of an error/warning (nobody to read it in quiet and json modes)
+void listButtons(opContext &ctx, int grp, bool toErr = true){
+  if(outSink().mode != outMode::text) return;
+  int i = 0; for(auto &label : ctx.btnLabels[grp])
+    (toErr ? flushErr : flushOut)("   %3d. %s\n", ++i, *wide2uf8(label.c_str()));
 }
 
 // valid target position ?
-int validTargetPosition(const int grp, const int nbBtn, const int j){
-  if(iBtn2==9999) iBtn2 = nbBtn;
-  if(iBtn2 >(UINT) nbBtn){
-    if(GRACEFUL){
+int validTargetPosition(opContext &ctx, const int grp, const int nbBtn, const int j){
+  if(ctx.iBtn2==9999) ctx.iBtn2 = nbBtn;
+  if(ctx.iBtn2 >(UINT) nbBtn){
+    if(ctx.GRACEFUL){
       if(j==nbBtn){
         flushOut("\nOnly %d button%s in group, button #%d is already at last position :\n", nbBtn, nbBtn==1?"":"s", j);
-        int i = 0; for(LPWSTR label : btnLabels[grp])
-          flushOut("   %3d. %s\n", ++i, *wide2uf8(label));
+        listButtons(ctx, grp, false);
         flushOut("Nothing to do.\n\n");
         return 1;
       } else flushOut("  Only %d button%s in group, moving button #%d to last position", nbBtn, nbBtn==1 ? "" : "s", j);
-      iBtn2 = nbBtn; return 0;
+      ctx.iBtn2 = nbBtn; return 0;
     } else{
-      flushErr("\n Error: can't move button to position %d, only %d button%s in group:\n", iBtn2, nbBtn, nbBtn==1 ? "" : "s");
-      int i = 0; for(LPWSTR label : btnLabels[grp])
-        flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+      flushErr("\n Error: can't move button to position %d, only %d button%s in group:\n", ctx.iBtn2, nbBtn, nbBtn==1 ? "" : "s");
+      listButtons(ctx, grp);
       flushErr("\nAbort.\n\n");
       return 2;
     }
   }
-  if(iBtn2==nbBtn && j==nbBtn){
+  if(ctx.iBtn2==nbBtn && j==nbBtn){
     flushOut("Group has %d button%s, and button #%d is already at last position. Nothing to do.\n\n", nbBtn, nbBtn==1 ? "" : "s", j);
     return 1;
   }
   return 0;
 }
 
-int groupByLabel(LPCWSTR mGroup){
+int groupByLabel(opContext &ctx, LPCWSTR mGroup){
 
-  vector<int> grpMatch; vector<LPWSTR> mpos; 
-  LPWSTR p; int k = 0;
+  vector<int> grpMatch; vector<LPCWSTR> mpos; 
+  LPCWSTR p; int k = 0;
 
-  for(int i = 0; i < nGroups; i++)
-    if(NULL!=(p = StrStrIW(appIds[i], mGroup))){ grpMatch.push_back(i); mpos.push_back(p); }
+  for(int i = 0; i < ctx.nGroups; i++)
+    if(NULL!=(p = wstrStrI<WCHAR>(ctx.appIds[i].c_str(), mGroup))){ grpMatch.push_back(i); mpos.push_back(p); }
   if(grpMatch.size() == 0){
     flushErr("\n Error: no group labeled \"%s\"\n\nAbort.\n\n", *wide2uf8(mGroup));
     return -1;
@@ -327,89 +709,160 @@ int groupByLabel(LPCWSTR mGroup){
     flushErr("\n Error: multiple matches for group label \"%s\" :\n", *wide2uf8(mGroup));
     for(short i=0; i<grpMatch.size(); i++){
       k = grpMatch[i];
-      flushErr("   group #%d: %s\n%*s^\n", k, *wide2uf8(appIds[k]), _snprintf(NULL, 0, "   group #%d: ", k)+(mpos[i]-appIds[k]),"");
+      flushErr("   group #%d: %s\n%*s^\n", k, *wide2uf8(ctx.appIds[k].c_str()), _snprintf(NULL, 0, "   group #%d: ", k)+(mpos[i]-ctx.appIds[k].c_str()),"");
     }
     flushErr("Abort.\n\n");
     return -1;
   }
   int grpId = grpMatch[0];
 
-  if(btnCnts[grpId] <= 0){
-    flushErr("\n Error: group #%d: %s\n has no buttons !!\nAbort.\n\n", grpId+1, *wide2uf8(appIds[grpId]));
+  if(ctx.btnCnts[grpId] <= 0){
+    flushErr("\n Error: group #%d: %s\n has no buttons !!\nAbort.\n\n", grpId+1, *wide2uf8(ctx.appIds[grpId].c_str()));
     return -1;
   }
-  int cnt = btnCnts[grpId];
-  if(0==lstrcmpW(mGroup, appIds[grpId]))
+  int cnt = ctx.btnCnts[grpId];
+  if(0==lstrcmpW(mGroup, ctx.appIds[grpId].c_str()))
     flushOut("      group \"%s\" (#%d, %d button%s)\n", *wide2uf8(mGroup), grpId+1, cnt, cnt==1?"":"s");
-  else flushOut("      \"%s\" matches: %s (grp #%d, %d button%s)\n", *wide2uf8(mGroup), *wide2uf8(appIds[grpId]), grpId+1, cnt, cnt==1?"":"s");
+  else flushOut("      \"%s\" matches: %s (grp #%d, %d button%s)\n", *wide2uf8(mGroup), *wide2uf8(ctx.appIds[grpId].c_str()), grpId+1, cnt, cnt==1?"":"s");
   return grpId;
 }
 
-BOOL mvTaskbarButtons(HANDLE hTaskbar){
+// -w <window handle> [-g <group label>] : the window's group and position (the group, if given, must be its own)
+int groupByHwnd(opContext &ctx){
+  btnPos p = ctx.locator.find((HWND) (ULONG_PTR) ctx.selHwnd);
+  if(p.grp < 0){ flushErr("\n Error: no taskbar button for window 0x%llx\n\nAbort.\n\n", ctx.selHwnd); return -1; }
+  if(ctx.group){
+    int g = groupByLabel(ctx, ctx.group); if(g < 0) return -1;
+    if(g != p.grp){ flushErr("\n Error: window 0x%llx is in group #%d: %s\n\nAbort.\n\n", ctx.selHwnd, p.grp+1, *wide2uf8(ctx.appIds[p.grp].c_str())); return -1; }
+  }
+  ctx.iBtn1 = p.pos+1;
+  flushOut("      window 0x%llx : button #%d of group #%d (%s)\n", ctx.selHwnd, p.pos+1, p.grp+1, *wide2uf8(ctx.appIds[p.grp].c_str()));
+  return p.grp;
+}
 
-  int grpId = groupByLabel(group); if(grpId<0) return FALSE;
-  group = appIds[grpId];
-  ULONG nbButtons = (int) (btnLabels[grpId]).size();
-  if(iBtn1==9999) iBtn1 = nbButtons;
+// exe=<name|pattern> : the executable selected (its path if it has a \), nullptr if button is a title
+inline LPCWSTR exeSelector(opContext &ctx){
+  for(int i = 0; i < 4; i++) if(wstrFold(ctx.button[i]) != L"exe="[i]) return nullptr;
+  return ctx.button[4] ? ctx.button+4 : nullptr;
+}
+
+// Buttons titled button (exact), else matching it (a pattern : * or ?), in group grp (-1 : all), by group and position.
+// An executable (exeSelector(ctx)) : its windows', in one pass over the windows enumerated (a process checked once).
+vector<btnPos> titleHits(opContext &ctx, int grp){
+  LPCWSTR exe = exeSelector(ctx);
+  if(!exe){
+    auto v = ctx.locator.find(ctx.button, grp);  // a title with * or ? in it : itself first
+    if(v.empty() && wcspbrk(ctx.button, L"*?")) v = ctx.locator.match(ctx.button, grp);
+    return v;
+  }
+  vector<btnPos> v; bool byPath = wcschr(exe, L'\\');
+  for(int g = max(grp, 0); g < (grp < 0 ? (int) ctx.btnWNHs.size() : grp+1); g++)
+    for(int p = 0; p < (int) ctx.btnWNHs[g].size(); p++){
+      auto &proc = wndProcess(ctx.btnWNHs[g][p]);
+      if(!proc.path.empty() && titleMatch(exe, (byPath ? proc.path : proc.name).c_str())) v.push_back({ g, p });
+    }
+  return v;
+}
+
+void listHits(opContext &ctx, const vector<btnPos> &hits, bool toErr){
+  if(outSink().mode != outMode::text) return;
+  for(auto &h : hits) (toErr ? flushErr : flushOut)("   group #%-3d %-40s button #%-3d 0x%-10llx %s\n", h.grp+1, *wide2uf8(ctx.appIds[h.grp].c_str()),
+    h.pos+1, (ULONGLONG) (ULONG_PTR) ctx.btnWNHs[h.grp][h.pos], *wide2uf8(ctx.btnLabels[h.grp][h.pos].c_str()));
+}
+
+// -b <title|pattern> without -g : searched in every group (the titles fetched in parallel by the enumeration, indexed by
+// the locator). FIND (no -t) : all matches, with their group and position. Else : the group of the one match.
+int groupByTitle(opContext &ctx){
+  auto hits = titleHits(ctx, -1);
+  if(ctx.FIND){
+    string json = "[";
+    for(auto &h : hits){
+      json += json.size() > 1 ? ",{" : "{"; json += "\"group\":" + to_string(h.grp+1) + ",\"appid\":" + jsonStr(*wide2uf8(ctx.appIds[h.grp].c_str()));
+      json += ",\"position\":" + to_string(h.pos+1) + ",\"hwnd\":" + to_string((ULONGLONG) (ULONG_PTR) ctx.btnWNHs[h.grp][h.pos]);
+      json += ",\"title\":" + jsonStr(*wide2uf8(ctx.btnLabels[h.grp][h.pos].c_str()));
+      if(exeSelector(ctx)) json += ",\"exe\":" + jsonStr(*wide2uf8(wndProcess(ctx.btnWNHs[h.grp][h.pos]).path.c_str()));
+      json += "}";
+    }
+    outSetRaw("matches", json + "]");
+    if(hits.empty()){ flushErr("\n Error: no button titled \"%s\" in %d group%s\n\n", *wide2uf8(ctx.button), ctx.nGroups, ctx.nGroups==1 ? "" : "s"); return -1; }
+    flushOut("\n  %zu button%s found :\n", hits.size(), hits.size()==1 ? "" : "s"); listHits(ctx, hits, false); flushOut("\n");
+    return hits[0].grp;
+  }
+  if(hits.size() != 1){
+    if(hits.empty()) flushErr("\n Error: no button titled \"%s\" in %d group%s\n\nAbort.\n\n", *wide2uf8(ctx.button), ctx.nGroups, ctx.nGroups==1 ? "" : "s");
+    else{
+      flushErr("\n Error: %zu buttons titled \"%s\", in :\n", hits.size(), *wide2uf8(ctx.button)); listHits(ctx, hits, true);
+      flushErr("\n Name the group (-g), or the window (-w).\n\nAbort.\n\n");
+    }
+    return -1;
+  }
+  flushOut("      button \"%s\" : #%d of group #%d (%s)\n", *wide2uf8(ctx.btnLabels[hits[0].grp][hits[0].pos].c_str()), hits[0].pos+1, hits[0].grp+1,
+    *wide2uf8(ctx.appIds[hits[0].grp].c_str()));
+  return hits[0].grp;
+}
+
+vector<pair<int,int>> permutationMoves(const vector<int> &rank);
+
+BOOL mvTaskbarButtons(opContext &ctx, HANDLE hTaskbar){
+
+  int grpId = ctx.BY_HWND ? groupByHwnd(ctx) : ctx.BTN_LABEL && !ctx.group ? groupByTitle(ctx) : groupByLabel(ctx, ctx.group); if(grpId<0) return FALSE;
+  if(ctx.FIND) return TRUE;
+  ctx.group = (ctx.grpNames[0] = ctx.appIds[grpId]).data();
+  ULONG nbButtons = (int) (ctx.btnLabels[grpId]).size();
+  if(ctx.iBtn1==9999) ctx.iBtn1 = nbButtons;
   
-  // -g <group label> -b <button exact label> -t <position to=end|start|end>
-  if(BTN_LABEL){
+  // [-g <group label>] -b <button title|pattern> -t <position to=end|start|end>
+  if(ctx.BTN_LABEL){
     // Locate button
-    int j = -1;
-    for(ULONG i = 0; i < nbButtons; i++)
-      if(0==lstrcmpW(btnLabels[grpId][i], button)){ j = i; break; }
+    auto hits = titleHits(ctx, grpId); int j = hits.empty() ? -1 : hits[0].pos;
     if(j < 0){
-      int i = 0;
-      flushErr("\n Error: group #%d: %s\n has no button labeled : %s\n\n  Buttons:\n", grpId, *wide2uf8(appIds[grpId]), *wide2uf8(button));
-      for(LPWSTR label : btnLabels[grpId])
-        flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+      flushErr("\n Error: group #%d: %s\n has no button labeled : %s\n\n  Buttons:\n", grpId, *wide2uf8(ctx.appIds[grpId].c_str()), *wide2uf8(ctx.button));
+      listButtons(ctx, grpId);
       flushErr("\nAbort.\n\n");
       return FALSE;
     }
     flushOut("      Matching button in group: #%d\n", j+1);
     
-    int rc;  if(2==(rc = validTargetPosition(grpId, nbButtons, 1+j))) return FALSE;
+    int rc;  if(2==(rc = validTargetPosition(ctx, grpId, nbButtons, 1+j))) return FALSE;
     if(rc==1) return TRUE;
 
-    flushOut("    Moving button #%lu (%s) to position %lu", j+1, iBtn2);
-    if(TTLib_ButtonMoveInButtonGroup(btnGrps[grpId], j, iBtn2 - 1))  flushOut(" .. done\n\n");
+    flushOut("    Moving button #%lu (%s) to position %lu", j+1, *wide2uf8(ctx.btnLabels[grpId][j].c_str()), ctx.iBtn2);
+    if(ttMove(ctx, grpId, j, ctx.iBtn2 - 1))  flushOut(" .. done\n\n");
     else{ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
 
     return TRUE;
   }  // end BTN_LABEL
 
   // -g <group label> -f <start position> [-t <position to=end|start|end>] [-s|-swap]
-  if(!SWAP){
+  if(!ctx.SWAP){
     // Buttons to move
-    UINT nbBtns1 = (UINT) iBtn1s.size();
-    if(iBtn1 == 9999) iBtn1 = nbButtons; 
-    ULONG n = (nbBtns1 && *iBtn1s.begin() > nbButtons) ? *iBtn1s.begin() : 0, upper = *iBtn1s.crbegin();
+    UINT nbBtns1 = (UINT) ctx.iBtn1s.size();
+    if(ctx.iBtn1 == 9999) ctx.iBtn1 = nbButtons; 
+    ULONG n = (nbBtns1 && *ctx.iBtn1s.begin() > nbButtons) ? *ctx.iBtn1s.begin() : 0, upper = nbBtns1 ? *ctx.iBtn1s.crbegin() : 0;
     if(n==0 && upper > nbButtons){
-      if(GRACEFUL){
+      if(ctx.GRACEFUL){
         flushOut("\n  Group has only %d button%s (no position %d).", nbButtons, nbButtons==1 ? "" : "s", upper);
-        for(auto btn : iBtn1s) if(btn>nbButtons) iBtn1s.erase(btn);
-        n = 0; nbBtns1 = (UINT) iBtn1s.size();
+        for(auto btn : ctx.iBtn1s) if(btn>nbButtons) ctx.iBtn1s.erase(btn);
+        n = 0; nbBtns1 = (UINT) ctx.iBtn1s.size();
       }
       else n = upper;
     }
-    if(n>nbButtons || (iBtn1>0 && iBtn1 > nbButtons)){
-      flushErr("\n Error: move button #%d : group #%d has only %d button%s !\n", n ? n : iBtn1, grpId+1, nbButtons, nbButtons==1 ? "" : "s");
-      int i = 0; for(LPWSTR label : btnLabels[grpId])
-        flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+    if(n>nbButtons || (ctx.iBtn1>0 && ctx.iBtn1 > nbButtons)){
+      flushErr("\n Error: move button #%d : group #%d has only %d button%s !\n", n ? n : ctx.iBtn1, grpId+1, nbButtons, nbButtons==1 ? "" : "s");
+      listButtons(ctx, grpId);
       flushErr("\nAbort.\n\n");
       return FALSE;
     }
 
     // Validate target position
-    if(iBtn2 == 9999) iBtn2 = nbButtons;
-    if(GRACEFUL && iBtn2 > nbButtons){
-      flushOut("\n  Group has only %d button%s (no position %d).", nbButtons, nbButtons==1 ? "" : "s", iBtn2);
-      iBtn2 = nbButtons; // move to end
-    }
-    else if(iBtn2 > nbButtons){
-      flushErr("\n Error: move to position #%d : group has only %d button%s !\n", iBtn2, nbButtons, nbButtons==1 ? "" : "s");
-      int i = 0; for(LPWSTR label : btnLabels[grpId])
-        flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+    if(ctx.iBtn2 == 9999) ctx.iBtn2 = nbButtons;
+    if(ctx.GRACEFUL && ctx.iBtn2 > nbButtons){
+      flushOut("\n  Group has only %d button%s (no position %d).", nbButtons, nbButtons==1 ? "" : "s", ctx.iBtn2);
+      ctx.iBtn2 = nbButtons; // move to end
+    }
+    else if(ctx.iBtn2 > nbButtons){
+      flushErr("\n Error: move to position #%d : group has only %d button%s !\n", ctx.iBtn2, nbButtons, nbButtons==1 ? "" : "s");
+      listButtons(ctx, grpId);
       flushErr("\nAbort.\n\n");
       return FALSE;
     }
@@ -419,36 +872,48 @@ BOOL mvTaskbarButtons(HANDLE hTaskbar){
       return TRUE; 
     }
     // contiguous set ?
-    bool contiguous = true; if(nbBtns1){ n = (*iBtn1s.cbegin())-1; for(auto btn : iBtn1s){ if(btn != n+1){ contiguous = false; break; }; n = btn; }}
-    if(nbBtns1 && contiguous && iBtn2==*iBtn1s.cbegin()){
-      if(nbBtns1==1) flushOut("\n  Button %lu is at position %lu ! Nothing to do.\n\n", iBtn2, iBtn2);
-      else flushOut("\n  Buttons %lu to %lu already at position %lu. Nothing to do.\n\n", iBtn2, *iBtn1s.crbegin(), iBtn2);
+    bool contiguous = true; if(nbBtns1){ n = (*ctx.iBtn1s.cbegin())-1; for(auto btn : ctx.iBtn1s){ if(btn != n+1){ contiguous = false; break; }; n = btn; }}
+    if(nbBtns1 && contiguous && ctx.iBtn2==*ctx.iBtn1s.cbegin()){
+      if(nbBtns1==1) flushOut("\n  Button %lu is at position %lu ! Nothing to do.\n\n", ctx.iBtn2, ctx.iBtn2);
+      else flushOut("\n  Buttons %lu to %lu already at position %lu. Nothing to do.\n\n", ctx.iBtn2, *ctx.iBtn1s.crbegin(), ctx.iBtn2);
       return TRUE;
     }
-    if(nbBtns1) flushOut("\n  Moving %d button%s to end of group \"%s\"", nbBtns1, nbBtns1==1 ? "" : "s", *wide2uf8(group));
-    else{ // single button
-      if(iBtn1==iBtn2){ flushOut("\n  Button to move is already at position %lu. Nothing to do.\n\n", iBtn1); return TRUE; }
-      flushOut("\n  Moving button \"%s\" to position %lu", *wide2uf8(btnLabels[grpId][iBtn1-1]), iBtn2);
-      if(!TTLib_ButtonMoveInButtonGroup(btnGrps[grpId], iBtn1-1, iBtn2-1)){
+    if(!nbBtns1){ // single button
+      if(ctx.iBtn1==ctx.iBtn2){ flushOut("\n  Button to move is already at position %lu. Nothing to do.\n\n", ctx.iBtn1); return TRUE; }
+      flushOut("\n  Moving button \"%s\" to position %lu", *wide2uf8(ctx.btnLabels[grpId][ctx.iBtn1-1].c_str()), ctx.iBtn2);
+      if(!ttMove(ctx, grpId, ctx.iBtn1-1, ctx.iBtn2-1)){
         flushErr("\n\n Error: operation failed\n\n"); return FALSE;
       }
       flushOut(" .. done\n\n"); 
       return TRUE;
     }
-    
-    int j = 0; for(auto btn : iBtn1s)
-      if(!TTLib_ButtonMoveInButtonGroup(btnGrps[grpId], btn-1-(j++), nbButtons-1)){ 
+
+    // Several : straight to their final places (fewest moves, permutationMoves()), or all to the end, then back to the
+    // target (end-staging). rank : final position of each button, selected ones at t, in order.
+    ULONG t = min(ctx.iBtn2, nbButtons-nbBtns1+1); vector<int> rank(nbButtons);
+    { int sel = 0, oth = 0; for(ULONG i = 1; i <= nbButtons; i++) rank[i-1] = ctx.iBtn1s.count(i) ? (int) t-1 + sel++ : oth < (int) t-1 ? oth++ : (int) nbBtns1 + oth++; }
+    auto moves = permutationMoves(rank);
+    if(0 == planChoose(ctx, { { "direct", moveCost(moves.size()) }, { "end-staging", moveCost(ctx.iBtn2 > nbButtons-nbBtns1 ? nbBtns1 : 2*nbBtns1) } })){
+      flushOut("\n  Moving %d button%s to position %lu (%zu move%s)", nbBtns1, nbBtns1==1 ? "" : "s", t, moves.size(), moves.size()==1 ? "" : "s");
+      for(auto [from, to] : moves) if(!ttMove(ctx, grpId, from, to)){ flushErr("\n\n Error: operation failed\n\n"); return FALSE; }
+      flushOut(" .. done\n\n");
+      return TRUE;
+    }
+
+    flushOut("\n  Moving %d button%s to end of group \"%s\"", nbBtns1, nbBtns1==1 ? "" : "s", *wide2uf8(ctx.group));
+    int j = 0; for(auto btn : ctx.iBtn1s)
+      if(!ttMove(ctx, grpId, btn-1-(j++), nbButtons-1)){ 
         flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
     flushOut(" .. done\n");
-    if(iBtn2==nbButtons){ flushOut("\n"); return TRUE; }
-    if(iBtn2>=(nbButtons-nbBtns1+1)){
-      flushOut("  Moved buttons at positions %lu to %lu, which include target position (#%lu). Done.\n\n", nbButtons-nbBtns1+1, nbButtons, iBtn2);
+    if(ctx.iBtn2==nbButtons){ flushOut("\n"); return TRUE; }
+    if(ctx.iBtn2>=(nbButtons-nbBtns1+1)){
+      flushOut("  Moved buttons at positions %lu to %lu, which include target position (#%lu). Done.\n\n", nbButtons-nbBtns1+1, nbButtons, ctx.iBtn2);
       return TRUE; }
 
-    flushOut("  Moving %d button%s to position %lu", nbBtns1, nbBtns1==1 ? "" : "s", iBtn2);
+    flushOut("  Moving %d button%s to position %lu", nbBtns1, nbBtns1==1 ? "" : "s", ctx.iBtn2);
     j = 0;
     for(UINT i = nbButtons-nbBtns1+1; i <= nbButtons; i++)
-      if(!TTLib_ButtonMoveInButtonGroup(btnGrps[grpId], i-1, iBtn2-1+(j++))){
+      if(!ttMove(ctx, grpId, i-1, ctx.iBtn2-1+(j++))){
         flushErr("\n\n Error: operation failed\n\n"); return FALSE;
       }
     flushOut(" .. done\n\n"); 
@@ -456,157 +921,293 @@ BOOL mvTaskbarButtons(HANDLE hTaskbar){
   }
 
   // SWAP
-  UINT nbBtns1 = (UINT) iBtn1s.size();
-  if(iBtn1 == 9999) iBtn1 = nbButtons;
-  if(nbBtns1 > nbButtons || (iBtn1>0 && iBtn1 > nbButtons)){
-    flushErr("\n Error: move button #%d : group #%d has only %d button%s !\n", *iBtn1s.begin(), grpId+1, nbButtons, nbButtons==1 ? "" : "s");
-    int i = 0; for(LPWSTR label : btnLabels[grpId])
-      flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+  UINT nbBtns1 = (UINT) ctx.iBtn1s.size();
+  if(ctx.iBtn1 == 9999) ctx.iBtn1 = nbButtons;
+  if(nbBtns1 > nbButtons || (ctx.iBtn1>0 && ctx.iBtn1 > nbButtons)){
+    flushErr("\n Error: move button #%d : group #%d has only %d button%s !\n", *ctx.iBtn1s.begin(), grpId+1, nbButtons, nbButtons==1 ? "" : "s");
+    listButtons(ctx, grpId);
     flushErr("\nAbort.\n\n");
     return FALSE;
   }
   // Button to swap exists ?
-  if(iBtn2>(UINT) nbButtons){
-    flushErr("\n Error: no button #%d, only %d button%s in group !\n", iBtn2, nbButtons, nbButtons==1 ? "" : "s");
-    int i = 0; for(LPWSTR label : btnLabels[grpId])
-      flushErr("   %d. %s\n", ++i, *wide2uf8(label));
+  if(ctx.iBtn2>(UINT) nbButtons){
+    flushErr("\n Error: no button #%d, only %d button%s in group !\n", ctx.iBtn2, nbButtons, nbButtons==1 ? "" : "s");
+    listButtons(ctx, grpId);
     flushErr("\nAbort.\n\n");
     return FALSE;
   }
 
-  ULONG iBtn11 = iBtn1, iBtn22 = iBtn2;
-  iBtn2 < iBtn1 ? (iBtn22 = iBtn1) & (iBtn11 = iBtn2) : true;
+  ULONG iBtn11 = ctx.iBtn1, iBtn22 = ctx.iBtn2;
+  ctx.iBtn2 < ctx.iBtn1 ? (iBtn22 = ctx.iBtn1) & (iBtn11 = ctx.iBtn2) : true;
 
-  flushOut("    Moving button #%lu (%s) to position %lu", iBtn22, *wide2uf8(btnLabels[grpId][iBtn22-1]), iBtn11);
-  if(TTLib_ButtonMoveInButtonGroup(btnGrps[grpId], iBtn22-1, iBtn11-1)) flushOut(" .. done\n");
+  flushOut("    Moving button #%lu (%s) to position %lu", iBtn22, *wide2uf8(ctx.btnLabels[grpId][iBtn22-1].c_str()), iBtn11);
+  if(ttMove(ctx, grpId, iBtn22-1, iBtn11-1)) flushOut(" .. done\n");
   else{ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
 
   if(iBtn11==(iBtn22-1)){
-    flushOut("    Swap done, button #%lu (%s) now in position %lu\n\n", iBtn11, *wide2uf8(btnLabels[grpId][iBtn11-1]), iBtn22);
+    flushOut("    Swap done, button #%lu (%s) now in position %lu\n\n", iBtn11, *wide2uf8(ctx.btnLabels[grpId][iBtn11-1].c_str()), iBtn22);
     return TRUE;
   }
 
-  flushOut("    Moving button #%lu (%s) to position %lu", iBtn11+1, *wide2uf8(btnLabels[grpId][iBtn11-1]), iBtn22);
-  if(TTLib_ButtonMoveInButtonGroup(btnGrps[grpId], iBtn11, iBtn22-1)) flushOut(" .. done\n    Buttons swapped.\n\n");
+  flushOut("    Moving button #%lu (%s) to position %lu", iBtn11+1, *wide2uf8(ctx.btnLabels[grpId][iBtn11-1].c_str()), iBtn22);
+  if(ttMove(ctx, grpId, iBtn11, iBtn22-1)) flushOut(" .. done\n    Buttons swapped.\n\n");
   else{ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
 
   return TRUE;
 }
 
-BOOL mvTaskbarButtonsGr(HANDLE hTaskbar){
+// Several -f/-t pairs (-s : swaps), each on the order the previous ones left, compiled into one plan. The moves each pair
+// would make alone, then a peephole pass : consecutive moves of one button merge (a -> b, b -> c : a -> c), those that
+// cancel out go. What is left is one permutation of the group, made with the fewest moves (permutationMoves() : never
+// more than the peephole's, which only tells how much the pairs had in common).
+BOOL mvTaskbarButtonsMulti(opContext &ctx, HANDLE hTaskbar){
+
+  int grpId = groupByLabel(ctx, ctx.group); if(grpId<0) return FALSE;
+  ctx.group = (ctx.grpNames[0] = ctx.appIds[grpId]).data();
+  int nb = (int) ctx.btnLabels[grpId].size();
+
+  vector<pair<int,int>> given, peep;  // (from, to), 0-based
+  for(size_t k = 0; k < ctx.moveOps.size(); k++){
+    auto &op = ctx.moveOps[k];
+    int from = op.from1==9999 ? nb : (int) op.from1, to = op.to==9999 ? nb : (int) op.to, n = (int) op.from.size();
+    if(ctx.GRACEFUL) to = min(to, nb);
+    int hi = max(n ? (int) *op.from.crbegin() : from, to);
+    if(hi > nb){
+      flushErr("\n Error: pair #%zu : no position %d, group #%d has only %d button%s !\n", k+1, hi, grpId+1, nb, nb==1 ? "" : "s");
+      listButtons(ctx, grpId);
+      flushErr("\nAbort.\n\n");
+      return FALSE;
+    }
+    if(ctx.SWAP){
+      int a = min(from, to), b = max(from, to);
+      if(a < b) given.emplace_back(b-1, a-1);
+      if(a < b-1) given.emplace_back(a, b-1);
+    }
+    else if(!n){ if(from != to) given.emplace_back(from-1, to-1); }
+    else if(n < nb){  // as mvTaskbarButtons(ctx) : selected ones at t, in order
+      int t = min(to, nb-n+1), sel = 0, oth = 0; vector<int> rank(nb);
+      for(int i = 1; i <= nb; i++) rank[i-1] = op.from.count(i) ? t-1 + sel++ : oth < t-1 ? oth++ : n + oth++;
+      for(auto m : permutationMoves(rank)) given.push_back(m);
+    }
+  }
+  for(auto [from, to] : given){
+    if(!peep.empty() && peep.back().second == from){ from = peep.back().first; peep.pop_back(); }
+    if(from != to) peep.emplace_back(from, to);
+  }
+  vector<int> order(nb), rank(nb);
+  for(int i = 0; i < nb; i++) order[i] = i;
+  for(auto [from, to] : peep){ int b = order[from]; order.erase(order.begin()+from); order.insert(order.begin()+to, b); }
+  for(int i = 0; i < nb; i++) rank[order[i]] = i;
+  auto perm = permutationMoves(rank);
+
+  flushOut("\n  %zu %s : %zu move%s as given, %zu after peephole, %zu as one permutation", ctx.moveOps.size(), ctx.SWAP ? "swaps" : "moves",
+    given.size(), given.size()==1 ? "" : "s", peep.size(), perm.size());
+  outSet("moves_given", (long long) given.size()); outSet("moves_peephole", (long long) peep.size()); outSet("moves", (long long) perm.size());
+  if(perm.empty()){ flushOut(". Nothing to do.\n\n"); return TRUE; }
+
+  for(auto [from, to] : perm) if(!ttMove(ctx, grpId, from, to)){ flushErr("\n\n Error: operation failed\n\n"); return FALSE; }
+  flushOut(" .. done\n\n");
+  return TRUE;
+}
+
+// Moves (from, to) (0-based, applied in sequence) turning current order into target order with the fewest moves.
+// rank[i] : target position of the button now at position i. Buttons on a longest increasing run of ranks stay put,
+// every other one is moved once, right after its predecessor in target order : n - LIS moves.
+vector<pair<int,int>> permutationMoves(const vector<int> &rank){
+  int n = (int) rank.size();
+  vector<int> tails, tailIdx, prev(n, -1);  // patience sorting, O(n log n)
+  for(int i = 0; i < n; i++){
+    int k = (int) (lower_bound(tails.begin(), tails.end(), rank[i]) - tails.begin());
+    if(k == (int) tails.size()){ tails.push_back(rank[i]); tailIdx.push_back(i); }
+    else{ tails[k] = rank[i]; tailIdx[k] = i; }
+    prev[i] = k ? tailIdx[(size_t)k-1] : -1;
+  }
+  vector<bool> keep(n, false);
+  for(int i = tailIdx.empty() ? -1 : tailIdx.back(); i >= 0; i = prev[i]) keep[rank[i]] = true;
+
+  vector<pair<int,int>> moves; vector<int> cur(rank);
+  auto at = [&cur](int r){ return (int) (find(cur.begin(), cur.end(), r) - cur.begin()); };
+  for(int r = 0; r < n; r++){ if(keep[r]) continue;
+    int i = at(r), t = 0;
+    if(r > 0){ int q = at(r-1); t = i > q ? q+1 : q; }
+    if(i == t) continue;
+    moves.emplace_back(i, t);
+    cur.erase(cur.begin()+i); cur.insert(cur.begin()+t, r);
+  }
+  return moves;
+}
+
+// -g <group label> --sort <title|natural|hwnd|creation|exe> [--desc]
+BOOL sortTaskbarButtons(opContext &ctx, HANDLE hTaskbar){
+
+  int grpId = groupByLabel(ctx, ctx.group); if(grpId<0) return FALSE;
+  ctx.group = (ctx.grpNames[0] = ctx.appIds[grpId]).data();
+  int nbButtons = (int) ctx.btnLabels[grpId].size();
+  vector<wstring> &labels = ctx.btnLabels[grpId]; vector<HWND> &hwnds = ctx.btnWNHs[grpId];
+
+  // creation : of the owning process (not known : last), exe : its image name
+  vector<const procInfo*> proc; if(ctx.sortBy==sortKey::creation || ctx.sortBy==sortKey::exe) for(HWND h : hwnds) proc.push_back(&wndProcess(h));
+  auto created = [&proc](int i){ return proc[i]->start ? proc[i]->start : ULLONG_MAX; };
+  auto less = [&](int a, int b)->bool{
+    switch(ctx.sortBy){
+      case sortKey::title:    return lstrcmpiW(labels[a].c_str(), labels[b].c_str()) < 0;
+      case sortKey::natural:  return StrCmpLogicalW(labels[a].c_str(), labels[b].c_str()) < 0;
+      case sortKey::hwnd:     return (ULONG_PTR) hwnds[a] < (ULONG_PTR) hwnds[b];
+      case sortKey::creation: return created(a) < created(b);
+      case sortKey::exe:      return lstrcmpiW(proc[a]->name.c_str(), proc[b]->name.c_str()) < 0;
+    } return false;
+  };
+  vector<int> order(nbButtons); for(int i = 0; i < nbButtons; i++) order[i] = i;
+  if(ctx.SORT_DESC) stable_sort(order.begin(), order.end(), [&less](int a, int b){ return less(b, a); });
+  else stable_sort(order.begin(), order.end(), less);
+
+  vector<int> rank(nbButtons); for(int i = 0; i < nbButtons; i++) rank[order[i]] = i;
+  auto moves = permutationMoves(rank);
+  if(moves.empty()){ flushOut("\n  Group \"%s\" is already sorted. Nothing to do.\n\n", *wide2uf8(ctx.group)); return TRUE; }
+
+  flushOut("\n  Sorting %d buttons of group \"%s\" (%zu move%s)", nbButtons, *wide2uf8(ctx.group), moves.size(), moves.size()==1 ? "" : "s");
+  for(auto &[from, to] : moves)
+    if(!ttMove(ctx, grpId, from, to)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+  flushOut(" .. done\n\n");
+  return TRUE;
+}
+
+// Group names free on this taskbar : name, else name~2, name~3, .. (those given out taken too)
+struct groupNamer{
+  set<wstring> taken;
+  groupNamer(const vector<wstring> &appIds) : taken(appIds.begin(), appIds.end()) {}
+  wstring operator()(const wstring &name){
+    wstring n = name; for(int i = 2; taken.count(n); i++) n = name + L"~" + to_wstring(i);
+    taken.insert(n); return n;
+  }
+};
+
+BOOL mvTaskbarButtonsGr(opContext &ctx, HANDLE hTaskbar){
 
   // -cg <from group label> -f <position from|0> -tg <to group label|[NEW] or [RAND]> [-t <position to=end|start|end>]
-  int grpId = groupByLabel(grpFrom); if(grpId<0) return FALSE;
-  grpFrom = appIds[grpId];
+  int grpId = groupByLabel(ctx, ctx.grpFrom); if(grpId<0) return FALSE;
+  ctx.grpFrom = (ctx.grpNames[1] = ctx.appIds[grpId]).data();
+  if(regroupWaits(ctx, ctx.grpFrom)) return FALSE;
 
-  if(btnCnts[grpId]<=0){
-    flushErr("\n Error: group #%d: %s\n has no buttons !!\nAbort.\n\n", grpId+1, *wide2uf8(appIds[grpId]));
+  if(ctx.btnCnts[grpId]<=0){
+    flushErr("\n Error: group #%d: %s\n has no buttons !!\nAbort.\n\n", grpId+1, *wide2uf8(ctx.appIds[grpId].c_str()));
     return FALSE;
   }
-  UINT nbButtons = (UINT) btnCnts[grpId];
+  UINT nbButtons = (UINT) ctx.btnCnts[grpId];
 
-  UINT nbBtns1 = (UINT) iBtn1s.size();
-  ULONG lower = 0, upper = 0; if(nbBtns1){ lower = *iBtn1s.cbegin(); upper = *iBtn1s.crbegin(); }
-  if(iBtn1 == 9999) iBtn1 = nbButtons;
-  ULONG n = (nbBtns1 && lower > nbButtons) ? *iBtn1s.begin() : 0;  
+  UINT nbBtns1 = (UINT) ctx.iBtn1s.size();
+  ULONG lower = 0, upper = 0; if(nbBtns1){ lower = *ctx.iBtn1s.cbegin(); upper = *ctx.iBtn1s.crbegin(); }
+  if(ctx.iBtn1 == 9999) ctx.iBtn1 = nbButtons;
+  ULONG n = (nbBtns1 && lower > nbButtons) ? *ctx.iBtn1s.begin() : 0;  
   if(n==0 && upper > nbButtons){
-    if(GRACEFUL){
+    if(ctx.GRACEFUL){
       flushOut("\n  Source group has only %d button%s (no position %d).", nbButtons, nbButtons==1?"":"s", upper);
-      for(auto btn : iBtn1s) if(btn>nbButtons) iBtn1s.erase(btn);
-      n = 0; upper = *iBtn1s.crbegin(); nbBtns1 = (UINT) iBtn1s.size();
+      for(auto btn : ctx.iBtn1s) if(btn>nbButtons) ctx.iBtn1s.erase(btn);
+      n = 0; upper = *ctx.iBtn1s.crbegin(); nbBtns1 = (UINT) ctx.iBtn1s.size();
     } 
     else n = upper; // let it err :
   }
-  if(n>nbButtons || ( iBtn1>0 && iBtn1 > nbButtons )){
-    flushErr("\n Error: move button #%d : group #%d has only %d button%s !\n", n?n:iBtn1, grpId+1, nbButtons, nbButtons==1?"":"s");
-    int i = 0; for(LPWSTR label : btnLabels[grpId])
-      flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+  if(n>nbButtons || ( ctx.iBtn1>0 && ctx.iBtn1 > nbButtons )){
+    flushErr("\n Error: move button #%d : group #%d has only %d button%s !\n", n?n:ctx.iBtn1, grpId+1, nbButtons, nbButtons==1?"":"s");
+    listButtons(ctx, grpId);
     flushErr("\nAbort.\n\n");
     return FALSE;
   }
-  //cout <<nbButtons <<" "<<nbBtns1<< flush;
   
-  if(NEW_GROUP){
-    flushOut("      Random new group: %s\n", *wide2uf8(grpTo));
-    bool grToExists = false, really = false; for(auto gr : appIds) if(really = grToExists = (0==lstrcmpW(gr, grpTo))) break;
-    UINT i = 0;  while(grToExists && ++i<=100){
-      grpTo = *uf8toWide(*catStr({ "random_", random_string(2+(i<11?(size_t)i:10), true).c_str() }));
-      flushOut("        A group with that name exists already ! New random name: ", *wide2uf8(grpTo));
-      grToExists = false; for(auto gr : appIds) if(grToExists = (0==lstrcmpW(gr, grpTo))) break;
-    }; if(really && !grToExists) flushOut("        OK, no such group exists, using this name.");
-    if(really && grToExists){ flushOut("\n Error: could not generate a random group name that is not already in use !!\n\n"); return FALSE; }
+  if(ctx.NEW_GROUP){
+    ctx.grpTo = (ctx.grpNames[2] = groupNamer(ctx.appIds)(ctx.grpNames[2])).data();  // random_nn, or random_nn~2 ..
+    flushOut("      Random new group: %s\n", *wide2uf8(ctx.grpTo));
+    if(ctx.regroups) ctx.regroups->groups.insert({ ctx.tbId, ctx.grpFrom }), ctx.regroups->groups.insert({ ctx.tbId, ctx.grpTo });
     
     
     // contiguous set ?
-    bool contiguous = true; if(nbBtns1){ n = lower-1; for(auto btn : iBtn1s){ if(btn != n+1){ contiguous = false; break; }; n = btn; }}
+    bool contiguous = true; if(nbBtns1){ n = lower-1; for(auto btn : ctx.iBtn1s){ if(btn != n+1){ contiguous = false; break; }; n = btn; }}
     else contiguous = false;
     
     // mv all buttons
 
-    if( ( nbBtns1==0 && iBtn1==0) || ( contiguous && lower==1 && upper==nbButtons ) ){ 
+    if( ( nbBtns1==0 && ctx.iBtn1==0) || ( contiguous && lower==1 && upper==nbButtons ) ){ 
+      if(regroupWaits(ctx, L"")) return FALSE;  // the group moved by its position : the run's groups in place first
       flushOut("  Moving %s to new group", nbButtons==1? "the only button" : "all buttons");
-      for(i = 0; i < nbButtons; i++)
-        if(!WndSetAppId(btnWNHs[grpId][i], grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+      for(int i = 0; i < nbButtons; i++)
+        if(!ttSetAppId(ctx, ctx.btnWNHs[grpId][i], ctx.grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
       flushOut(" .. done (group renamed)\n\n");
 
-      if(!TTLib_unload_reload()) return FALSE;  // TTLib_ManipulationEnd() failed ?
+      if(!ttReload(ctx)) return FALSE;  // TTLib_ManipulationEnd() failed ?
 
-      if(!TTLib_ButtonGroupMove(hTaskbar, (UINT)appIds.size(), grpId)){   
+      if(!ttGroupMove(ctx, hTaskbar, (int)ctx.appIds.size(), grpId)){   
         flushErr("\n Error: failed to move new group to position %d\n\n", grpId+1); return FALSE; }
       return TRUE;
     } 
     else{
-      if(iBtn1) iBtn1s.insert(iBtn1); nbBtns1 = (UINT) iBtn1s.size();
+      if(ctx.iBtn1) ctx.iBtn1s.insert(ctx.iBtn1); nbBtns1 = (UINT) ctx.iBtn1s.size();
       if(nbBtns1==1) flushOut("  Moving button to new group");
       else flushOut("  Moving %d buttons to new group", nbBtns1);
-      for(auto btn : iBtn1s)
-        if(!WndSetAppId(btnWNHs[grpId][btn-1], grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+      for(auto btn : ctx.iBtn1s)
+        if(!ttSetAppId(ctx, ctx.btnWNHs[grpId][btn-1], ctx.grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
       flushOut(" .. done\n\n");
       return TRUE;
     }
   }   // end NEW_GROUP
   else { 
     
-    int grpId2 = groupByLabel(grpTo); if(grpId2<0) return FALSE;
-    grpTo = appIds[grpId2];
-    n = btnCnts[grpId2];
+    int grpId2 = groupByLabel(ctx, ctx.grpTo); if(grpId2<0) return FALSE;
+    ctx.grpTo = (ctx.grpNames[2] = ctx.appIds[grpId2]).data();
+    if(regroupWaits(ctx, ctx.grpTo)) return FALSE;
+    if(ctx.regroups) ctx.regroups->groups.insert({ ctx.tbId, ctx.grpFrom }), ctx.regroups->groups.insert({ ctx.tbId, ctx.grpTo });
+    n = ctx.btnCnts[grpId2];
     if(n<=0){
-      flushErr("\n Error: group #%d: %s\n has no buttons !!\n", grpId2+1, *wide2uf8(appIds[grpId2]));
-      int i = 0; for(LPWSTR label : btnLabels[grpId2])
-        flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+      flushErr("\n Error: group #%d: %s\n has no buttons !!\n", grpId2+1, *wide2uf8(ctx.appIds[grpId2].c_str()));
+      listButtons(ctx, grpId2);
       flushErr("\nAbort.\n\n");
       return FALSE;
     }
 
     UINT nbButtons2 = (UINT) n;
-    if(iBtn2 == 9999) iBtn2 = 1+nbButtons2;
-    if(GRACEFUL && iBtn2 > 1+nbButtons2){
-      flushOut("\n  Target group has only %d button%s (no position %d).", nbButtons2, nbButtons2==1 ? "" : "s", iBtn2);
-      iBtn2 = 1+nbButtons2;
-    }
-    else if(iBtn2 > 1+nbButtons2){
-      flushErr("\n Error: move to position #%d : target group has only %d button%s !\n", iBtn2, nbButtons2, nbButtons2==1 ? "" : "s");
-      int i = 0; for(LPWSTR label : btnLabels[grpId2])
-        flushErr("   %3d. %s\n", ++i, *wide2uf8(label));
+    if(ctx.iBtn2 == 9999) ctx.iBtn2 = 1+nbButtons2;
+    if(ctx.GRACEFUL && ctx.iBtn2 > 1+nbButtons2){
+      flushOut("\n  Target group has only %d button%s (no position %d).", nbButtons2, nbButtons2==1 ? "" : "s", ctx.iBtn2);
+      ctx.iBtn2 = 1+nbButtons2;
+    }
+    else if(ctx.iBtn2 > 1+nbButtons2){
+      flushErr("\n Error: move to position #%d : target group has only %d button%s !\n", ctx.iBtn2, nbButtons2, nbButtons2==1 ? "" : "s");
+      listButtons(ctx, grpId2);
       flushErr("\nAbort.\n\n");
       return FALSE;
     }
     
     
-    if(!nbBtns1 && iBtn1==0){ // mv all buttons
-      flushOut("\n  Moving button%s to end of group \"%s\"", nbButtons==1?"":"s", *wide2uf8(grpTo));
+    // Regrouped buttons land at the end of the target : there already, or, once TTLib reloaded, moved forward to the target
+    // position (newcomers-forward), or the target's buttons from that position moved behind them (originals-to-end).
+    auto regroupPlan = [&](UINT k){
+      if(ctx.iBtn2==(1+nbButtons2) || ctx.regroups) return 0;  // at the end already, or placed once the batch's run reloaded
+      double regroup = k*planCost("appid"), reload = planCost("reload");
+      return planChoose(ctx, { { "regroup+newcomers-forward", regroup + reload + moveCost(k) },
+                          { "regroup+originals-to-end", regroup + reload + moveCost(nbButtons2-ctx.iBtn2+1) } });
+    };
+    // The target's buttons from iBtn2 on, moved behind the k newcomers
+    auto originalsToEnd = [&](UINT k){
+      for(UINT i = ctx.iBtn2; i <= nbButtons2; i++) if(!ttMove(ctx, grpId2, ctx.iBtn2-1, nbButtons2+k-1)){ flushErr("\n\n Error: operation failed\n\n"); return FALSE; }
+      flushOut(" .. done\n\n"); return TRUE;
+    };
+
+    if(!nbBtns1 && ctx.iBtn1==0){ // mv all buttons
+      int how = regroupPlan(nbButtons);
+      flushOut("\n  Moving button%s to end of group \"%s\"", nbButtons==1?"":"s", *wide2uf8(ctx.grpTo));
       for(UINT i = 0; i < nbButtons; i++)
-        if(!WndSetAppId(btnWNHs[grpId][i], grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+        if(!ttSetAppId(ctx, ctx.btnWNHs[grpId][i], ctx.grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
       flushOut(" .. done\n");
-      if(iBtn2==(1+nbButtons2)){ flushOut("\n"); return TRUE; }
+      if(ctx.iBtn2==(1+nbButtons2)){ flushOut("\n"); return TRUE; }
 
-      flushOut("  Moving button%s to position %lu within \"%s\"", nbButtons==1?"":"s", iBtn2, *wide2uf8(grpTo));
+      flushOut("  Moving button%s to position %lu within \"%s\"", nbButtons==1?"":"s", ctx.iBtn2, *wide2uf8(ctx.grpTo));
 
-      if(!TTLib_unload_reload()) return FALSE;  // TTLib_ManipulationEnd() failed ?
+      if(ctx.regroups) return regroupDefer(ctx, ctx.btnWNHs[grpId]);
+      if(!ttReload(ctx)) return FALSE;  // TTLib_ManipulationEnd() failed ?
+      if(how==1) return originalsToEnd(nbButtons);
       
       int j = 0;
       for(UINT i = nbButtons2; i < nbButtons2+nbButtons; i++)
-        if(!TTLib_ButtonMoveInButtonGroup(btnGrps[grpId2], i, iBtn2+(j++)-1)){
+        if(!ttMove(ctx, grpId2, i, ctx.iBtn2+(j++)-1)){
           flushErr("\n\n Error: operation failed\n\n"); return FALSE;
         }
       flushOut(" .. done\n\n"); return TRUE;
@@ -614,24 +1215,27 @@ BOOL mvTaskbarButtonsGr(HANDLE hTaskbar){
       return TRUE;
     }
     else{  n = 0;
-      if(nbBtns1) flushOut("  Moving %d button%s to end of group \"%s\"", nbBtns1, nbBtns1==1?"":"s", *wide2uf8(grpTo));
+      int how = regroupPlan(nbBtns1 ? nbBtns1 : 1);
+      if(nbBtns1) flushOut("  Moving %d button%s to end of group \"%s\"", nbBtns1, nbBtns1==1?"":"s", *wide2uf8(ctx.grpTo));
       else{
-        iBtn1s.insert(iBtn1); nbBtns1 = (UINT) iBtn1s.size(); n = 1;
-        flushOut("  Moving button #%lu to end of group \"%s\"", iBtn1, *wide2uf8(grpTo));
+        ctx.iBtn1s.insert(ctx.iBtn1); nbBtns1 = (UINT) ctx.iBtn1s.size(); n = 1;
+        flushOut("  Moving button #%lu to end of group \"%s\"", ctx.iBtn1, *wide2uf8(ctx.grpTo));
       }
-      UINT j = 0; for(auto btn : iBtn1s)
-        if(++j<=nbBtns1 && !WndSetAppId(btnWNHs[grpId][btn-1], grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+      UINT j = 0; for(auto btn : ctx.iBtn1s)
+        if(++j<=nbBtns1 && !ttSetAppId(ctx, ctx.btnWNHs[grpId][btn-1], ctx.grpTo)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
       flushOut(" .. done\n");
-      if(iBtn2==(1+nbButtons2)){ flushOut("\n"); return TRUE; }
+      if(ctx.iBtn2==(1+nbButtons2)){ flushOut("\n"); return TRUE; }
       
-      if(n==0)  flushOut("  Moving %d button%s to position %lu within \"%s\"", nbBtns1, nbBtns1==1?"":"s", iBtn2, *wide2uf8(grpTo));
-      else flushOut("  Moving button to position %lu within \"%s\"", iBtn2, *wide2uf8(grpTo));
+      if(n==0)  flushOut("  Moving %d button%s to position %lu within \"%s\"", nbBtns1, nbBtns1==1?"":"s", ctx.iBtn2, *wide2uf8(ctx.grpTo));
+      else flushOut("  Moving button to position %lu within \"%s\"", ctx.iBtn2, *wide2uf8(ctx.grpTo));
 
-      if(!TTLib_unload_reload()) return FALSE;
+      if(ctx.regroups){ vector<HWND> hwnds; for(auto btn : ctx.iBtn1s) hwnds.push_back(ctx.btnWNHs[grpId][btn-1]); return regroupDefer(ctx, move(hwnds)); }
+      if(!ttReload(ctx)) return FALSE;
+      if(how==1) return originalsToEnd(nbBtns1);
       
       j = 0;
       for(UINT i = nbButtons2; i < nbButtons2+nbBtns1; i++)  
-        if(!TTLib_ButtonMoveInButtonGroup(btnGrps[grpId2], i, iBtn2+(j++)-1)){
+        if(!ttMove(ctx, grpId2, i, ctx.iBtn2+(j++)-1)){
           flushErr("\n\n Error: operation failed\n\n"); return FALSE;
         }
 
@@ -639,216 +1243,1229 @@ BOOL mvTaskbarButtonsGr(HANDLE hTaskbar){
     }
   }
 
-  #undef chkCallRet
-  
   return FALSE;
 
 }
 
-BOOL mvButtons(HANDLE hTaskbar)
-{
-  getButtonGroups(hTaskbar);
-  if(!chgGroup) return mvTaskbarButtons(hTaskbar);
-  return mvTaskbarButtonsGr(hTaskbar);
+// --split, --merge : the AppIds of all buttons set in one pass, one reload, then the groups added placed after anchor
+// (the nearest group before them that stays, "" : first), with the fewest group moves
+BOOL regroupCommit(opContext &ctx, HANDLE hTaskbar, const vector<pair<HWND, wstring>> &assign, const vector<wstring> &added, const wstring &anchor){
+  for(auto &[h, appId] : assign)
+    if(!ttSetAppId(ctx, h, appId.c_str())){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+  flushOut(" .. done\n");
+  if(!ttReload(ctx)) return FALSE;
+  if(added.empty()){ flushOut("\n"); return TRUE; }
+  ctx.clear(); getButtonGroups(ctx, hTaskbar);
+
+  // Target order : the groups as they are, those added taken out and put back after anchor
+  auto isAdded = [&added](const wstring &a){ return find(added.begin(), added.end(), a) != added.end(); };
+  vector<wstring> order; for(auto &a : ctx.appIds) if(!isAdded(a)) order.push_back(a);
+  auto at = anchor.empty() ? order.end() : find(order.begin(), order.end(), anchor);
+  at = at == order.end() ? order.begin() : next(at);
+  for(auto &a : added) if(find(ctx.appIds.begin(), ctx.appIds.end(), a) != ctx.appIds.end()) at = next(order.insert(at, a));
+  map<wstring, int> target; for(int i = 0; i < (int) order.size(); i++) target.emplace(order[i], i);
+  vector<int> rank(ctx.appIds.size()); for(size_t i = 0; i < rank.size(); i++) rank[i] = target[ctx.appIds[i]];
+
+  auto moves = permutationMoves(rank);
+  flushOut("  Placing %zu group%s (%zu group move%s)", added.size(), added.size()==1 ? "" : "s", moves.size(), moves.size()==1 ? "" : "s");
+  for(auto &[from, to] : moves)
+    if(!ttGroupMove(ctx, hTaskbar, from, to)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+  flushOut(" .. done\n\n");
   return TRUE;
 }
 
-void allocFail() {
-  cerr << "\n Error: memory allocation failure, aborting.\n";
-  TTLib_unload_reload(unLoadOnly);
-  exit(55);  //set_new_handler(nullptr);
+// --split <group> by <selector> : selector exe : a group per executable (the first one's buttons stay), named
+// <AppId>.<exe name> ; else selectors as -b's (title, pattern, exe=<pattern>) separated by ; : a group per selector with
+// the buttons it selects first, named <AppId>.<n> (the others stay). The new groups follow the group split.
+BOOL splitGroup(opContext &ctx, HANDLE hTaskbar){
+  int grpId = groupByLabel(ctx, ctx.group); if(grpId<0) return FALSE;
+  wstring src = ctx.grpNames[0] = ctx.appIds[grpId]; ctx.group = ctx.grpNames[0].data();
+  vector<HWND> &hwnds = ctx.btnWNHs[grpId]; int nbButtons = (int) hwnds.size();
+  vector<int> part(nbButtons, -1); vector<wstring> labels;  // part : the new group of each button (-1 : stays)
+
+  if(wstrEqI<WCHAR>(ctx.button, L"exe")){
+    for(int p = 0; p < nbButtons; p++){
+      wstring name = wndProcess(hwnds[p]).name; if(name.empty()) continue;
+      if(size_t dot = name.find_last_of(L'.'); dot != wstring::npos && dot) name.resize(dot);
+      auto it = find_if(labels.begin(), labels.end(), [&name](const wstring &l){ return wstrEqI(l.c_str(), name.c_str()); });
+      part[p] = (int) (it - labels.begin()); if(it == labels.end()) labels.push_back(name);
+    }
+    for(int &k : part) k--;  // the first executable's stay
+    if(!labels.empty()) labels.erase(labels.begin());
+  }
+  else{
+    LPWSTR spec = ctx.button; wstring all = spec;
+    for(size_t at = 0, end; at <= all.size(); at = end + 1){
+      end = all.find(L';', at); if(end == wstring::npos) end = all.size();
+      wstring sel = all.substr(at, end - at); if(sel.empty()) continue;
+      ctx.button = sel.data();
+      for(auto &h : titleHits(ctx, grpId)) if(part[h.pos] < 0) part[h.pos] = (int) labels.size();
+      labels.push_back(to_wstring(labels.size() + 1));
+    }
+    ctx.button = spec;
+  }
+
+  groupNamer fresh(ctx.appIds); vector<wstring> names(labels.size()), added;
+  vector<pair<HWND, wstring>> assign; int stay = 0;
+  for(int p = 0; p < nbButtons; p++){
+    if(part[p] < 0){ stay++; continue; }
+    wstring &n = names[part[p]]; if(n.empty()) n = fresh(src + L"." + labels[part[p]]);
+    assign.emplace_back(hwnds[p], n);
+  }
+  for(auto &n : names) if(!n.empty()) added.push_back(n);
+  if(added.empty()){ flushOut("\n  Group \"%s\" : no button selected. Nothing to do.\n\n", *wide2uf8(src.c_str())); return TRUE; }
+
+  flushOut("\n  Splitting %zu of %d buttons of group \"%s\" into %zu new group%s :\n", assign.size(), nbButtons, *wide2uf8(src.c_str()),
+    added.size(), added.size()==1 ? "" : "s");
+  for(auto &n : added) flushOut("      %s (%zd)\n", *wide2uf8(n.c_str()), count_if(assign.begin(), assign.end(), [&n](auto &a){ return a.second == n; }));
+  flushOut("  Setting %zu AppId%s", assign.size(), assign.size()==1 ? "" : "s");
+  return regroupCommit(ctx, hTaskbar, assign, added, stay ? src : grpId ? ctx.appIds[grpId-1] : L"");
 }
 
-int processArgs(int argc, char const* const* const& argv, LPWSTR const* const& arglist);
-int main(int argc, char **argv)
+// --merge <g1,g2,..> into <g> : the buttons of groups g1, g2, .. (labels, as -g's) moved to the end of group g. No group
+// labeled g : a new group named g, in the first merged group's place.
+BOOL mergeGroups(opContext &ctx, HANDLE hTaskbar){
+  int into = -1, nMatch = 0;
+  for(int i = 0; i < ctx.nGroups; i++) if(wstrStrI<WCHAR>(ctx.appIds[i].c_str(), ctx.grpTo)){ into = i; nMatch++; }
+  for(int i = 0; i < ctx.nGroups && nMatch > 1; i++) if(wstrEqI<WCHAR>(ctx.appIds[i].c_str(), ctx.grpTo)){ into = i; nMatch = 1; }  // named exactly
+  if(nMatch > 1){ groupByLabel(ctx, ctx.grpTo); return FALSE; }  // its error : the matches
+  wstring target = ctx.grpNames[2] = into >= 0 ? ctx.appIds[into] : wstring(ctx.grpTo); ctx.grpTo = ctx.grpNames[2].data();
+
+  vector<int> from; wstring all = ctx.grpFrom;
+  for(size_t at = 0, end; at <= all.size(); at = end + 1){
+    end = all.find(L',', at); if(end == wstring::npos) end = all.size();
+    wstring label = all.substr(at, end - at); if(label.empty()) continue;
+    int g = groupByLabel(ctx, label.c_str()); if(g < 0) return FALSE;
+    if(g == into){ flushErr("\n Error: group \"%s\" is the target of the merge\n\nAbort.\n\n", *wide2uf8(ctx.appIds[g].c_str())); return FALSE; }
+    if(find(from.begin(), from.end(), g) == from.end()) from.push_back(g);
+  }
+  if(from.empty()){ flushErr("\n Error: no group to merge\n\nAbort.\n\n"); return FALSE; }
+
+  vector<pair<HWND, wstring>> assign;
+  for(int g : from) for(HWND h : ctx.btnWNHs[g]) assign.emplace_back(h, target);
+  int first = *min_element(from.begin(), from.end()), before = first - 1;
+  while(before >= 0 && find(from.begin(), from.end(), before) != from.end()) before--;
+
+  flushOut("\n  Merging %zu group%s (%zu buttons) into %sgroup \"%s\"", from.size(), from.size()==1 ? "" : "s", assign.size(),
+    into < 0 ? "new " : "", *wide2uf8(target.c_str()));
+  vector<wstring> added; if(into < 0) added.push_back(target);
+  return regroupCommit(ctx, hTaskbar, assign, added, before >= 0 ? ctx.appIds[before] : L"");
+}
+
+// The taskbar as enumerated (getButtonGroups(ctx)), published for --list/--complete
+snapshot snapTake(opContext &ctx, ULONG tb){
+  snapshot s; s.tb = tb;
+  for(int i = 0; i < ctx.nGroups; i++){
+    snapGroup g; g.appId = ctx.appIds[i];
+    if(i < (int) ctx.btnLabels.size()) for(size_t j = 0; j < ctx.btnLabels[i].size(); j++) g.buttons.push_back({ (ULONG_PTR) ctx.btnWNHs[i][j], ctx.btnLabels[i][j] });
+    s.groups.push_back(move(g));
+  }
+  return s;
+}
+void snapPublish(const snapshot &s){
+  if(inv->replay) return;  // taskbars of a trace
+  snapSegment seg; if(seg.open(s.tb, appDataDir(), true)) seg.publish(s);
+}
+// Snapshot age limit : env. var. MVBTN_SNAPSHOT_TTL
+ULONGLONG snapTtlMs(){
+  wstring val; if(!getEnvVar(L"MVBTN_SNAPSHOT_TTL", val)) return 5000;
+  return wcstoull(val.c_str(), nullptr, 10);
+}
+
+// --list [filter] / --complete [prefix] [-g group] output. age : ms, -1 if read live.
+void listSnapshot(opContext &ctx, const snapshot &s, long long age){
+  LPCWSTR filter = ctx.listArg ? ctx.listArg : L"";
+  if(ctx.COMPLETE){
+    vector<const snapGroup *> grps; for(auto &g : s.groups) if(!ctx.group || wstrStrI<WCHAR>(g.appId.c_str(), ctx.group)) grps.push_back(&g);
+    string json = "[";
+    auto put = [&](const wstring &str){
+      if(!wstrStrI<WCHAR>(str.c_str(), filter)) return;
+      flushOut("%s\n", *wide2uf8(str.c_str())); if(json.size() > 1) json += ","; json += jsonStr(*wide2uf8(str.c_str()));
+    };
+    if(ctx.group){ if(grps.size()==1) for(auto &b : grps[0]->buttons) put(b.title); }
+    else for(auto g : grps) put(g->appId);
+    outSetRaw("candidates", json + "]");
+  }
+  else{
+    if(age < 0) flushOut("\n Taskbar #%lu (read live)\n", s.tb);
+    else flushOut("\n Taskbar #%lu (snapshot #%llu, %.1f s old)\n", s.tb, s.gen, age/1000.);
+    string json = "[";
+    for(size_t i = 0; i < s.groups.size(); i++){ const snapGroup &g = s.groups[i];
+      if(!wstrStrI<WCHAR>(g.appId.c_str(), filter)) continue;
+      size_t n = g.buttons.size();
+      flushOut("   group #%zu: %s (%zu button%s)\n", i+1, *wide2uf8(g.appId.c_str()), n, n==1 ? "" : "s");
+      if(json.size() > 1) json += ",";
+      json += "{\"group\":" + to_string(i+1) + ",\"appId\":" + jsonStr(*wide2uf8(g.appId.c_str())) + ",\"buttons\":[";
+      for(size_t j = 0; j < n; j++){
+        flushOut("     %3zu. %s\n", j+1, *wide2uf8(g.buttons[j].title.c_str()));
+        json += (j ? ",{\"hwnd\":" : "{\"hwnd\":") + to_string(g.buttons[j].hwnd) + ",\"title\":" + jsonStr(*wide2uf8(g.buttons[j].title.c_str())) + "}";
+      }
+      json += "]}";
+    }
+    flushOut("\n");
+    outSetRaw("groups", json + "]");
+  }
+  if(age >= 0){ outSet("snapshot", (long long) s.gen); outSet("age_ms", age); }
+}
+
+// Changes between two snapshots : listed (text), "changes" array (json)
+void outChanges(const vector<snapChange> &cs, bool text = true){
+  static const char *kinds[] = { "group-added", "group-removed", "group-moved", "button-added", "button-removed", "button-moved", "button-retitled" };
+  string json = "[";
+  for(auto &c : cs){
+    string appId = *wide2uf8(c.appId.c_str()), title = *wide2uf8(c.title.c_str());
+    if(text) switch(c.kind){
+      case snapChange::groupAdded:     flushOut("   + group \"%s\" at #%d\n", appId.c_str(), c.to+1); break;
+      case snapChange::groupRemoved:   flushOut("   - group \"%s\" (was #%d)\n", appId.c_str(), c.from+1); break;
+      case snapChange::groupMoved:     flushOut("   ~ group \"%s\" moved #%d -> #%d\n", appId.c_str(), c.from+1, c.to+1); break;
+      case snapChange::buttonAdded:    flushOut("   + button \"%s\" in \"%s\" at #%d\n", title.c_str(), appId.c_str(), c.to+1); break;
+      case snapChange::buttonRemoved:  flushOut("   - button \"%s\" from \"%s\" (was #%d)\n", title.c_str(), appId.c_str(), c.from+1); break;
+      case snapChange::buttonMoved:    flushOut("   ~ button \"%s\" in \"%s\" moved #%d -> #%d\n", title.c_str(), appId.c_str(), c.from+1, c.to+1); break;
+      case snapChange::buttonRetitled: flushOut("   ~ button #%d in \"%s\" retitled \"%s\"\n", c.to+1, appId.c_str(), title.c_str()); break;
+    }
+    if(json.size() > 1) json += ",";
+    json += string("{\"change\":\"") + kinds[c.kind] + "\",\"appId\":" + jsonStr(appId);
+    if(c.hwnd) json += ",\"hwnd\":" + to_string(c.hwnd) + ",\"title\":" + jsonStr(title);
+    if(c.from >= 0) json += ",\"from\":" + to_string(c.from+1);
+    if(c.to >= 0) json += ",\"to\":" + to_string(c.to+1);
+    json += "}";
+  }
+  outSetRaw("changes", json + "]");
+}
+
+// --list/--complete from a fresh enough snapshot : no TTLib, no session
+bool listFromSnapshot(opContext &ctx){
+  snapshot s; snapSegment seg;
+  if(!seg.open(ctx.tbId, appDataDir(), false) || !seg.read(s)) return false;
+  long long age = (long long) (snapNow() - s.time); if(age < 0) age = 0;
+  if((ULONGLONG) age > snapTtlMs()) return false;
+  listSnapshot(ctx, s, age); phaseDone("snapshot");
+  return true;
+}
+
+// --dump [tsv|jsonl] : every button (a line for an empty group), written to stdout as enumerated, one group at a time.
+// tsv : taskbar group appId button hwnd title (tabs and line breaks of labels turned to spaces).
+BOOL dumpTaskbar(opContext &ctx, HANDLE hTaskbar){
+  bool tsv = ctx.dumpArg == "tsv"; long long nGrps = 0, nBtns = 0;
+  string appId, line;  // of the group being visited
+  auto put = [&](int grp, int pos, HWND hWnd, LPCWSTR title){
+    if(tsv){
+      string t = pos ? *wide2uf8(title) : ""; for(auto &c : t) if(c=='\t' || c=='\n' || c=='\r') c = ' ';
+      fprintf(stdout, pos ? "%lu\t%d\t%s\t%d\t0x%llx\t%s\n" : "%lu\t%d\t%s\t%d\t\t\n", ctx.tbId, grp+1, appId.c_str(), pos,
+        (unsigned long long) (ULONG_PTR) hWnd, t.c_str());
+    }
+    else{
+      line = "{\"taskbar\":" + to_string(ctx.tbId) + ",\"group\":" + to_string(grp+1) + ",\"appId\":" + appId + ",\"button\":" + to_string(pos);
+      if(pos) line += ",\"hwnd\":" + to_string((ULONG_PTR) hWnd) + ",\"title\":" + jsonStr(*wide2uf8(title));
+      line += "}\n"; fputs(line.c_str(), stdout);
+    }
+  };
+  if(tsv) fputs("taskbar\tgroup\tappId\tbutton\thwnd\ttitle\n", stdout);
+  BOOL ok = visitButtons(hTaskbar,
+    [&](int grp, LPCWSTR id, int nb){
+      if(nGrps++) fflush(stdout);  // the previous group is out
+      appId = tsv ? *wide2uf8(id) : jsonStr(*wide2uf8(id)); if(tsv) for(auto &c : appId) if(c=='\t') c = ' ';
+      if(!nb) put(grp, 0, nullptr, nullptr);
+      return true;
+    },
+    [&](int grp, int pos, HWND hWnd, LPCWSTR title){ nBtns++; put(grp, pos+1, hWnd, title); return true; });
+  fflush(stdout);
+  outSet("groups", nGrps); outSet("buttons", nBtns);
+  return ok;
+}
+
+HANDLE taskbarById(ULONG id);
+void statsReport(opContext &ctx);
+void latencySave();
+
+// --resident [ms] : publishes the snapshots of all taskbars every ms, between operations, until Ctrl+C
+static atomic<bool> residentStop{ false };
+BOOL WINAPI residentCtrl(DWORD){ residentStop = true; return TRUE; }
+
+int residentLoop(opContext &ctx){
+  SetConsoleCtrlHandler(residentCtrl, TRUE);
+  flushOut("\n  Publishing taskbar snapshots every %lu ms. Ctrl+C to stop.\n\n", ctx.residentMs); outFlush();
+  while(!residentStop){
+    if(sessLock(ctx.residentMs) != sessBusy){
+      inv->tPhase = chrono::steady_clock::now(); TTLibLoad(); phaseDone("load");
+      int nCount = 0; TTLib_GetSecondaryTaskbarCount(&nCount);
+      for(ULONG id = 0; id <= (ULONG) nCount; id++){
+        HANDLE hTaskbar = taskbarById(id); if(!hTaskbar) continue;
+        ctx.clear(); getButtonGroups(ctx, hTaskbar); snapPublish(snapTake(ctx, id)); phaseDone("enumerate");
+      }
+      TTLib_unload_reload(unLoadOnly); phaseDone("unload"); inv->phaseMs.clear(); latencySave(); sessUnlock();
+      statsReport(ctx); inv->allocAt = allocStats::now(); allocStats::resetPeak(); outFlush();
+    }
+    for(ULONG t = 0; t < ctx.residentMs && !residentStop; t += 50) Sleep(50);
+  }
+  return 0;
+}
+
+// Replays the inverses of a session's changes, latest first. Runs of moves within a group are composed into the
+// permutation they make, then applied with the fewest moves (permutationMoves()).
+BOOL undoReplay(opContext &ctx, HANDLE hTaskbar, const undoSession &ss){
+  bool stale = true, regrouped = false;  // snapshot to (re)read; window AppIds changed : reload for the regrouping
+  for(size_t k = ss.ops.size(); k > 0; ){
+    if(timedOut()) return FALSE;
+    const undoOp &op = ss.ops[k-1];
+    if(op.kind=='W'){
+      if(!traceCall("SetAppId", WndSetAppId, (HWND) (ULONG_PTR) op.hwnd, op.prior ? ss.appIds[op.prior-1].c_str() : nullptr)){
+        flushErr("\n Error: could not restore the AppId of window 0x%llx\n", (unsigned long long) op.hwnd); return FALSE; }
+      regrouped = stale = true; k--; continue;
+    }
+    if(regrouped){ if(!ttReload(ctx)) return FALSE; regrouped = false; }
+    if(stale){ ctx.clear(); getButtonGroups(ctx, hTaskbar); stale = false; }
+    if(op.kind=='G'){
+      if(!TTLib_ButtonGroupMove(hTaskbar, op.to, op.from)){ flushErr("\n Error: could not move group #%u back to #%u\n", op.to+1, op.from+1); return FALSE; }
+      stale = true; k--; continue;
+    }
+    size_t j = k-1; while(j > 0 && ss.ops[j-1].kind=='M' && ss.ops[j-1].grp==op.grp) j--;
+    LPCWSTR appId = ss.appIds[op.grp].c_str(); int g = -1;
+    for(int i = 0; i < ctx.nGroups; i++) if(ctx.appIds[i] == appId){ g = i; break; }
+    if(g < 0){ flushErr("\n Error: group \"%s\" is gone, cannot undo its moves\n", *wide2uf8(appId)); return FALSE; }
+    int n = ctx.btnCnts[g]; vector<int> order(n); for(int i = 0; i < n; i++) order[i] = i;
+    for(size_t i = k; i > j; i--){ const undoOp &m = ss.ops[i-1];
+      if((int) m.from >= n || (int) m.to >= n){ flushErr("\n Error: group \"%s\" has changed (%d buttons), cannot undo its moves\n", *wide2uf8(appId), n); return FALSE; }
+      int btn = order[m.to]; order.erase(order.begin()+m.to); order.insert(order.begin()+m.from, btn);
+    }
+    vector<int> rank(n); for(int i = 0; i < n; i++) rank[order[i]] = i;
+    for(auto &[from, to] : permutationMoves(rank))
+      if(!TTLib_ButtonMoveInButtonGroup(ctx.btnGrps[g], from, to)){ flushErr("\n Error: operation failed\n"); return FALSE; }
+    k = j;
+  }
+  return TRUE;
+}
+
+// --undo [n] : undoes the last n operations, latest first, and drops them from the log
+BOOL undoLast(opContext &ctx){
+  auto path = appDataDir() / L"undo.log";
+  auto ss = undoLog::load(path);
+  if(ss.empty()){ flushOut("\n  Nothing to undo.\n\n"); return TRUE; }
+  size_t n = min((size_t) ctx.undoCount, ss.size()), done = ss.size();
+  if(n < ctx.undoCount) flushOut("\n  Only %zu operation%s in the log.", n, n==1 ? "" : "s");
+
+  for(size_t i = ss.size(); i-- > ss.size()-n; ){
+    char when[32]; time_t t = (time_t) ss[i].time; strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+    flushOut("\n  Undoing operation of %s (%zu change%s)", when, ss[i].ops.size(), ss[i].ops.size()==1 ? "" : "s");
+    HANDLE hTaskbar = taskbarById(ss[i].tb);
+    if(!hTaskbar || !undoReplay(ctx, hTaskbar, ss[i])) break;
+    flushOut(" .. done"); done = i;
+  }
+  flushOut("\n\n");
+  if(done < ss.size()) undoLog::cut(path, ss[done].offset);
+  return done == ss.size()-n;
+}
+
+// --verify : reads back the positions the operation changed, in the groups it changed, and compares them with the expected
+// state. A window found further in the range is moved to its place (once, logged for undo), other divergences reported.
+BOOL verifyChanges(opContext &ctx, HANDLE hTaskbar){
+  if(ctx.expect.unseen && !ttReload(ctx)) return FALSE;  // TTLib sees regrouped windows once reloaded
+  int nGrp = 0; if(!TTLib_GetButtonGroupCount(hTaskbar, &nGrp)) return FALSE;
+  WCHAR szAppId[MAX_APPID_LENGTH];
+  auto groupAt = [&](int i, const wstring &appId) -> HANDLE {
+    HANDLE h = TTLib_GetButtonGroup(hTaskbar, i);
+    szAppId[0] = 0; TTLib_GetButtonGroupAppId(h, szAppId, MAX_APPID_LENGTH);
+    return appId == szAppId ? h : nullptr;
+  };
+  size_t nRead = 0, nFixed = 0; string json = "[";
+  auto diverge = [&](const wstring &appId, int pos, LPCSTR what, ULONGLONG seen, ULONGLONG want){
+    string grp = *wide2uf8(appId.c_str());
+    if(pos < 0) flushErr("\n Error: verify: group \"%s\" : %s %llu, expected %llu\n", grp.c_str(), what, seen, want);
+    else flushErr("\n Error: verify: group \"%s\", position %d : %s 0x%llx, expected 0x%llx\n", grp.c_str(), pos+1, what, seen, want);
+    if(json.size() > 1) json += ",";
+    json += "{\"appId\":" + jsonStr(grp) + (pos < 0 ? "" : ",\"position\":" + to_string(pos+1)) + ",\"found\":" + to_string(seen) + ",\"expected\":" + to_string(want) + "}";
+  };
+
+  for(auto &[appId, g] : ctx.expect.all()){
+    if(timedOut()) return FALSE;
+    // At its index as enumerated if it is still there, else searched from the end (where regrouping puts new groups)
+    HANDLE hGrp = g.grp >= 0 && g.grp < nGrp ? groupAt(g.grp, appId) : nullptr;
+    for(int i = nGrp; !hGrp && i-- > 0; ) if(i != g.grp) hGrp = groupAt(i, appId);
+    int n = 0; if(hGrp && !TTLib_GetButtonCount(hGrp, &n)) n = 0;
+    if(n != (int) g.order.size()){ diverge(appId, -1, "buttons", n, g.order.size()); continue; }
+    if(!g.changed() || !n) continue;
+
+    int lo = g.lo, hi = min(g.hi, n-1); vector<HWND> seen;
+    auto read = [&]{ seen.clear(); for(int p = lo; p <= hi; p++) seen.push_back(TTLib_GetButtonWindow(TTLib_GetButton(hGrp, p))); nRead += seen.size(); };
+    read(); size_t fixed = nFixed;
+    for(int p = lo; p <= hi; p++){
+      auto it = find(seen.begin() + (p-lo), seen.end(), g.order[p]);
+      if(it == seen.begin() + (p-lo) || it == seen.end()) continue;
+      int from = lo + (int) (it - seen.begin());
+      if(!TTLib_ButtonMoveInButtonGroup(hGrp, from, p)) continue;
+      inv->changeLog.move(appId.c_str(), from, p); nFixed++;
+      HWND h = *it; seen.erase(it); seen.insert(seen.begin() + (p-lo), h);
+    }
+    if(nFixed > fixed) read();
+    for(int p = lo; p <= hi; p++)
+      if(seen[p-lo] != g.order[p]) diverge(appId, p, "window", (ULONG_PTR) seen[p-lo], (ULONG_PTR) g.order[p]);
+  }
+
+  bool ok = json.size() == 1;
+  if(ok) flushOut("  Verified : %zu position%s read back in %zu group%s%s.\n\n", nRead, nRead==1 ? "" : "s", ctx.expect.all().size(),
+    ctx.expect.all().size()==1 ? "" : "s", nFixed ? (", " + to_string(nFixed) + " button" + (nFixed==1 ? "" : "s") + " moved again").c_str() : "");
+  outSetRaw("verify", "{\"read\":" + to_string(nRead) + ",\"fixed\":" + to_string(nFixed) + ",\"divergences\":" + json + "]}");
+  return ok;
+}
+
+BOOL mvButtons(opContext &ctx, HANDLE hTaskbar)
 {
-  BOOL bSuccess = FALSE;
+  BOOL ok; snapshot prior; bool hasPrior = false;
+  if(ctx.DIFF){ snapSegment seg; hasPrior = seg.open(ctx.tbId, appDataDir(), false) && seg.read(prior); }
+  inv->wd.phase("enumerate");
+  if(ctx.DUMP){ BOOL ok = dumpTaskbar(ctx, hTaskbar); phaseDone("enumerate"); return ok; }
+  auto kept = ctx.shared ? ctx.shared->find(ctx.tbId) : tbShared::iterator();
+  if(ctx.shared && kept != ctx.shared->end()) (tbEnumerated &) ctx = kept->second;
+  else{
+    getButtonGroups(ctx, hTaskbar);
+    if(ctx.shared && !timedOut()) (*ctx.shared)[ctx.tbId] = ctx;
+  }
+  phaseDone("enumerate");
+  if(timedOut()) return FALSE;
+  snapshot before = snapTake(ctx, ctx.tbId); snapRehash(before); snapPublish(before); inv->tracer.taskbar(before);
+  if(ctx.LIST || ctx.COMPLETE){ listSnapshot(ctx, before, -1); phaseDone("snapshot"); return TRUE; }
+  if(ctx.DIFF){
+    if(!hasPrior){ flushOut("\n  No snapshot to compare with : taskbar snapshot published.\n\n"); return TRUE; }
+    auto cs = snapDiff(prior, before); long long age = (long long) (snapNow() - prior.time);
+    flushOut("\n  %zu change%s since snapshot #%llu (%.1f s old)%s\n", cs.size(), cs.size()==1 ? "" : "s", prior.gen, age/1000., cs.empty() ? "." : " :");
+    outChanges(cs); flushOut("\n"); outSet("snapshot", (long long) prior.gen); outSet("age_ms", age);
+    phaseDone("diff"); return TRUE;
+  }
+  inv->wd.phase("execute");
+  if(ctx.SORT) ok = sortTaskbarButtons(ctx, hTaskbar);
+  else if(ctx.SPLIT) ok = splitGroup(ctx, hTaskbar);
+  else if(ctx.MERGE) ok = mergeGroups(ctx, hTaskbar);
+  else if(!ctx.moveOps.empty()) ok = mvTaskbarButtonsMulti(ctx, hTaskbar);
+  else if(!ctx.chgGroup) ok = mvTaskbarButtons(ctx, hTaskbar);
+  else ok = mvTaskbarButtonsGr(ctx, hTaskbar);
+  if(ctx.plan.chosen >= 0) ctx.plan.actualUs = (double) usSince(ctx.plan.t0);
+  phaseDone("execute");
+  if(ok && ctx.VERIFY){ inv->wd.phase("verify"); ok = verifyChanges(ctx, hTaskbar); phaseDone("verify"); }
+  if(ok && !inv->changeLog.session().ops.empty()){
+    inv->wd.phase("snapshot"); ctx.clear(); getButtonGroups(ctx, hTaskbar);
+    snapshot after = snapTake(ctx, ctx.tbId); snapRehash(after); snapPublish(after);
+    if(ctx.IN_BATCH) ctx.changed = batchChanged(after, inv->changeLog.session());
+    if(ctx.shared) (*ctx.shared)[ctx.tbId] = ctx;
+    outChanges(snapDiff(before, after), false); phaseDone("snapshot");
+  }
+  if(!ok && ctx.shared) ctx.shared->erase(ctx.tbId);  // left midway, or rolled back : enumerated again
+  return ok;
+}
 
-  setlocale(LC_ALL, "en-US.65001");
-  set_new_handler(allocFail);
- 
-  int nbArgs;
-  LPWSTR *arglist = CommandLineToArgvW(GetCommandLineW(), &nbArgs);
-  if(arglist == nullptr) printErr(nullptr, sysErr, 21);
+// The operation's json record (outMode::json), flushed with the operation's output
+void outRecord(opContext &ctx, int rc, LPCSTR result = nullptr){
+  if(outSink().mode != outMode::json) return;
+  outSet("op", ctx.DUMP ? "dump" : ctx.DIFF ? "diff" : ctx.LIST ? "list" : ctx.COMPLETE ? "complete" : ctx.UNDO ? "undo" : ctx.SORT ? "sort"
+    : ctx.SPLIT ? "split" : ctx.MERGE ? "merge" : ctx.chgGroup ? "change-group" : ctx.FIND ? "find" : ctx.BTN_LABEL ? "move-label" : !ctx.moveOps.empty() ? "multi-move" : ctx.SWAP ? "swap" : "move");
+  LPCWSTR grp = ctx.chgGroup ? ctx.grpFrom : ctx.MERGE ? nullptr : ctx.group;
+  if(grp) outSet("group", *wide2uf8(grp));
+  if(ctx.MERGE && ctx.grpFrom) outSet("groups", *wide2uf8(ctx.grpFrom));
+  if((ctx.chgGroup || ctx.MERGE) && ctx.grpTo) outSet("target_group", *wide2uf8(ctx.grpTo));
+  if(ctx.SPLIT && ctx.button) outSet("by", *wide2uf8(ctx.button));
+  if(ctx.BTN_LABEL && ctx.button) outSet("button", *wide2uf8(ctx.button));
+  if(ctx.BY_HWND) outSet("hwnd", (long long) ctx.selHwnd);
+  if(ctx.UNDO) outSet("count", (long long) ctx.undoCount);
+  else if(ctx.DUMP) outSet("format", ctx.dumpArg.c_str());
+  else if(ctx.LIST || ctx.COMPLETE || ctx.DIFF){ if(ctx.listArg) outSet(ctx.LIST ? "filter" : "prefix", *wide2uf8(ctx.listArg)); }
+  else if(!ctx.moveOps.empty()){
+    string json = "[";
+    for(auto &op : ctx.moveOps){
+      json += json.size() > 1 ? ",{\"from\":" : "{\"from\":";
+      if(op.from.empty()) json += to_string(op.from1); else{ string l = "["; for(auto btn : op.from) l += (l.size() > 1 ? "," : "") + to_string(btn); json += l + "]"; }
+      json += ",\"to\":" + to_string(op.to) + "}";
+    }
+    outSetRaw("pairs", json + "]"); outSetRaw("swap", ctx.SWAP ? "true" : "false");
+  }
+  else if(!ctx.SPLIT && !ctx.MERGE){
+    if(!ctx.SORT && !ctx.BTN_LABEL){ if(ctx.iBtn1s.size()) outSetList("from", ctx.iBtn1s); else outSet("from", (long long) ctx.iBtn1); }
+    if(!ctx.SORT && !ctx.FIND) outSet("to", (long long) ctx.iBtn2);
+  }
+  outSet("taskbar", (long long) ctx.tbId);
+  outSet("result", result ? result : rc==0 ? "ok" : rc==rcTimeout ? "timeout" : "error"); outSet("rc", rc);
+  outSetRaw("ms", "{" + inv->phaseMs + "}");
+  if(inv->startup.firstCall){ char buf[32]; snprintf(buf, sizeof(buf), "%.3f", inv->startup.firstCall/1e3); outSetRaw("first_call_ms", buf); }
+  inv->startup.firstCall = 0;  // this invocation's own operation only
+}
+
+// --stats : allocations since allocAt, live heap bytes and their peak
+void statsReport(opContext &ctx){
+  if(!ctx.STATS) return;
+  auto d = allocStats::now() - inv->allocAt; char buf[160];
+  if(allocStats::on) flushOut("  Allocations: %llu (%llu bytes), %llu freed. Live: %llu bytes, peak %llu bytes.\n", d.count, d.bytes, d.frees, d.live, d.peak);
+  if(inv->startup.firstCall) flushOut("  Startup: first backend call %.1f ms after %s (exec %.1f, init %.1f, parse %.1f ms).\n", inv->startup.firstCall/1e3,
+    inv->startup.exec ? "process creation" : "static initialization", inv->startup.exec/1e3, inv->startup.init/1e3, inv->startup.parse/1e3);
+  size_t nProcs = inv->procs.hits + inv->procs.queries;
+  if(nProcs) flushOut("  Processes: %zu looked up, %zu cached, %zu queried.\n", nProcs, inv->procs.hits, inv->procs.queries);
+  string json = "{\"chosen\":";
+  if(ctx.plan.chosen >= 0){
+    auto &[name, est] = ctx.plan.options[ctx.plan.chosen]; double actual = ctx.plan.actualUs >= 0 ? ctx.plan.actualUs : (double) usSince(ctx.plan.t0);
+    flushOut("  Strategy: %s, estimated %.1f ms, actual %.1f ms", name.c_str(), est/1e3, actual/1e3);
+    json += jsonStr(name) + ",\"estimated_ms\":" + to_string(est/1e3) + ",\"actual_ms\":" + to_string(actual/1e3) + ",\"options\":{";
+    for(size_t i = 0; i < ctx.plan.options.size(); i++){
+      if((int) i != ctx.plan.chosen) flushOut(" (%s : %.1f ms)", ctx.plan.options[i].first.c_str(), ctx.plan.options[i].second/1e3);
+      json += (i ? "," : "") + jsonStr(ctx.plan.options[i].first) + ":" + to_string(ctx.plan.options[i].second/1e3);
+    }
+    flushOut(".\n"); json += "}}";
+  }
+  if(outSink().mode != outMode::json) return;
+  snprintf(buf, sizeof(buf), "{\"count\":%llu,\"bytes\":%llu,\"frees\":%llu,\"live\":%llu,\"peak\":%llu}", d.count, d.bytes, d.frees, d.live, d.peak);
+  if(allocStats::on) outSetRaw("alloc", buf);
+  if(ctx.plan.chosen >= 0) outSetRaw("strategy", json);
+  if(nProcs){ snprintf(buf, sizeof(buf), "{\"cached\":%zu,\"queried\":%zu}", inv->procs.hits, inv->procs.queries); outSetRaw("processes", buf); }
+}
+
+// The operation's kind, for its latency histogram
+LPCSTR opKind(opContext &ctx){
+  return ctx.DUMP ? "dump" : ctx.DIFF ? "diff" : ctx.LIST ? "list" : ctx.COMPLETE ? "complete" : ctx.UNDO ? "undo" : ctx.SORT ? "sort" : ctx.SPLIT ? "split" : ctx.MERGE ? "merge" : ctx.chgGroup ? (ctx.NEW_GROUP ? "new-group" : "cross-group")
+    : ctx.FIND ? "find" : ctx.BTN_LABEL ? "move-label" : ctx.BY_HWND ? "move-window" : !ctx.moveOps.empty() ? "multi-move" : ctx.SWAP ? "swap" : "move";
+}
+inline void latencyOp(opContext &ctx){ inv->latency.ops[opKind(ctx)].record(usSince(inv->tOp)); }
+
+// Adds this run's latencies to the histograms of %LOCALAPPDATA%\mv_tb_btn\metrics.bin (session held).
+// Env. var. MVBTN_METRICS=0 : not kept. The primitives' ones go to the cost model (calib.bin) regardless, the processes
+// looked up to their cache (procs.bin).
+void latencySave(){
+  auto cpath = appDataDir() / L"calib.bin"; if(!inv->calib.save(cpath)) flushErr("\n Error: cannot write \"%s\"\n", cpath.string().c_str());
+  auto ppath = appDataDir() / L"procs.bin"; if(inv->procs.dirty && inv->procsKept && !inv->procs.save(ppath)) flushErr("\n Error: cannot write \"%s\"\n", ppath.string().c_str());
+  wstring val; if(inv->latency.empty() || (getEnvVar(L"MVBTN_METRICS", val) && val == L"0")) return;
+  auto path = appDataDir() / L"metrics.bin"; latMetrics all; all.load(path);
+  all.merge(inv->latency); inv->latency = {};
+  if(!all.save(path)) flushErr("\n Error: cannot write \"%s\"\n", path.string().c_str());
+}
 
-  { LPWSTR val; if(getEnvVar(L"MVBTN_GRACEFUL", val) && 0==lstrcmpW(val, L"1")) GRACEFUL = true; }
+// --metrics [text|json|prom|reset] : the latency histograms kept
+int metricsDump(opContext &ctx){
+  auto path = appDataDir() / L"metrics.bin";
+  if(ctx.metricsArg == "reset"){ error_code ec; filesystem::remove(path, ec); flushOut("\n  Latency histograms cleared.\n\n"); return 0; }
+  latMetrics all; all.load(path);
+  if(ctx.metricsArg == "text"){
+    if(all.empty()) flushOut("\n  No latencies recorded yet.\n\n"); else flushOut("%s", all.format("text").c_str());
+  }
+  else outWrite(all.format(ctx.metricsArg), "");
+  return 0;
+}
 
-  int rc = processArgs(argc,argv, arglist); if(rc==200) return 0; if(rc!=0) return rc;
+HANDLE taskbarById(ULONG id){
+  if(id==0) return TTLib_GetMainTaskbar();
+  int nCount;
+  if(!TTLib_GetSecondaryTaskbarCount(&nCount)) return nullptr;
+  if(id > (UINT) nCount){
+    flushErr("\n  Error: secondary taskbar #%lu : ", id);
+    if(nCount>0) flushErr("only %d secondary taskbar%s found.\n\n", nCount, nCount>1 ? "s" : "");
+    else flushErr("no secondary taskbars found, only a primary taskbar.\n\n");
+    return nullptr;
+  }
+  return TTLib_GetSecondaryTaskbar(id);
+}
 
-  { TTLibLoad();
+// Runs the parsed operation on its taskbar (TTLib loaded). Failing midway, what was done is rolled back.
+BOOL runOperation(opContext &ctx){
+  lock_guard<mutex> lk(inv->tt->run);
+  ctx.clear(); ctx.expect.clear(); ctx.plan = {}; inv->timeoutTold = false;
+  if(ctx.UNDO){ if(ctx.shared) ctx.shared->clear(); return undoLast(ctx); }
+  HANDLE hTaskbar = taskbarById(ctx.tbId); if(!hTaskbar) return FALSE;
+
+  inv->changeLog.begin(ctx.tbId);
+  if(mvButtons(ctx, hTaskbar)) return TRUE;
+
+  undoSession ss = inv->changeLog.session(); if(ss.ops.empty()) return FALSE;
+  if(inv->wd.cancelled()){ flushErr("  %zu change%s kept, see --undo.\n\n", ss.ops.size(), ss.ops.size()==1 ? "" : "s"); return FALSE; }
+  flushErr("  Rolling back %zu change%s", ss.ops.size(), ss.ops.size()==1 ? "" : "s");
+  inv->changeLog.enabled = false; BOOL ok = undoReplay(ctx, hTaskbar, ss); inv->changeLog.enabled = true;
+  if(ok){ inv->changeLog.drop(); flushErr(" .. done\n\n"); }
+  else flushErr("  Rollback incomplete, see --undo.\n\n");
+  return FALSE;
+}
 
-      HANDLE hTaskbar = TTLib_GetMainTaskbar();
-      if(tbId==0) bSuccess = mvButtons(hTaskbar);
-      else{
-        int nCount;
-        if(TTLib_GetSecondaryTaskbarCount(&nCount)){
-          if(tbId > (UINT) nCount){
-            flushOut("\n  Error: secondary taskbar #%lu : ", tbId);
-            if(nCount>0) flushOut("only %d secondary taskbar%s found.\n\n", tbId, nCount, nCount>1 ? "s" : "");
-            else flushOut("no secondary taskbars found, only a primary taskbar.\n\n");
-            return FALSE;
-          }
-          hTaskbar = TTLib_GetSecondaryTaskbar(tbId);
-          bSuccess = mvButtons(hTaskbar);
-        }
+// Operation state <-> bytes : a parsed operation, handed over to the session holder
+string opContext::pack() const {
+  string s;
+  packU32(s, chgGroup | SWAP<<1 | BTN_LABEL<<2 | SORT<<3 | SORT_DESC<<4 | NEW_GROUP<<5 | GRACEFUL<<6 | QUIET<<7 | JSON<<8 | UNDO<<9 | LIST<<10 | COMPLETE<<11 | DIFF<<12 | STATS<<13 | BY_HWND<<14 | DUMP<<15 | VERIFY<<16 | FIND<<17 | SPLIT<<18 | MERGE<<19);
+  packU32(s, tbId); packU32(s, iBtn1); packU32(s, iBtn2); packU32(s, (uint32_t) sortBy); packU32(s, undoCount);
+  packU32(s, (uint32_t) selHwnd); packU32(s, (uint32_t) (selHwnd >> 32));
+  packU32(s, (uint32_t) iBtn1s.size()); for(auto btn : iBtn1s) packU32(s, btn);
+  for(LPCWSTR str : { group, grpFrom, grpTo, button, listArg, timeoutArg }){
+    packU32(s, str ? 1 : 0); packStr(s, str, str ? sizeof(WCHAR)*lstrlenW(str) : 0);
+  }
+  packU32(s, (uint32_t) moveOps.size());
+  for(auto &op : moveOps){ packU32(s, op.from1); packU32(s, op.to); packU32(s, (uint32_t) op.from.size()); for(auto btn : op.from) packU32(s, btn); }
+  return s;
+}
+bool opContext::unpack(const string &s){
+  size_t at = 0; uint32_t flags, u, n, n2;
+  if(!unpackU32(s, at, flags) || !unpackU32(s, at, u)) return false; tbId = u;
+  if(!unpackU32(s, at, u)) return false; iBtn1 = u;
+  if(!unpackU32(s, at, u)) return false; iBtn2 = u;
+  if(!unpackU32(s, at, u) || u > (uint32_t) sortKey::exe) return false; sortBy = (sortKey) u;
+  if(!unpackU32(s, at, u)) return false; undoCount = u;
+  if(!unpackU32(s, at, u) || !unpackU32(s, at, n)) return false; selHwnd = u | (ULONGLONG) n << 32;
+  if(!unpackU32(s, at, n)) return false;
+  iBtn1s.clear(); while(n--){ if(!unpackU32(s, at, u)) return false; iBtn1s.insert(u); }
+  LPWSTR *ptrs[] = { &group, &grpFrom, &grpTo, &button, &listArg, &timeoutArg }; string b;
+  for(int i = 0; i < 6; i++){
+    if(!unpackU32(s, at, u) || !unpackStr(s, at, b)) return false;
+    strs[i].assign((const WCHAR *) b.data(), b.size()/sizeof(WCHAR));
+    *ptrs[i] = u ? strs[i].data() : nullptr;
+  }
+  moveOps.clear();  // absent from traces recorded before -f/-t pairs
+  if(at < s.size()){
+    if(!unpackU32(s, at, n)) return false;
+    while(n--){
+      moveOp op; uint32_t m;
+      if(!unpackU32(s, at, u) || !unpackU32(s, at, m) || !unpackU32(s, at, n2)) return false; op.from1 = u; op.to = m;
+      while(n2--){ if(!unpackU32(s, at, u)) return false; op.from.insert(u); }
+      moveOps.push_back(move(op));
+    }
+  }
+  chgGroup = flags & 1; SWAP = flags>>1 & 1; BTN_LABEL = flags>>2 & 1; SORT = flags>>3 & 1; SORT_DESC = flags>>4 & 1;
+  NEW_GROUP = flags>>5 & 1; GRACEFUL = flags>>6 & 1; QUIET = flags>>7 & 1; JSON = flags>>8 & 1; UNDO = flags>>9 & 1;
+  LIST = flags>>10 & 1; COMPLETE = flags>>11 & 1; DIFF = flags>>12 & 1; STATS = flags>>13 & 1; BY_HWND = flags>>14 & 1;
+  DUMP = flags>>15 & 1; VERIFY = flags>>16 & 1; FIND = flags>>17 & 1; SPLIT = flags>>18 & 1; MERGE = flags>>19 & 1;
+  return true;
+}
+
+#ifdef MVBTN_TTSIM
+// --replay-trace : the traced operation, run again on the taskbars of the trace, each backend call taking the time it
+// took then (ttsimState::script). Reports both runs, and the first call where the replay parts from the recording.
+int replayTrace(opContext &ctx){
+  traceData tr; bool json = ctx.JSON, quiet = ctx.QUIET;
+  if(!traceRead(ctx.replayArg, tr) || !ctx.unpack(tr.op)){ flushErr("\n Error: \"%s\" : not a trace, or a damaged one\n\n", *wide2uf8(ctx.replayArg)); return 36; }
+  ctx.JSON = json; ctx.QUIET = quiet; inv->replay = true;  // not the recorded ones
+  if(ctx.UNDO){ flushErr("\n Error: the trace is of an undo, which depends on the undo log of its machine. Not replayed.\n\n"); return 36; }
+
+  ttsimAt->ready = true; if(ttsimAt->tbs.size() <= ctx.tbId) ttsimAt->tbs.resize((size_t) ctx.tbId+1);
+  for(auto &t : tr.tbs) for(auto &g : t.groups){
+    vector<pair<HWND, wstring>> btns; for(auto &b : g.buttons) btns.emplace_back((HWND) (ULONG_PTR) b.hwnd, b.title);
+    ttsimSeed(t.tb, g.appId, btns);
+  }
+  uint64_t recUs = 0; for(auto &c : tr.calls){ ttsimAt->script[c.fn].push_back((DWORD) c.us); recUs += c.us; }
+
+  inv->tracer.begin(tr.op);
+  BOOL ok = TTLibLoad() && runOperation(ctx); TTLib_unload_reload(unLoadOnly);
+  inv->tracer.end({}, ok ? 0 : 1);
+  const traceData &rp = inv->tracer.data; uint64_t repUs = 0; for(auto &c : rp.calls) repUs += c.us;
+  long long at = traceDiverge(tr, rp);
+
+  flushOut("\n  Recorded: %zu backend calls, %.1f ms in the backend, %llu ms in all, rc %llu\n", tr.calls.size(), recUs/1000., tr.ms, tr.rc);
+  flushOut("  Replayed: %zu backend calls, %.1f ms in the backend, %llu ms in all, rc %llu\n", rp.calls.size(), repUs/1000., rp.ms, rp.rc);
+  map<string, pair<int, int>> per; for(auto &c : tr.calls) per[c.fn].first++; for(auto &c : rp.calls) per[c.fn].second++;
+  for(auto &[fn, n] : per) if(n.first != n.second) flushOut("    %-26s %d -> %d\n", fn.c_str(), n.first, n.second);
+  if(at < 0) flushOut("  Same calls as recorded.\n\n");
+  else flushOut("  Parts from the recording at call #%lld : %s, replayed : %s\n\n", at+1,
+    (size_t) at < tr.calls.size() ? tr.calls[at].fn.c_str() : "(end)", (size_t) at < rp.calls.size() ? rp.calls[at].fn.c_str() : "(end)");
+
+  outSet("trace", *wide2uf8(ctx.replayArg)); outSet("calls", (long long) tr.calls.size()); outSet("replay_calls", (long long) rp.calls.size());
+  char buf[96]; snprintf(buf, sizeof(buf), "{\"recorded\":%.3f,\"replayed\":%.3f}", recUs/1000., repUs/1000.); outSetRaw("backend_ms", buf);
+  outSet("diverge_at", at);
+  outRecord(ctx, ok ? 0 : 1);
+  return ok ? 0 : 1;
+}
+#endif
+
+// --timeout spec -> limits, false if malformed
+bool limitsParse(LPCWSTR spec, deadlines &d){
+  if(!spec){ d = {}; return true; }
+  if(!deadlinesParse(*wide2uf8(spec), d)) return false;
+  for(auto &[name, ms] : d.phases)
+    if(name!="load" && name!="enumerate" && name!="execute" && name!="snapshot" && name!="unload") return false;
+  return true;
+}
+
+int processArgs(opContext &ctx, int argc, char const* const* const& argv, optArgs &arglist);
+
+// --resume : the groups the batch changed, still as it left them ? (TTLib loaded)
+bool batchStateHolds(const batchCheckpoint &ck){
+  lock_guard<mutex> lk(inv->tt->run);
+  map<uint32_t, snapshot> tbs;
+  for(auto &[key, hash] : ck.groups){
+    auto it = tbs.find(key.first);
+    if(it == tbs.end()){
+      opContext probe; probe.tbId = key.first; HANDLE hTaskbar = taskbarById(key.first); if(!hTaskbar) return false;
+      getButtonGroups(probe, hTaskbar); snapshot s = snapTake(probe, key.first); snapRehash(s);
+      it = tbs.emplace(key.first, move(s)).first;
+    }
+    if(batchHashOf(it->second, key.second) != hash){
+      flushErr("\n Error: %s changed since the checkpoint : the batch cannot be resumed (run it again without --resume)\n\n",
+        key.second.empty() ? "the order of groups" : ("group \"" + string(*wide2uf8(key.second.c_str())) + "\"").c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+// --batch : the run of deferred reloads done : TTLib reloaded once, then the buttons each operation regrouped moved to
+// their position, in turn (an undo session per taskbar). The run's groups checkpointed as TTLib now sees them.
+BOOL regroupFlush(regroupRun &run, batchCheckpoint &ck){
+  if(run.moves.empty()){ run.groups.clear(); return TRUE; }
+  lock_guard<mutex> lk(inv->tt->run);
+  opContext ctx; set<uint32_t> tbs; for(auto &m : run.moves) tbs.insert(m.tb);
+  auto moves = move(run.moves); auto groups = move(run.groups); size_t nOps = moves.size();
+  run.moves.clear(); run.groups.clear(); run.reloads++;
+  flushOut("  Reloading TTLib once for %zu regrouping%s, then moving the buttons to their position", nOps, nOps==1 ? "" : "s");
+  inv->wd.phase("execute"); if(!ttReload(ctx)){ flushErr("\n\n Error: operation failed !\n\n"); return FALSE; }
+  for(uint32_t tb : tbs){
+    HANDLE hTaskbar = taskbarById(tb); if(!hTaskbar) return FALSE;
+    ctx.clear(); ctx.tbId = tb; getButtonGroups(ctx, hTaskbar); inv->changeLog.begin(tb);
+    for(auto &m : moves) if(m.tb == tb){
+      int g = (int) (find(ctx.appIds.begin(), ctx.appIds.end(), m.appId) - ctx.appIds.begin()); if(g == (int) ctx.appIds.size()) continue;
+      int to = (int) m.to - 1;
+      for(HWND h : m.hwnds){
+        btnPos at = ctx.locator.find(h); if(at.grp != g) continue;  // closed meanwhile
+        to = min(to, (int) ctx.btnWNHs[g].size() - 1);
+        if(at.pos != to && !ttMove(ctx, g, at.pos, to)){ flushErr("\n\n Error: operation failed\n\n"); return FALSE; }
+        to++;
       }
+    }
+    ctx.clear(); getButtonGroups(ctx, hTaskbar);
+    snapshot after = snapTake(ctx, tb); snapRehash(after); snapPublish(after);
+    for(auto &[gtb, appId] : groups) if(gtb == tb) ck.groups[{ tb, appId }] = batchHashOf(after, appId);
+    ck.groups[{ tb, L"" }] = batchHashOf(after, L"");
+  }
+  flushOut(" .. done\n\n"); phaseDone("execute");
+  return TRUE;
+}
+
+// --batch <file> : its operations in turn, in this session (TTLib loaded). A checkpoint after each one done : with
+// --resume, those done by a run interrupted are not run again. Cross-group moves share their reloads (regroupRun) : the
+// operations of a run are checkpointed together, once it is done.
+int batchRun(opContext &ctx, opContext *&running){
+  string text; auto path = appDataDir() / L"batch.ckpt";
+  if(!undoReadAll(ctx.batchArg, text)){ flushErr("\n Error: cannot read the batch \"%s\"\n\n", *wide2uf8(ctx.batchArg)); return 42; }
+  auto lines = batchParse(text);
+  batchCheckpoint ck;
+  if(ctx.RESUME && ck.load(path)){
+    if(ck.ops != batchHashOps(lines, ck.done) || ck.done > lines.size()){
+      flushErr("\n Error: the checkpoint is of another batch (or of this one, its operations done since changed) : run it without --resume\n\n");
+      return 42;
+    }
+    if(ck.session != sessId()){ flushErr("\n Error: the checkpoint is of another logon session : run the batch without --resume\n\n"); return 42; }
+    if(ck.done == lines.size()){ flushOut("\n  Batch already done (%zu operation%s).\n\n", lines.size(), lines.size()==1 ? "" : "s"); return 0; }
+    inv->wd.phase("enumerate"); bool holds = batchStateHolds(ck); phaseDone("resume");
+    if(!holds) return 42;
+    flushOut("\n  Resuming at operation %llu of %zu (line %d) : %zu group%s found as left.\n", ck.done+1, lines.size(), lines[ck.done].line,
+      ck.groups.size(), ck.groups.size()==1 ? "" : "s");
+  }
+  else{
+    if(ctx.RESUME) flushOut("\n  No checkpoint : the batch is run from the start.\n");
+    ck = {}; ck.session = sessId();
+  }
 
-    TTLib_unload_reload(unLoadOnly);
+  int rc = 0; size_t k = ck.done; deadlines own = inv->limits;
+  regroupRun run; size_t reloads0 = inv->ttReloads;
+  auto runDone = [&]{  // the operations before k done
+    bool was = !run.moves.empty(); if(!regroupFlush(run, ck)) return false;
+    if(was){ ck.done = k; ck.ops = batchHashOps(lines, k); if(!ck.save(path)) flushErr("\n Error: cannot write \"%s\"\n", path.string().c_str()); }
+    return true;
+  };
+  for(; k < lines.size() && !rc; k++){
+    inv->phaseMs.clear(); inv->tOp = inv->tPhase = chrono::steady_clock::now(); inv->allocAt = allocStats::now(); allocStats::resetPeak();
+    opContext op; running = &op;
+    op.IN_BATCH = true; op.regroups = &run; op.GRACEFUL = ctx.GRACEFUL; op.QUIET = ctx.QUIET; op.JSON = ctx.JSON; op.STATS = ctx.STATS; op.VERIFY = ctx.VERIFY;
+    vector<char const*> av{ "mv_tb_btn" }; for(auto &a : lines[k].args) av.push_back(a.c_str());
+    optArgs args; rc = args.load((int) av.size(), av.data(), nullptr);
+    if(!rc){ rc = processArgs(op, args.argc(), args.argv.data(), args); optFree(); inv->limits = own; }
+    if(rc==200) rc = 0;  // -h
+    else if(rc) flushErr("  (batch \"%s\", line %d)\n\n", *wide2uf8(ctx.batchArg), lines[k].line);
+    else if(!op.chgGroup && !runDone()) rc = 1;  // the run's buttons in place first
+    else{
+      rc = runOperation(op) ? 0 : inv->wd.cancelled() ? rcTimeout : 1;
+      if(run.conflict){ run.conflict = false; running = &ctx; if(runDone()){ rc = 0; k--; continue; }; rc = 1; }  // run again once the run done
+      else{ statsReport(op); latencyOp(op); }
+    }
+    outRecord(op, rc); outFlush(); running = &ctx;
+    if(rc){ if(rc!=rcTimeout) runDone(); break; }  // those before it kept whole
+    for(auto &[appId, h] : op.changed) ck.groups[{ op.tbId, appId }] = h;
+    if(!run.moves.empty()) continue;  // checkpointed with its run
+    run.groups.clear(); ck.done = k + 1; ck.ops = batchHashOps(lines, ck.done);
+    if(!ck.save(path)) flushErr("\n Error: cannot write \"%s\"\n", path.string().c_str());
   }
-  LocalFree(arglist);
-  return bSuccess ? 0 : 1;
+  if(!rc && !runDone()) rc = 1;
+  if(size_t done = inv->ttReloads - reloads0; run.deferred)
+    flushOut("\n  TTLib reloads : %zu, instead of %zu with the operations run one by one.\n", done, done - run.reloads + run.deferred);
+  if(rc) flushErr("  Batch stopped at operation %zu of %zu (line %d), %zu done : --resume goes on from there.\n\n",
+    k+1, lines.size(), lines[k].line, (size_t) ck.done);
+  else flushOut("\n  Batch done : %zu operation%s.\n\n", lines.size(), lines.size()==1 ? "" : "s");
+  return rc;
+}
+
+// Coalescing window : env. var. MVBTN_COALESCE_MS (0 : no coalescing, invocations only wait for the session)
+DWORD coalesceMs(){
+  wstring val; if(!getEnvVar(L"MVBTN_COALESCE_MS", val)) return 20;
+  return (DWORD) wcstoul(val.c_str(), nullptr, 10);
+}
+
+void allocFail() {
+  set_new_handler(nullptr);  // the sink may not get its few bytes either : then the message goes straight to stderr
+  try{ flushErr("\n Error: memory allocation failure, aborting.\n"); outFlush(); }
+  catch(const bad_alloc &){ fputs("\n Error: memory allocation failure, aborting.\n", stderr); }
+  TTLib_unload_reload(unLoadOnly);
+  exit(55);
 }
 
-int checkNbr(short op, long long &i, char const* const* const& argv, LPWSTR const* const& arglist,short okZero);
-int checkNbrc(short op, char const *const &nbr, long long &i, short okZero);
-int processRanges(short op, char const *const *const &argv, set<ULONG> &set, short okZero, bool noRanges);
+// The invocation the calling thread is bound to (inv), on this command line (Windows : wargv, in UTF-16). Its output is
+// flushed as it goes, the rest on return (mvInvoke()).
+int mvRun(int argc, char const* const* argv, wchar_t **wargv){
+  BOOL bSuccess = FALSE;
+  opContext ctx, *running = &ctx;  // this invocation's operation, the one running (handed over ones, in turn)
+
+  { wstring val; if(getEnvVar(L"MVBTN_GRACEFUL", val) && val == L"1") ctx.GRACEFUL = true; }
+
+  optArgs args;  // @file arguments point into the mapped file : kept to the end
+  int rc = args.load(argc, argv, wargv); if(rc) return rc;
+  inv->startup.init = phaseDone("init");
+  rc = processArgs(ctx, args.argc(), args.argv.data(), args); optFree(); inv->startup.parse = phaseDone("parse");
+  if(rc==200){ outRecord(ctx, 0, "noop"); return 0; }
+  if(rc!=0){ outRecord(ctx, rc); return rc; }
+  if(ctx.RESIDENT) return residentLoop(ctx);
+  if(ctx.METRICS) return metricsDump(ctx);
+#ifdef MVBTN_TTSIM
+  if(ctx.REPLAY) return replayTrace(ctx);
+#endif
+
+  // Time limits : the watchdog unloads TTLib (if the run is stuck in it), and ends the run with rc 124 (from its threads)
+  invocation *self = inv;
+  inv->wd.onHang = [self]{ invBind in(*self); TTLib_unload_reload(unLoadOnly); };
+  inv->wd.onExit = [self, &running, &ctx]{ invBind in(*self);
+    flushErr("\n Error: time limit reached (%s), no response.\n\n", inv->wd.expiredIn().c_str()); outRecord(*running, rcTimeout); outFlush();
+    if(ctx.recordArg) inv->tracer.end(ctx.recordArg, rcTimeout); };
+  deadlines own = inv->limits; inv->wd.start(own);
+  if((ctx.LIST || ctx.COMPLETE) && !ctx.recordArg && listFromSnapshot(ctx)){ statsReport(ctx); latencyOp(ctx); outRecord(ctx, 0); return 0; }
+
+  // Another invocation holds the session : hand it our operation, it answers with our output (not a traced run, nor a
+  // dump : streamed to our stdout, nor a batch)
+  string op = ctx.pack(), reply;
+  if(ctx.recordArg) inv->tracer.begin(op);  // traced : run in a session of its own
+  sessLockState lk = sessLock(0);
+  while(lk == sessBusy){
+    int rc2; string out, err;
+    if(!ctx.recordArg && !ctx.DUMP && !ctx.BATCH && sessSubmit(op, reply) && sessAnswered(reply, rc2, out, err)){ outWrite(out, err); return rc2; }
+    lk = sessLock(10);
+  }
+  inv->changeLog.open(appDataDir() / L"undo.log");
 
-int processArgs(int argc, char const* const* const& argv, LPWSTR const* const& arglist){
+  // We hold it : collect operations handed over while TTLib loads (and until the window closes). No lock to take (its
+  // directory gone, say) : we run alone, uncoalesced.
+  sessServer coalesce; coalesce.start(ctx.recordArg || lk == sessNone ? 0 : coalesceMs());
+  tbShared shared; if(!ctx.BATCH) ctx.shared = &shared;  // enumerated once for all the operations of the session
+
+  { inv->wd.phase("load");
+    bSuccess = TTLibLoad(); phaseDone("load");
+    if(ctx.BATCH) rc = bSuccess ? batchRun(ctx, running) : 1;
+    else{
+      bSuccess = bSuccess && runOperation(ctx); rc = bSuccess ? 0 : inv->wd.cancelled() ? rcTimeout : 1;
+      statsReport(ctx); latencyOp(ctx); outRecord(ctx, rc);
+    }
+    outFlush();
+
+    bool stuck = inv->wd.cancelled();  // past a time limit : TTLib is not trusted anymore, the others are not run
+    for(auto &req : coalesce.finish()){
+      inv->phaseMs.clear(); inv->tOp = inv->tPhase = chrono::steady_clock::now(); inv->allocAt = allocStats::now(); allocStats::resetPeak();
+      int rcReq = 1; string out, err; opContext other; running = &other; other.shared = &shared; outMode mode = outSink().mode;
+      if(stuck){ rcReq = rcTimeout; flushErr("\n Error: TTLib session timed out, operation not run\n\n"); }
+      else if(other.unpack(req.op) && limitsParse(other.timeoutArg, inv->limits)){
+        outSink().mode = other.JSON ? outMode::json : other.QUIET ? outMode::quiet : outMode::text;
+        inv->wd.start(inv->limits); rcReq = runOperation(other) ? 0 : inv->wd.cancelled() ? rcTimeout : 1;
+        stuck = inv->wd.cancelled();
+      }
+      else flushErr("\n Error: malformed operation handed over by another invocation\n\n");
+      statsReport(other); latencyOp(other); outRecord(other, rcReq); outRender(out, err);
+      sessAnswer(req, rcReq, out, err); running = &ctx; outSink().mode = mode;
+    }
+    inv->wd.start(own); inv->wd.phase("unload"); TTLib_unload_reload(unLoadOnly); phaseDone("unload");
+  }
+  inv->wd.finish();
+  latencySave();
+  sessUnlock();
+  if(ctx.recordArg && !inv->tracer.end(ctx.recordArg, rc)) flushErr("\n Error: cannot write the trace \"%s\"\n\n", *wide2uf8(ctx.recordArg));
+  return rc;
+}
+inline int mvInvoke(int argc, char const* const* argv, wchar_t **wargv = nullptr){ int rc = mvRun(argc, argv, wargv); outFlush(); return rc; }
+
+// Windows : the command line as parsed by the CRT, in UTF-16 (the only parse of it). Locale : set with the first output.
+// MVBTN_NO_MAIN : included by a program of its own (tests), running invocations (mvInvoke(), each bound to one : invBind).
+#ifndef MVBTN_NO_MAIN
+#ifdef _WIN32
+int wmain(int argc, wchar_t **wargv)
+#else
+int main(int argc, char **argv)
+#endif
+{
+  static invocation self;  // static : still there for the exit handlers (outFlush)
+#ifdef MVBTN_TTSIM
+  self.scope = ttsimScope();
+#endif
+  invBind in(self);
+  startupBegin();
+  set_new_handler(allocFail);
+  atexit(outFlush);
+#ifdef _WIN32
+  return mvInvoke(argc, nullptr, wargv);
+#else
+  return mvInvoke(argc, argv);
+#endif
+}
+#endif
+
+int checkNbr(short op, long long &i, char const* const* const& argv, optArgs &arglist, short okZero);
+// List/range notation : digits, commas and dashes only, a comma or dash at least ("2,5", "3-6")
+inline bool listNotation(const char *arg){ return !arg[strspn(arg, "0123456789,-")] && strpbrk(arg, ",-"); }
+int processRanges(short op, char const *const *const &argv, set<ULONG> &set, string &zeroIn, short okZero, bool noRanges);
+
+int processArgs(opContext &ctx, int argc, char const* const* const& argv, optArgs &arglist){
 
   int nbArgs = argc - 1;
   bool posFrom = false, posTo = false, tbar = false;
+  string zeroIn;  // processRanges() : the item with a 0 in it
 
   // -cg -fg <from group label> -tg <to group label|[NEW:label]|[NEW] or[RAND]> -f <position from|0> -t [position to=end|start|end]
     // -g <group label> -f <start position> -t <target position> -[s|swap]]
     // -g <group label> -b <button exact label> -t <position> 
     // -tb [taskbar ID=0]
   if(argc==2){ string opt(argv[1]); if(opt=="-h" || opt=="-help"){ usage(); return 200; } }  // quick exit
-  if(argc < 4){ cerr << "\n  Error: not enough arguments\n\n";  usage(1); return 1; }
+  if(argc < 2){ flushErr("\n  Error: not enough arguments\n\n");  usage(1); return 1; }
 
-  OPT_GRACEFUL = GRACEFUL;
+  OPT_GRACEFUL = ctx.GRACEFUL;
   optsNeedArgByDefault = true;
 
-  optList(tb, cg, fg, tg, f, t, g, b, s);
-  optAdd(
-    ( cg, ("-cg", "--change-group", "-change-group"), optHasNoArg ),
-    ( fg, ("-fg", "--from-group", "-from-group")                  ),
-    ( tg, ("-tg", "--target-group", "-target-group")              ),
-    ( f,  ("-f", "--from", "-from")                        ),
-    ( t,  ("-t", "--to", "-to")                            ),
-    ( g,  ("-g", "--group", "-group")                      ),
-    ( b,  ("-b", "--button", "-button")                    ),
-    ( s,  ("-s", "--swap", "-swap"), optHasNoArg           ),
-    ( tb, ("-tb", "--taskbar", "-taskbar"), optCanRepeat   ) 
+  enum optId : short { tb, cg, fg, tg, f, t, g, b, s, sort, desc, q, json, undo, list, complete, resident, diff, timeout, stats, record, replay, win, metrics, dump, verify, batch, resume, split, by, merge, into };
+  static constexpr optDef opts[] = {
+    { tb, "-tb --taskbar -taskbar",            optCanRepeat },
+    { cg, "-cg --change-group -change-group",  optHasNoArg },
+    { fg, "-fg --from-group -from-group" },
+    { tg, "-tg --target-group -target-group" },
+    { f, "-f --from -from",                    optCanRepeat },
+    { t, "-t --to -to",                        optCanRepeat },
+    { g, "-g --group -group" },
+    { b, "-b --button -button" },
+    { s, "-s --swap -swap",                    optHasNoArg },
+    { sort, "--sort -sort" },
+    { desc, "--desc -desc",                    optHasNoArg },
+    { q, "-q --quiet -quiet",                  optHasNoArg },
+    { json, "--json -json",                    optHasNoArg },
+    { undo, "--undo -undo",                    optArgOptional },
+    { list, "--list -list",                    optArgOptional },
+    { complete, "--complete -complete",        optArgOptional },
+    { resident, "--resident -resident",        optArgOptional },
+    { diff, "--diff -diff",                    optHasNoArg },
+    { timeout, "--timeout -timeout" },
+    { stats, "--stats -stats",                 optHasNoArg },
+    { record, "--record-trace -record-trace" },
+    { replay, "--replay-trace -replay-trace" },
+    { win, "-w --window -window" },
+    { metrics, "--metrics -metrics",           optArgOptional },
+    { dump, "--dump -dump",                    optArgOptional },
+    { verify, "--verify -verify",              optHasNoArg },
+    { batch, "--batch -batch" },
+    { resume, "--resume -resume",              optHasNoArg },
+    { split, "--split -split" },
+    { by, "--by -by" },
+    { merge, "--merge -merge" },
+    { into, "--into -into" }
+  };
+  static constexpr auto rules = optRules(
+    optsMustHaveOneOf( b, f, win, sort, undo, list, complete, resident, diff, replay, metrics, dump, batch, split, merge ),
+    optsRelation( optExcludeEachOther, {{ cg, g }, { cg, b }, { cg, s }, { b, s },
+      { b, f, L"Error: either designate button to move by label (-b) or by position (-f), not both" }} ),
+    optsRelation( optRequireEachOther, {{ cg, fg }, { cg, tg }} ),
+    optsRelation( optExcludeEachOther, {{ undo, cg }, { undo, g }, { undo, f }, { undo, b }, { undo, s }, { undo, t },
+      { undo, sort }} ),
+    optsRelation( optExcludeEachOther, {{ list, cg }, { list, g }, { list, f }, { list, b }, { list, s }, { list, t },
+      { list, sort }, { list, undo }, { complete, cg }, { complete, f }, { complete, b }, { complete, s }, { complete, t },
+      { complete, sort }, { complete, undo }, { complete, list }} ),
+    optsRelation( optExcludeEachOther, {{ resident, cg }, { resident, g }, { resident, f }, { resident, b }, { resident, s },
+      { resident, t }, { resident, sort }, { resident, undo }, { resident, list }, { resident, complete }, { resident, tb },
+      { resident, diff }, { resident, timeout }, { resident, record }} ),
+    optsRelation( optExcludeEachOther, {{ diff, cg }, { diff, g }, { diff, f }, { diff, b }, { diff, s }, { diff, t },
+      { diff, sort }, { diff, undo }, { diff, list }, { diff, complete }} ),
+    optsRelation( optExcludeEachOther, {{ replay, cg }, { replay, g }, { replay, f }, { replay, b }, { replay, s }, { replay, t },
+      { replay, sort }, { replay, undo }, { replay, list }, { replay, complete }, { replay, resident }, { replay, diff },
+      { replay, tb }, { replay, record }} ),
+    optsRelation( optExcludeEachOther, {{ win, b }, { win, f }, { win, cg }, { win, s }, { win, sort }, { win, undo },
+      { win, list }, { win, complete }, { win, resident }, { win, diff }, { win, replay }} ),
+    optsRelation( optExcludeEachOther, {{ metrics, cg }, { metrics, g }, { metrics, f }, { metrics, b }, { metrics, s },
+      { metrics, t }, { metrics, sort }, { metrics, undo }, { metrics, list }, { metrics, complete }, { metrics, resident },
+      { metrics, diff }, { metrics, replay }, { metrics, win }, { metrics, record }, { metrics, tb }} ),
+    optsRelation( optExcludeEachOther, {{ dump, cg }, { dump, g }, { dump, f }, { dump, b }, { dump, s }, { dump, t },
+      { dump, sort }, { dump, undo }, { dump, list }, { dump, complete }, { dump, resident }, { dump, diff }, { dump, replay },
+      { dump, win }, { dump, metrics }} ),
+    optsRelation( optExcludeEachOther, {{ verify, undo }, { verify, list }, { verify, complete }, { verify, resident },
+      { verify, diff }, { verify, replay }, { verify, metrics }, { verify, dump }} ),
+    optsRelation( optExcludeEachOther, {{ q, json }, { sort, cg }, { sort, f }, { sort, b }, { sort, s }, { sort, t }} ),
+    optsRelation( optExcludeEachOther, {{ batch, cg }, { batch, g }, { batch, f }, { batch, b }, { batch, s }, { batch, t },
+      { batch, sort }, { batch, undo }, { batch, list }, { batch, complete }, { batch, resident }, { batch, diff }, { batch, replay },
+      { batch, win }, { batch, metrics }, { batch, dump }, { batch, record }, { batch, tb }} ),
+    optsRelation( optExcludeEachOther, {{ split, cg }, { split, g }, { split, f }, { split, b }, { split, s }, { split, t },
+      { split, sort }, { split, undo }, { split, list }, { split, complete }, { split, resident }, { split, diff }, { split, replay },
+      { split, win }, { split, metrics }, { split, dump }, { split, verify }, { split, batch }, { split, merge },
+      { merge, cg }, { merge, g }, { merge, f }, { merge, b }, { merge, s }, { merge, t }, { merge, sort }, { merge, undo },
+      { merge, list }, { merge, complete }, { merge, resident }, { merge, diff }, { merge, replay }, { merge, win }, { merge, metrics },
+      { merge, dump }, { merge, verify }, { merge, batch }} ),
+    optsRelation( optRequireEachOther, {{ split, by }, { merge, into }} ),
+    optsRelation( optRequires,         {{ cg, f }, { sort, g }, { desc, sort }, { resume, batch }} )
   );
-  
-  optsMustHaveOneOf(b,f); 
+  static_assert(optsDefined(opts), "options : each defined once, in the order of optId, each form spelled once");
+  static_assert(optsConsistent(opts, rules), "options : contradictory relations");
 
-  optsRelation( optExcludeEachOther, (cg, g), (cg, b), (cg, s), (b, s),
-    (b, f, L"Error: either designate button to move by label (-b) or by position (-f), not both"));
-  optsRelation( optRequireEachOther, (cg,fg), (cg,tg) );
-  optsRelation( optRequires,         (cg,f),  (b,g) );
+  // Output mode known before the options are checked : their errors then go in the json record
+  for(int i = 1; i < argc; i++) if(!strcmp(argv[i], "--json") || !strcmp(argv[i], "-json")) outSink().mode = outMode::json;
+
+  // by / into : options as words only right after --split <group> / --merge <groups> ("-b into" : a title)
+  vector<char const*> av(argv, argv + argc);
+  for(int i = 1; i + 2 < argc; i++){
+    if((!strcmp(av[i], "--split") || !strcmp(av[i], "-split")) && !strcmp(av[i+2], "by")) av[i+2] = "--by";
+    if((!strcmp(av[i], "--merge") || !strcmp(av[i], "-merge")) && !strcmp(av[i+2], "into")) av[i+2] = "--into";
+  }
 
-  optSetIndicator( (cg, chgGroup), (f, posFrom), (t, posTo), (b, BTN_LABEL), (tb, tbar), (s, SWAP) );
-  
   int rc;
   #define chkCallRet(X) rc = X;  if(rc!=0) return rc;
-  chkCallRet( optLoad(argc, argv) );
-  chkCallRet( optNoExtraArgs(argv) );
+  rc = optLoad(argc, av.data(), opts, rules, {{ cg, &ctx.chgGroup }, { f, &posFrom }, { t, &posTo }, { b, &ctx.BTN_LABEL }, { tb, &tbar }, { s, &ctx.SWAP }, { sort, &ctx.SORT },
+    { desc, &ctx.SORT_DESC }, { q, &ctx.QUIET }, { json, &ctx.JSON }, { undo, &ctx.UNDO }, { list, &ctx.LIST }, { complete, &ctx.COMPLETE }, { resident, &ctx.RESIDENT }, { diff, &ctx.DIFF }, { stats, &ctx.STATS }, { replay, &ctx.REPLAY }, { win, &ctx.BY_HWND }, { metrics, &ctx.METRICS }, { dump, &ctx.DUMP }, { verify, &ctx.VERIFY }, { batch, &ctx.BATCH }, { resume, &ctx.RESUME },
+    { split, &ctx.SPLIT }, { merge, &ctx.MERGE }});
+  outSink().mode = ctx.JSON ? outMode::json : ctx.QUIET ? outMode::quiet : outMode::text;
+  if(rc!=0) return rc;
+  if(ctx.IN_BATCH) for(short id : { batch, resume, resident, replay, metrics, record, undo, timeout })
+    if(optAt[id]){ flushErr("\n Error: \"%s\" : not within a batch\n\n", optByUser[id]); return 42; }
+  chkCallRet( optNoExtraArgs(av.data()) );
 
   long long i; //optId userOpt;
   #define checkGetNbr(opt,i,bZero) chkCallRet( checkNbr(opt, i, argv,arglist, bZero) )
   #define checkGetPureNbr(opt,var,bZero) { checkGetNbr(opt,i,bZero); var = (ULONG) i; }
   #define checkGetArgAsNbr(opt,var,bZero) { if(optArgi[opt]) {                     \
-         if(StrStrIW(arglist[optArgi[opt]], L"start"))             var = 1;        \
-    else if(StrStrIW(arglist[optArgi[opt]], L"end"))               var = 9999;     \
-    else if(bZero && (0==StrCmpIW(arglist[optArgi[opt]], L"0")                     \
-                   || 0==StrCmpIW(arglist[optArgi[opt]], L"All"))) var = 0;        \
+         if(wstrStrI<WCHAR>(arglist[optArgi[opt]], L"start"))      var = 1;        \
+    else if(wstrStrI<WCHAR>(arglist[optArgi[opt]], L"end"))        var = 9999;     \
+    else if(bZero && (wstrEqI<WCHAR>(arglist[optArgi[opt]], L"0")                  \
+                   || wstrEqI<WCHAR>(arglist[optArgi[opt]], L"All"))) var = 0;     \
     else checkGetPureNbr(opt,var,bZero); }}
 
-  if(tbar) checkGetArgAsNbr(tb, tbId, zeroOK);
+  if(tbar) checkGetArgAsNbr(tb, ctx.tbId, zeroOK);
+
+  if(optArgi[timeout]) ctx.timeoutArg = arglist[optArgi[timeout]];
+  else if(getEnvVar(L"MVBTN_TIMEOUT", ctx.envTimeout) && !ctx.envTimeout.empty()) ctx.timeoutArg = ctx.envTimeout.data();
+  if(!limitsParse(ctx.timeoutArg, inv->limits)){
+    flushErr("\n Error: in %s \"%s\" : expecting <ms>, or <phase>=<ms>,.. (phases : load, enumerate, execute, snapshot, unload, total)\n\n",
+      optArgi[timeout] ? optByUser[timeout] : "MVBTN_TIMEOUT", *wide2uf8(ctx.timeoutArg));
+    return 35;
+  }
+
+  if(optArgi[record]) ctx.recordArg = arglist[optArgi[record]];
+  if(ctx.METRICS){
+    if(optArgi[metrics]) ctx.metricsArg = argv[optArgi[metrics]]; else if(ctx.JSON) ctx.metricsArg = "json";
+    for(auto &c : ctx.metricsArg) c = (char) tolower((unsigned char) c);
+    if(ctx.metricsArg != "text" && ctx.metricsArg != "json" && ctx.metricsArg != "prom" && ctx.metricsArg != "reset"){
+      flushErr("\n Error: in argument to \"%s\": \"%s\" : expecting text, json, prom or reset\n\n", optByUser[metrics], argv[optArgi[metrics]]);
+      return 38;
+    }
+    return 0;
+  }
+  if(ctx.REPLAY){
+#ifndef MVBTN_TTSIM
+    flushErr("\n Error: %s needs a build on the simulated TTLib (MVBTN_TTSIM defined)\n\n", optByUser[replay]); return 36;
+#endif
+    ctx.replayArg = arglist[optArgi[replay]];
+    flushOut("\n Action: replay the trace \"%s\" on simulated taskbars\n", *wide2uf8(ctx.replayArg));
+    return 0;
+  }
+  if(ctx.BATCH && !ctx.IN_BATCH){
+    ctx.batchArg = arglist[optArgi[batch]];
+    flushOut("\n Action: the operations of the batch \"%s\"%s\n", *wide2uf8(ctx.batchArg), ctx.RESUME ? ", from its checkpoint" : "");
+    return 0;
+  }
+
+  if(ctx.UNDO){
+    if(optArgi[undo]) checkGetPureNbr(undo, ctx.undoCount, noZero) else ctx.undoCount = 1;
+    flushOut("\n Action: undo the last %lu operation%s\n", ctx.undoCount, ctx.undoCount==1 ? "" : "s");
+    return 0;
+  }
+  if(ctx.RESIDENT){ if(optArgi[resident]) checkGetPureNbr(resident, ctx.residentMs, noZero) else ctx.residentMs = 2000; return 0; }
+  if(ctx.DIFF){ flushOut("\n Action: changes since the last taskbar snapshot"); flushOut(ctx.tbId ? " (secondary taskbar #%lu)\n" : " (primary taskbar)\n", ctx.tbId); return 0; }
+  if(ctx.DUMP){
+    if(optArgi[dump]) ctx.dumpArg = argv[optArgi[dump]]; else if(ctx.JSON) ctx.dumpArg = "jsonl";
+    for(auto &c : ctx.dumpArg) c = (char) tolower((unsigned char) c);
+    if(ctx.dumpArg != "tsv" && ctx.dumpArg != "jsonl"){
+      flushErr("\n Error: in argument to \"%s\": \"%s\" : expecting tsv or jsonl\n\n", optByUser[dump], argv[optArgi[dump]]);
+      return 40;
+    }
+    return 0;
+  }
+  if(ctx.LIST || ctx.COMPLETE){
+    if(optArgi[ctx.LIST ? list : complete]) ctx.listArg = arglist[optArgi[ctx.LIST ? list : complete]];
+    if(ctx.COMPLETE && optArgi[g]) ctx.group = arglist[optArgi[g]];
+    return 0;
+  }
+  if(ctx.SPLIT){
+    ctx.group = arglist[optArgi[split]]; ctx.button = arglist[optArgi[by]];
+    flushOut("\n Action: split group \"%s\" by %s", *wide2uf8(ctx.group), wstrEqI<WCHAR>(ctx.button, L"exe") ? "executable" : *wide2uf8(ctx.button));
+    if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
+    return 0;
+  }
+  if(ctx.MERGE){
+    ctx.grpFrom = arglist[optArgi[merge]]; ctx.grpTo = arglist[optArgi[into]];
+    flushOut("\n Action: merge groups %s into \"%s\"", *wide2uf8(ctx.grpFrom), *wide2uf8(ctx.grpTo));
+    if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
+    return 0;
+  }
+  if(argc < 4 && !(ctx.BTN_LABEL && !optArgi[g])){ flushErr("\n  Error: not enough arguments\n\n");  usage(1); return 1; }
+  size_t nPairs = max(optArgsOf(f).size(), optArgsOf(t).size());
+  if(nPairs > 1){
+    LPCSTR why = ctx.chgGroup ? "not with -cg" : ctx.BY_HWND ? "not with -w" : optArgsOf(f).size() != optArgsOf(t).size() ? "as many -f as -t" : nullptr;
+    for(short a : optArgsOf(f)) if(!why && !a) why = "an argument to each -f";
+    for(short a : optArgsOf(t)) if(!why && !a) why = "an argument to each -t";
+    if(why){ flushErr("\n Error: several -f/-t pairs : %s.\n Try option -h\n\n", why); return 41; }
+  }
 
-  if(chgGroup){
-    if(nbArgs <= 3){ cerr << "\n  Error: not enough arguments for "<<optByUser[cg]<<" mode.\n\n"; usage(1); return OPT_ERR_USAGE; }
+  if(ctx.chgGroup){
+    if(nbArgs <= 3){ flushErr("\n  Error: not enough arguments for %s mode.\n\n", optByUser[cg]); usage(1); return OPT_ERR_USAGE; }
     // -cg     -fg <from group label>    -tg <to group label|[NEW] or [RAND]>     -f <position from|[0, All]|start|end>       [-t <position to=end|start|end>]
-    grpFrom = arglist[optArgi[fg]]; grpTo = arglist[optArgi[tg]]; LPCSTR ng = *wide2uf8(*catWstr({ L"group \"", grpTo, L"\""}));
-    if(StrStrIW(grpTo, grpFrom)){ cerr <<"\n Error: source and target group are the same. Please use -g to move buttons within a group.\n\n"; return 100; }
-    if(0==lstrcmpiW(grpTo, L"[NEW]") || 0==lstrcmpiW(grpTo, L"[RAND]")){
-      grpTo = *uf8toWide(*catStr({ "random_", random_string(2,true).c_str() })); NEW_GROUP = true;  ng = "a new group"; }
+    ctx.grpFrom = arglist[optArgi[fg]]; ctx.grpTo = arglist[optArgi[tg]]; string ng = *wide2uf8(*catWstr({ L"group \"", ctx.grpTo, L"\""}));
+    if(wstrStrI<WCHAR>(ctx.grpTo, ctx.grpFrom)){ flushErr("\n Error: source and target group are the same. Please use -g to move buttons within a group.\n\n"); return 100; }
+    if(wstrEqI<WCHAR>(ctx.grpTo, L"[NEW]") || wstrEqI<WCHAR>(ctx.grpTo, L"[RAND]")){
+      ctx.grpTo = (ctx.grpNames[2] = *uf8toWide(*catStr({ "random_", random_string(2,true).c_str() }))).data(); ctx.NEW_GROUP = true;  ng = "a new group"; }
     
-    rc = processRanges(f, argv, iBtn1s, noZero, withRanges);
+    rc = processRanges(f, argv, ctx.iBtn1s, zeroIn, noZero, withRanges);
     switch(rc){
       case 0:         // all good      
       case 1: break;  // list with 0
       // no list :
-      case 2: checkGetArgAsNbr(f, iBtn1, zeroOK); break;
+      case 2: checkGetArgAsNbr(f, ctx.iBtn1, zeroOK); break;
       // Unauthorized zero :
       case 3: flushErr("\n  Error: in argument to \"%s\": \"%s\" : 0 means all buttons, cannot be with other button positions\n    "
-        "If you mean \"all buttons\", simply use : \"-f 0\", or \"-f all\"\n\n", optByUser[f], gStr); return 31;
+        "If you mean \"all buttons\", simply use : \"-f 0\", or \"-f all\"\n\n", optByUser[f], zeroIn.c_str()); return 31;
       // malformed list :
       default: return (200+rc);
     }
-    if(iBtn1s.size() == 1){ iBtn1 = *iBtn1s.begin(); iBtn1s.clear(); }
+    if(ctx.iBtn1s.size() == 1){ ctx.iBtn1 = *ctx.iBtn1s.begin(); ctx.iBtn1s.clear(); }
 
-    if(posTo) checkGetArgAsNbr(t, iBtn2, zeroOK) else iBtn2 = 9999;
+    if(posTo) checkGetArgAsNbr(t, ctx.iBtn2, zeroOK) else ctx.iBtn2 = 9999;
 
-    flushOut("\n Action: move "); char *gf = *wide2uf8(grpFrom); //*gt = *wide2uf8(grpTo);
-    char *btnfrom = new char[(size_t) 100+(rc=snprintf(NULL, 0, "%lu", iBtn1))]();
-    iBtn1s.size() > 0 ? snprintf(btnfrom, 100+(size_t)rc, "%d %s", (int)iBtn1s.size(), "buttons") : snprintf(btnfrom, 100+(size_t)rc, "button #%lu", iBtn1);
-    if(iBtn2==9999){
-      if(iBtn1>0 || iBtn1s.size() > 1) flushOut("%s in group \"%s\" to %s%s", btnfrom, gf, NEW_GROUP?"":"end of ", ng);
-      else flushOut("all buttons in group \"%s\" to %s%s", gf, NEW_GROUP?"":"end of ", ng);
+    flushOut("\n Action: move "); auto gf8 = wide2uf8(ctx.grpFrom); char *gf = *gf8;
+    char btnfrom[64];
+    ctx.iBtn1s.size() > 0 ? snprintf(btnfrom, sizeof(btnfrom), "%d %s", (int) ctx.iBtn1s.size(), "buttons") : snprintf(btnfrom, sizeof(btnfrom), "button #%lu", ctx.iBtn1);
+    if(ctx.iBtn2==9999){
+      if(ctx.iBtn1>0 || ctx.iBtn1s.size() > 1) flushOut("%s in group \"%s\" to %s%s", btnfrom, gf, ctx.NEW_GROUP?"":"end of ", ng.c_str());
+      else flushOut("all buttons in group \"%s\" to %s%s", gf, ctx.NEW_GROUP?"":"end of ", ng.c_str());
     } else{
-      if(iBtn1>0 || iBtn1s.size() > 0) flushOut("%s in group \"%s\" to position %lu in %s", btnfrom, gf, iBtn2, ng);
-      else flushOut("all buttons in group \"%s\" to position %lu in %s", gf, iBtn2, ng);
+      if(ctx.iBtn1>0 || ctx.iBtn1s.size() > 0) flushOut("%s in group \"%s\" to position %lu in %s", btnfrom, gf, ctx.iBtn2, ng.c_str());
+      else flushOut("all buttons in group \"%s\" to position %lu in %s", gf, ctx.iBtn2, ng.c_str());
     }
-    if(tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", tbId);
+    if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
     return 0;
   } // chgGroup
-  
-  group = arglist[optArgi[g]]; char *gr = *wide2uf8(group);
+
+  // mv_btn.exe -w <window handle> [-g <group label>] [-t <target position=end|start|end>]
+  if(ctx.BY_HWND){
+    LPCWSTR w = arglist[optArgi[win]]; WCHAR *e = nullptr; ctx.selHwnd = wcstoull(w, &e, 0);
+    if(!*w || *e || !ctx.selHwnd){
+      flushErr("\n Error: in argument to \"%s\": \"%s\" : expecting a window handle (0x1A2B, or decimal)\n\n", optByUser[win], argv[optArgi[win]]);
+      return 37;
+    }
+    if(optArgi[g]) ctx.group = arglist[optArgi[g]];
+    if(posTo) checkGetArgAsNbr(t, ctx.iBtn2, noZero) else ctx.iBtn2 = 9999;
+    flushOut("\n Action: move the button of window 0x%llx to ", ctx.selHwnd);
+    if(ctx.iBtn2==9999) flushOut("last position"); else flushOut("position %lu", ctx.iBtn2);
+    if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
+    return 0;
+  }
+
+  // mv_btn.exe -b <button title|pattern> [-t <target position=end|start|end>] : in every group (no -t : where it is)
+  if(ctx.BTN_LABEL && !optArgi[g]){
+    ctx.button = arglist[optArgi[b]]; auto btn8 = wide2uf8(ctx.button);
+    if(posTo && listNotation(argv[optArgi[t]])){
+      flushErr("\n Error: in argument to \"%s\": \"%s\" : you cannot use list/range notation for target.\n Try option -h\n\n", optByUser[t], argv[optArgi[t]]);
+      return 32;
+    }
+    if(posTo) checkGetArgAsNbr(t, ctx.iBtn2, noZero) else ctx.FIND = true;
+    if(ctx.FIND) flushOut("\n Action: find buttons titled \"%s\" in all groups", *btn8);
+    else if(ctx.iBtn2==9999) flushOut("\n Action: move button \"%s\" (any group) to last position", *btn8);
+    else flushOut("\n Action: move button \"%s\" (any group) to position %lu", *btn8, ctx.iBtn2);
+    if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
+    return 0;
+  }
+
+  ctx.group = arglist[optArgi[g]]; auto gr8 = wide2uf8(ctx.group); char *gr = *gr8;
   // mv_btn.exe -g <group label> -f <start position=end|start|end>     -t <target position=end|start|end>     [-tb <taskbar ID=0>   [-swap]]
   // mv_btn.exe -g <group label> -b <button exact label>               -t <target position=end|start|end>     [-tb <taskbar ID=0>]
-  if(BTN_LABEL) button = arglist[optArgi[b]];
-  else if(SWAP){ 
-    if(regexSubst(argv[optArgi[f]], "[0-9,-]").size()==0 && regexSubst(argv[optArgi[f]], "[^,-]").size()>0){
-      flushErr("\n Error: in argument to \"%s\": \"%s\" : cannot use list/range format with %s.\n Try option -h\n\n", optByUser[f], argv[optArgi[f]], optByUser[s]); 
+  if(ctx.SORT){
+    LPCWSTR key = arglist[optArgi[sort]];
+         if(wstrEqI<WCHAR>(key, L"title"))    ctx.sortBy = sortKey::title;
+    else if(wstrEqI<WCHAR>(key, L"natural"))  ctx.sortBy = sortKey::natural;
+    else if(wstrEqI<WCHAR>(key, L"hwnd"))     ctx.sortBy = sortKey::hwnd;
+    else if(wstrEqI<WCHAR>(key, L"creation")) ctx.sortBy = sortKey::creation;
+    else if(wstrEqI<WCHAR>(key, L"exe"))      ctx.sortBy = sortKey::exe;
+    else{ flushErr("\n Error: in argument to \"%s\": \"%s\" : sort by title, natural, hwnd, creation or exe.\n Try option -h\n\n", optByUser[sort], argv[optArgi[sort]]);
+      return 33; }
+    flushOut("\n Action: sort buttons in group \"%s\" by %s%s", gr, argv[optArgi[sort]], ctx.SORT_DESC ? ", descending" : "");
+    if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
+    return 0;
+  }
+  // -b or -f, and -t : those at optArgi[]
+  auto fromTo = [&]()->int{
+    ctx.iBtn1 = 0; ctx.iBtn1s.clear();
+    if(ctx.BTN_LABEL) ctx.button = arglist[optArgi[b]];
+    else if(ctx.SWAP){ 
+      if(listNotation(argv[optArgi[f]])){
+        flushErr("\n Error: in argument to \"%s\": \"%s\" : cannot use list/range format with %s.\n Try option -h\n\n", optByUser[f], argv[optArgi[f]], optByUser[s]); 
+        return 32;
+      }
+      checkGetArgAsNbr(f, ctx.iBtn1, noZero)
+    } 
+    else{
+      rc = processRanges(f, argv, ctx.iBtn1s, zeroIn, noZero, withRanges);
+      switch(rc){
+        case 0:         // all good
+        case 1: break;  // list with 0
+        // no list :
+        case 2: checkGetArgAsNbr(f, ctx.iBtn1, noZero); break;
+        // Unauthorized zero :
+        case 3: flushErr("\n  Error: in argument to \"%s\": \"%s\" : 0 means all buttons, cannot be with other button positions\n    "
+          "If you mean \"all buttons\", simply use : \"-f 0\", or \"-f all\"\n\n", optByUser[f], zeroIn.c_str()); return 31;
+        // malformed list :
+        default: return (200+rc);
+      }
+    }
+    if(ctx.iBtn1s.size() == 1){ ctx.iBtn1 = *ctx.iBtn1s.begin(); ctx.iBtn1s.clear(); }
+    
+    if(posTo && listNotation(argv[optArgi[t]])){
+      flushErr("\n Error: in argument to \"%s\": \"%s\" : you cannot use list/range notation for target.\n Try option -h\n\n", optByUser[t], argv[optArgi[t]]);
       return 32;
     }
-    checkGetArgAsNbr(f, iBtn1, noZero)
-  } 
-  else{
-    rc = processRanges(f, argv, iBtn1s, noZero, withRanges);
-    switch(rc){
-      case 0:         // all good
-      case 1: break;  // list with 0
-      // no list :
-      case 2: checkGetArgAsNbr(f, iBtn1, noZero); break;
-      // Unauthorized zero :
-      case 3: flushErr("\n  Error: in argument to \"%s\": \"%s\" : 0 means all buttons, cannot be with other button positions\n    "
-        "If you mean \"all buttons\", simply use : \"-f 0\", or \"-f all\"\n\n", optByUser[f], gStr); return 31;
-      // malformed list :
-      default: return (200+rc);
+    if(posTo) checkGetArgAsNbr(t, ctx.iBtn2, noZero) else ctx.iBtn2 = 9999;
+    return 0;
+  };
+
+  // -g <group label> -f <position> -t <position> -f <position> -t <position> .. [-s] : each on the order the previous ones left
+  if(nPairs > 1){
+    for(size_t k = 0; k < nPairs; k++){
+      optArgi[f] = optArgsOf(f)[k]; optArgi[t] = optArgsOf(t)[k];
+      chkCallRet( fromTo() ); ctx.moveOps.push_back({ ctx.iBtn1s, ctx.iBtn1, ctx.iBtn2 });
     }
+    ctx.iBtn1 = ctx.iBtn2 = 0; ctx.iBtn1s.clear();
+    flushOut("\n Action: %zu %s in group \"%s\", as one", nPairs, ctx.SWAP ? "swaps" : "moves", gr);
+    if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
+    return 0;
   }
-  if(iBtn1s.size() == 1){ iBtn1 = *iBtn1s.begin(); iBtn1s.clear(); }
-  
-  if(posTo && regexSubst(argv[optArgi[t]], "[0-9,-]").size()==0 && regexSubst(argv[optArgi[t]], "[^,-]").size()>0){
-    flushErr("\n Error: in argument to \"%s\": \"%s\" : you cannot use list/range notation for target.\n Try option -h\n\n", optByUser[t], argv[optArgi[t]]);
-    return 32;
-  }
-  if(posTo) checkGetArgAsNbr(t, iBtn2, noZero) else iBtn2 = 9999;
+  chkCallRet( fromTo() );
 
-  if(iBtn1==iBtn2){ flushOut("\n Source and target positions are the same. Nothing to.\n\n", iBtn1, gr); return 200; }
+  if(ctx.iBtn1==ctx.iBtn2){ flushOut("\n Source and target positions are the same. Nothing to.\n\n", ctx.iBtn1, gr); return 200; }
   
-  if(BTN_LABEL){           char *btn = *wide2uf8(button);
-    if(iBtn2==9999) flushOut("\n Action: move button \"%s\" in group \"%s\" to last position", btn, gr);
-    else flushOut("\n Action: move button \"%s\" in group \"%s\" to position %lu", btn, gr, iBtn2);
+  if(ctx.BTN_LABEL){           auto btn8 = wide2uf8(ctx.button); char *btn = *btn8;
+    if(ctx.iBtn2==9999) flushOut("\n Action: move button \"%s\" in group \"%s\" to last position", btn, gr);
+    else flushOut("\n Action: move button \"%s\" in group \"%s\" to position %lu", btn, gr, ctx.iBtn2);
   } else {  // no btn label
-    char *btnfrom = new char[(size_t) 100+(rc=snprintf(NULL, 0, "%lu", iBtn1))]();
-    iBtn1s.size() > 0 ? snprintf(btnfrom, 100+(size_t)rc, "%d %s", (int) iBtn1s.size(), "buttons") : snprintf(btnfrom, 100+(size_t)rc, "button #%lu", iBtn1);
-    if(SWAP){ if(iBtn2==9999) flushOut("\n Action: swap %s with last button in group \"%s\" ", btnfrom, gr);
+    char btnfrom[64];
+    ctx.iBtn1s.size() > 0 ? snprintf(btnfrom, sizeof(btnfrom), "%d %s", (int) ctx.iBtn1s.size(), "buttons") : snprintf(btnfrom, sizeof(btnfrom), "button #%lu", ctx.iBtn1);
+    if(ctx.SWAP){ if(ctx.iBtn2==9999) flushOut("\n Action: swap %s with last button in group \"%s\" ", btnfrom, gr);
               else {
-                if(iBtn1==9999) flushOut("\n Action: swap last button with button at position %lu in group \"%s\"", iBtn2, gr);
-                else flushOut("\n Action: swap buttons #%lu and #%lu in group \"%s\"", iBtn1, iBtn2, gr);
+                if(ctx.iBtn1==9999) flushOut("\n Action: swap last button with button at position %lu in group \"%s\"", ctx.iBtn2, gr);
+                else flushOut("\n Action: swap buttons #%lu and #%lu in group \"%s\"", ctx.iBtn1, ctx.iBtn2, gr);
               }
     } else {  // no swap
-      if(iBtn2==9999) flushOut("\n Action: move %s in group \"%s\" to last position", btnfrom, gr);
+      if(ctx.iBtn2==9999) flushOut("\n Action: move %s in group \"%s\" to last position", btnfrom, gr);
       else{
-        if(iBtn1==9999) flushOut("\n Action: move last button in group \"%s\" to position %lu", gr, iBtn2);
-        else flushOut("\n Action: move %s in group \"%s\" to position %lu", btnfrom, gr, iBtn2);
+        if(ctx.iBtn1==9999) flushOut("\n Action: move last button in group \"%s\" to position %lu", gr, ctx.iBtn2);
+        else flushOut("\n Action: move %s in group \"%s\" to position %lu", btnfrom, gr, ctx.iBtn2);
       }
   }}
-  if(tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", tbId);
+  if(ctx.tbId == 0) flushOut(" (primary taskbar)\n"); else flushOut(" (secondary taskbar #%lu)\n", ctx.tbId);
 
   #undef checkGetArgNbr
   #undef checkGetNbr
@@ -856,7 +2473,7 @@ int processArgs(int argc, char const* const* const& argv, LPWSTR const* const& a
   return 0;
 }
 
-inline int checkNbr(short op, long long &i, char const* const* const& argv, LPWSTR const* const& arglist, short okZero = noZero){
+inline int checkNbr(short op, long long &i, char const* const* const& argv, optArgs &arglist, short okZero = noZero){
   short iArg = optArgi[op]; const char *arg = argv[iArg], *opt = optByUser[op];
   string cs(arg); static string numchars = " +-0123456789";
     for(char c : " +-0123456789") cs.erase(remove(cs.begin(), cs.end(), c), cs.end());
@@ -870,79 +2487,55 @@ inline int checkNbr(short op, long long &i, char const* const* const& argv, LPWS
   return 0;
 }
 
-inline int checkNbrc(short op, char const* const& nbr, long long &i, short okZero = noZero){
-  short iArg = optArgi[op];
-  char *end = nullptr; errno = 0; i = strtoll(regexSubst(nbr, " ").c_str(), &end, 10);
-  if(errno == ERANGE){ flushErr("\n Error: arg%d: '%s' : ",iArg,nbr); perror(""); flushErr("\n Try option -h\n\n"); return 25; }
-  if(i < 0){ flushErr("\n Error : arg%d : expecting a positive number, not '%s'\n Try option -h\n\n",iArg,nbr); return 27; }
-  if(end && 0 < strlen(end)){ flushErr("\n Error: arg%d: expecting a positive number, not '%s'\n Try option -h\n\n", iArg, nbr); return 28; }
-  return 0;
-}
-
-inline int processRanges(short op, char const* const* const& argv, set<ULONG>& set, short okZero = zeroOK, bool Ranges = false){
-  
-  const char *arg = argv[optArgi[op]];
-  static bool zeroIntheList = false;
+// List of positions (1,2-4,6), read in one pass, in place : no regex, no copy (it can be megabytes long, from an @file)
+inline int processRanges(short op, char const* const* const& argv, set<ULONG>& set, string &zeroIn, short okZero = zeroOK, bool Ranges = false){
   
-  //#define regexMatch(s,re)   regex_search(s.cbegin(), s.cend(), regex(re, regex::egrep))
-  //#define regexMatchvw(s,re) regex_search(s, regex(re, regex::egrep))
-
-  if(!StrStrIA(arg, ",") && !regexMatch(arg, "^[ ]*[0-9]+[ ]*-[ ]*[0-9]+[ ]*$"))  // not( a,b or 2-14 )
-    return 2;  // not a list
+  string_view arg = argv[optArgi[op]];
+  bool zeroIntheList = false;
+  static const long long nbrMax = numeric_limits<uint32_t>::max(), rangeMax = 1 << 16;
+  short iArg = optArgi[op];
 
-  if(!Ranges && !regexMatch(arg, "^[ ]*([0-9]+[ ]*,[ ]*)+[0-9]+[ ]*$")){  // 1,2,3  not 1,2-4,6
-    flushErr("\n  Error: not a comma-separated list of numbers: %s\n\n", regexSubst(arg, "^[ ]+"));
-    return 10;
+  size_t at = 0, n = arg.size();
+  auto blanks = [&]{ while(at < n && arg[at]==' ') at++; };
+  auto number = [&](long long &v){
+    size_t from = at; v = 0;
+    for(; at < n && arg[at] >= '0' && arg[at] <= '9'; at++) if(v <= nbrMax) v = 10*v + (arg[at] - '0');
+    return at > from;
+  };
+  auto word = [&](size_t from){ string w; for(char c : arg.substr(from, at - from)) if(c != ' ') w += c; return w; };
+  long long i, j;
+
+  if(arg.find(',') == string_view::npos){  // not( a,b or 2-14 )
+    blanks(); bool range = number(i) && (blanks(), at < n && arg[at]=='-') && (at++, blanks(), number(j));
+    if(!range || (blanks(), at < n)) return 2;  // not a list
+    at = 0;
   }
 
-  // 1,2-4,6
-  if(Ranges  && !regexMatch(arg, "^[ ]*([0-9]+[ ]*(-[ ]*[0-9]+)*[ ]*,[ ]*)+[0-9]+[ ]*(-[ ]*[0-9]+){0,1}[ ]*$|^[ ]*[0-9]+[ ]*-[ ]*[0-9]+[ ]*$"))
-  {
-    flushErr("\n  Error: malformed list of numbers/ranges: %s\n\n", regexSubst(arg, "^[ ]+"));
+  auto malformed = [&]{
+    string_view a = arg.substr(min(arg.find_first_not_of(' '), n));
+    flushErr(Ranges ? "\n  Error: malformed list of numbers/ranges: %.*s%s\n\n" : "\n  Error: not a comma-separated list of numbers: %.*s%s\n\n",
+      (int) min<size_t>(a.size(), 80), a.data(), a.size() > 80 ? " .." : "");
     return 10;
-  }
-  
-  #define splitView(c) views::split(c) \
-      | views::transform([](auto &&str){ return string_view(&*str.begin(), ranges::distance(str)); })
-
-  long long i; int rc;
-  
-  auto split = string(arg) | splitView(',');
-  for(auto &&word : split){
-
-    if(noRanges){  // taskbars
-      if(0 != (rc = checkNbrc(op, string(arg).c_str(), i, zeroOK))) return rc;
-      if(!okZero && i==0){ gStr = *catStr({ regexSubst(word, " ").c_str() }); return 3; }
-      if(i==0) zeroIntheList = true;
-      set.insert((ULONG) i);
-      continue;
-    }
-
-    // word is a range (buttons only)
-    if(regexMatch(word, "^[ ]*[0-9]+-[0-9]+[ ]*$")){
-      auto splitw = word | splitView('-');
-      vector<long long> nbrs; auto iter = begin(splitw); auto pastLastElem = end(splitw);
-      for(auto &&nbr : splitw){ 
-        if(0 != (rc = checkNbrc(op, string(nbr).c_str(), i, zeroOK))) return rc;
-        if(!okZero && i==0){ gStr = *catStr({ regexSubst(word, " ").c_str() }); return 3; }
-        if(i==0) zeroIntheList = true;
-        nbrs.push_back(i-1);
-        if(++iter==pastLastElem){
-          if(nbrs[0]>nbrs[1]){
-            flushErr("\n  Error: in argument to \"%s\": \"%s\": not a valid numeric range (%d > %d, did you mean "
-              "%d-%d ?)\n\n", optByUser[op], regexSubst(word, " ").c_str(), 1+nbrs[0], 1+nbrs[1], 1+nbrs[1], 1+nbrs[0]); return 30;
-          }
-          for(i=nbrs[0]; (i++)<=nbrs[1];) set.insert((ULONG) i);
-        }
-      }
-    } // end range
-    else {  // word is a single nbr
-      if(0 != (rc = checkNbrc(op, string(word).c_str(), i, zeroOK))) return rc;
-      if(!okZero && i==0){ gStr = *catStr({ regexSubst(word, " ").c_str() }); return 3; }
-      if(i==0) zeroIntheList = true;
-      set.insert((ULONG) i);
+  };
+  for(;;){  // 1,2-4,6  (not 1,2-4,6 unless Ranges)
+    blanks(); size_t from = at;
+    if(!number(i)) return malformed();
+    blanks(); j = i;
+    if(at < n && arg[at]=='-'){ if(!Ranges) return malformed(); at++; blanks(); if(!number(j)) return malformed(); }
+    if(i > nbrMax || j > nbrMax){ flushErr("\n Error: arg%d: '%s' : number too large\n Try option -h\n\n", iArg, word(from).c_str()); return 25; }
+    if(!okZero && (i==0 || j==0)){ zeroIn = word(from); return 3; }
+    if(i==0 || j==0) zeroIntheList = true;
+    if(i > j){
+      flushErr("\n  Error: in argument to \"%s\": \"%s\": not a valid numeric range (%lld > %lld, did you mean "
+        "%lld-%lld ?)\n\n", optByUser[op], word(from).c_str(), i, j, j, i); return 30;
+    }
+    if(j - i >= rangeMax){
+      flushErr("\n  Error: in argument to \"%s\": \"%s\": range too large (more than %lld positions)\n\n", optByUser[op], word(from).c_str(), rangeMax); return 30;
     }
+    for(long long k = i; k <= j; k++) set.insert((ULONG) k);
+    blanks(); if(at == n) break;
+    if(arg[at] != ',') return malformed();
+    at++;
   }
-  #undef splitView
   return zeroIntheList ? 1:0;
 }
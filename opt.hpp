@@ -1,202 +1,164 @@
-
 // opt.hpp
 // Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
-// v0.3b 2022.06
+// v0.4 2022.07
 // Getopt for humans : an explicit, easy to use C++ getopt (C++20)
 // 
 // It is so explicit, we only need to agree on :
-//  optList(a,s)
 //  user call: p.exe -a f.txt -s
 //  -> argument#1 = "-a"     argument#2 = "f.txt"    argument#3 = "-s"
 //     options : -a, -s   (arg1 and arg3)
 //     "f.txt" is the argument of option "-a"
 //
+// Options and the rules between them are constant tables, checked when compiled (static_assert) : nothing is built
+// at run time, no option count limit.
+//
 // Example use (erase or swap two lines of a text file):
 // 
-//      optList(f, n, e, s);  // -> optCnt == 4
+//      enum optId : short { f, n, e, s };   // the options, in the order of their definition
 //      optsNeedArgByDefault = true;   // all options must have an argument ! (disable per opt with optHasNoArg)
-//      optAdd(              
-//           ( f, ("-f", "--file", "-file"),    optMandatory )  
-//          ,( n, ("-n", "--line-number"),      optMandatory & optCanRepeat )
-//          ,( e, ("-e", "--erase", "-erase"),  optHasNoArg  )
-//          ,( s, ("-s", "--swap", "-swap"),    optHasNoArg  )  // error if commented : all optListed options must be defined
+//      static constexpr optDef opts[] = {
+//           { f, "-f --file -file",        optMandatory }
+//          ,{ n, "-n --line-number",       optMandatory | optCanRepeat }
+//          ,{ e, "-e --erase -erase",      optHasNoArg  }
+//          ,{ s, "-s --swap -swap",        optHasNoArg  }  // error if commented : all options of optId must be defined
+//      };
+//      static constexpr auto rules = optRules(
+//           optsMustHaveOneOf( e, s )
+//          ,optsRelation( optExcludeEachOther, {{ n, e, L"Error: swap or erase, not both" }} )  // custom error msg
+//          ,optsRelation( optRequires,         {{ n, f }, { e, f }, { s, f }} )  // see enum class optRel (here it is useless, since -f is optMandatory)
 //      );
-//
-//      optsMustHaveOneOf( e, s );
-// 
-//      optsRelation( optExcludeEachOther, (n, e, L"Error: swap or erase, not both") );  // custom error msg
-//      optsRelation( optRequires,         (n, f), (e, f), (s, f));  // see enum class optRel (here it is useless, since -f is optMandatory)
-//
-//      optSetIndicator( (s, SWAP), (n, NBR) );  // your bool SWAP = true if "-s" used, for your own processing of args (keep yourself informed)
+//      static_assert(optsDefined(opts), "options : each defined once, in the order of optId, each form spelled once");
+//      static_assert(optsConsistent(opts, rules), "options : contradictory relations");
 // 
 //      OPT_GRACEFUL = true;  // be tolerant with errant unlawful arguments that do no harm
-//      optLoad(argc, argv);   // all of your rules apply, rc == 0 -> all rules satisfied
+//      int rc = optLoad(argc, argv, opts, rules, {{ s, &SWAP }, { n, &NBR }});  // your bool SWAP = true if "-s" used
+//      // all of your rules apply, rc == 0 -> all rules satisfied
 //      bool notGraceful = false;  // if you want to override OPT_GRACEFUL
-//      int rc = optNoExtraArgs(argv, notGraceful)  // severely check for errant args (extra args, unsupported options)
+//      rc = optNoExtraArgs(argv, notGraceful)  // severely check for errant args (extra args, unsupported options)
 // 
 // call : p.exe -file "" "_" "__" f.txt -n 2,17 -s extraArg -p    ("_" : called by a script that passes arg. "$var", and $var is empty)
 //   ->  optArgi[f] == 5 (index in argv of -f's argument), optByUser[f] == "-file" (form chosen by the user)
 //       Warning/error (depends on OPT_GRACEFUL) messages for "extraArg" (-s optHasNoArg) and "-p" (unsupported option)
 // 
-// TODO: optCanRepeat, trailing arguments
+// optCanRepeat : optArgsOf(id) holds the argument of each occurence, in order (optArgi[id] : the last one's)
+// TODO: trailing arguments
 
 #include <vector>
+#include <array>
+#include <span>
+#include <initializer_list>
 #include <algorithm>
+#include <string>
+#include <string_view>
+#include <climits>
+#include <cstdio>
+#include <cctype>
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
 
 
-#define FE_0(WHAT)
-#define FE_1(WHAT, X) WHAT(X) 
-#define FE_2(WHAT, X, ...) WHAT(X)FE_1(WHAT, __VA_ARGS__)
-#define FE_3(WHAT, X, ...) WHAT(X)FE_2(WHAT, __VA_ARGS__)
-#define FE_4(WHAT, X, ...) WHAT(X)FE_3(WHAT, __VA_ARGS__)
-#define FE_5(WHAT, X, ...) WHAT(X)FE_4(WHAT, __VA_ARGS__)
-#define FE_6(WHAT, X, ...) WHAT(X)FE_5(WHAT, __VA_ARGS__)
-#define FE_7(WHAT, X, ...) WHAT(X)FE_6(WHAT, __VA_ARGS__)
-#define FE_8(WHAT, X, ...) WHAT(X)FE_7(WHAT, __VA_ARGS__)
-#define FE_9(WHAT, X, ...) WHAT(X)FE_8(WHAT, __VA_ARGS__)
-#define FE_10(WHAT, X, ...) WHAT(X)FE_9(WHAT, __VA_ARGS__)
-#define FE_11(WHAT, X, ...) WHAT(X)FE_10(WHAT, __VA_ARGS__)
-#define FE_12(WHAT, X, ...) WHAT(X)FE_11(WHAT, __VA_ARGS__)
-#define FE_13(WHAT, X, ...) WHAT(X)FE_12(WHAT, __VA_ARGS__)
-#define FE_14(WHAT, X, ...) WHAT(X)FE_13(WHAT, __VA_ARGS__)
-#define FE_15(WHAT, X, ...) WHAT(X)FE_14(WHAT, __VA_ARGS__)
-#define FE_16(WHAT, X, ...) WHAT(X)FE_15(WHAT, __VA_ARGS__)
-#define FE_17(WHAT, X, ...) WHAT(X)FE_16(WHAT, __VA_ARGS__)
-#define FE_18(WHAT, X, ...) WHAT(X)FE_17(WHAT, __VA_ARGS__)
-#define FE_19(WHAT, X, ...) WHAT(X)FE_18(WHAT, __VA_ARGS__)
-#define FE_20(WHAT, X, ...) WHAT(X)FE_19(WHAT, __VA_ARGS__)
-#define FE_21(WHAT, X, ...) WHAT(X)FE_20(WHAT, __VA_ARGS__)
-#define FE_22(WHAT, X, ...) WHAT(X)FE_21(WHAT, __VA_ARGS__)
-#define FE_23(WHAT, X, ...) WHAT(X)FE_22(WHAT, __VA_ARGS__)
-#define FE_24(WHAT, X, ...) WHAT(X)FE_23(WHAT, __VA_ARGS__)
-#define FE_25(WHAT, X, ...) WHAT(X)FE_24(WHAT, __VA_ARGS__)
-#define FE_26(WHAT, X, ...) WHAT(X)FE_25(WHAT, __VA_ARGS__)
-#define FE_27(WHAT, X, ...) WHAT(X)FE_26(WHAT, __VA_ARGS__)
-#define FE_28(WHAT, X, ...) WHAT(X)FE_27(WHAT, __VA_ARGS__)
-#define FE_29(WHAT, X, ...) WHAT(X)FE_28(WHAT, __VA_ARGS__)
-#define FE_30(WHAT, X, ...) WHAT(X)FE_29(WHAT, __VA_ARGS__)
-#define FE_31(WHAT, X, ...) WHAT(X)FE_30(WHAT, __VA_ARGS__)
-#define FE_32(WHAT, X, ...) WHAT(X)FE_31(WHAT, __VA_ARGS__)
-#define FE_33(WHAT, X, ...) WHAT(X)FE_32(WHAT, __VA_ARGS__)
-#define FE_34(WHAT, X, ...) WHAT(X)FE_33(WHAT, __VA_ARGS__)
-#define FE_35(WHAT, X, ...) WHAT(X)FE_34(WHAT, __VA_ARGS__)
-#define FE_36(WHAT, X, ...) WHAT(X)FE_35(WHAT, __VA_ARGS__)
-#define FE_37(WHAT, X, ...) WHAT(X)FE_36(WHAT, __VA_ARGS__)
-#define FE_38(WHAT, X, ...) WHAT(X)FE_37(WHAT, __VA_ARGS__)
-#define FE_39(WHAT, X, ...) WHAT(X)FE_38(WHAT, __VA_ARGS__)
-#define FE_40(WHAT, X, ...) WHAT(X)FE_39(WHAT, __VA_ARGS__)
-#define FE_41(WHAT, X, ...) WHAT(X)FE_40(WHAT, __VA_ARGS__)
-#define FE_42(WHAT, X, ...) WHAT(X)FE_41(WHAT, __VA_ARGS__)
-#define FE_43(WHAT, X, ...) WHAT(X)FE_42(WHAT, __VA_ARGS__)
-#define FE_44(WHAT, X, ...) WHAT(X)FE_43(WHAT, __VA_ARGS__)
-#define FE_45(WHAT, X, ...) WHAT(X)FE_44(WHAT, __VA_ARGS__)
-#define FE_46(WHAT, X, ...) WHAT(X)FE_45(WHAT, __VA_ARGS__)
-#define FE_47(WHAT, X, ...) WHAT(X)FE_46(WHAT, __VA_ARGS__)
-#define FE_48(WHAT, X, ...) WHAT(X)FE_47(WHAT, __VA_ARGS__)
-#define FE_49(WHAT, X, ...) WHAT(X)FE_48(WHAT, __VA_ARGS__)
-#define FE_50(WHAT, X, ...) WHAT(X)FE_49(WHAT, __VA_ARGS__)
-#define FE_51(WHAT, X, ...) WHAT(X)FE_50(WHAT, __VA_ARGS__)
-#define FE_52(WHAT, X, ...) WHAT(X)FE_51(WHAT, __VA_ARGS__)
-#define FE_53(WHAT, X, ...) WHAT(X)FE_52(WHAT, __VA_ARGS__)
-#define FE_54(WHAT, X, ...) WHAT(X)FE_53(WHAT, __VA_ARGS__)
-#define FE_55(WHAT, X, ...) WHAT(X)FE_54(WHAT, __VA_ARGS__)
-#define FE_56(WHAT, X, ...) WHAT(X)FE_55(WHAT, __VA_ARGS__)
-#define FE_57(WHAT, X, ...) WHAT(X)FE_56(WHAT, __VA_ARGS__)
-#define FE_58(WHAT, X, ...) WHAT(X)FE_57(WHAT, __VA_ARGS__)
-#define FE_59(WHAT, X, ...) WHAT(X)FE_58(WHAT, __VA_ARGS__)
-#define FE_60(WHAT, X, ...) WHAT(X)FE_59(WHAT, __VA_ARGS__)
-#define FE_61(WHAT, X, ...) WHAT(X)FE_60(WHAT, __VA_ARGS__)
-#define FE_62(WHAT, X, ...) WHAT(X)FE_61(WHAT, __VA_ARGS__)
-#define FE_63(WHAT, X, ...) WHAT(X)FE_62(WHAT, __VA_ARGS__)
-
-#define GET_MACRO(_0,_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,_17,_18,_19,_20,_21,_22,_23,_24,_25,_26, \
-  _27,_28,_29,_30,_31,_32,_33,_34,_35,_36,_37,_38,_39,_40,_41,_42,_43,_44,_45,_46,_47,_48,_49,_50,_51,_52,_53,_54,   \
-  _55,_56,_57,_58,_59,_60,_61,_62,_63,NAME,...) NAME 
-#define FOR_EACH(action,...) \
-  GET_MACRO(_0,__VA_ARGS__,FE_63,FE_62,FE_61,FE_60,FE_59,FE_58,FE_57,FE_56,FE_55,FE_54,FE_53,FE_52,FE_51,FE_50,FE_49, \
-  FE_48,FE_47,FE_46,FE_45,FE_44,FE_43,FE_42,FE_41,FE_40,FE_39,FE_38,FE_37,FE_36,FE_35,FE_34,FE_33,FE_32,FE_31,FE_30,  \
-  FE_29,FE_28,FE_27,FE_26,FE_25,FE_24,FE_23,FE_22,FE_21,FE_20,FE_19,FE_18,FE_17,FE_16,FE_15,FE_14,FE_13,FE_12,FE_11,  \
-  FE_10,FE_9,FE_8,FE_7,FE_6,FE_5,FE_4,FE_3,FE_2,FE_1,FE_0)(action,__VA_ARGS__)
-
-#define PP_NARG(...) \
-         PP_NARG_(__VA_ARGS__,PP_RSEQ_N())
-#define PP_NARG_(...) \
-         PP_ARG_N(__VA_ARGS__)
-#define PP_ARG_N( \
-          _1, _2, _3, _4, _5, _6, _7, _8, _9,_10, \
-         _11,_12,_13,_14,_15,_16,_17,_18,_19,_20, \
-         _21,_22,_23,_24,_25,_26,_27,_28,_29,_30, \
-         _31,_32,_33,_34,_35,_36,_37,_38,_39,_40, \
-         _41,_42,_43,_44,_45,_46,_47,_48,_49,_50, \
-         _51,_52,_53,_54,_55,_56,_57,_58,_59,_60, \
-         _61,_62,_63,N,...) N
-#define PP_RSEQ_N() \
-         63,62,61,60,                   \
-         59,58,57,56,55,54,53,52,51,50, \
-         49,48,47,46,45,44,43,42,41,40, \
-         39,38,37,36,35,34,33,32,31,30, \
-         29,28,27,26,25,24,23,22,21,20, \
-         19,18,17,16,15,14,13,12,11,10, \
-         9,8,7,6,5,4,3,2,1,0
-
 #define vectFind(v,i) (std::find(begin(v), end(v), (i)))
 #define vectContains(v,i) ((vectFind(v,i)) != std::end(v))
 #define vectContainsStr(v,i) (v.end()!=std::find_if(v.begin(), v.end(), [i](const auto m)->bool{ return 0==strcmp(i, m); }))
 
-short optCnt = 0, optCurrentArg = 0;
+static thread_local short optCnt = 0;  // options of the table loaded (optLoad()), per thread as the rest
 #define optNoSpec    0
 #define optMandatory 0b0001
 #define optCanRepeat 0b0010
 #define optNeedsArg  0b0100
 #define optHasNoArg  0b1000
-struct Opt{ short id = 0; short argi = 0;
-  vector<LPCSTR> *t = nullptr;
-  int traits = optNoSpec;
-  bool *bPresence = nullptr;
-  vector<int> occurences; 
-};
-static vector<Opt *> Opts; static short* optArgi, *optidArgs;  vector<short> optArgNotAnOpt; static short *optRedefinitions;
-static LPCSTR *optByUser; static vector<short> optByUserI; static vector<vector<short>> optVIPs;
-static short *opt2Argi, *opt2idT, *optArgi2Opt; static bool optsNeedArgByDefault = false, OPT_GRACEFUL = false;
-#pragma warning (disable: 4003)
-#define UNPACK(...) __VA_ARGS__
-#define _2_ARGS(id,text)   if(Opts[o_##id]->t) optRedefinitions[o_##id] = 1; (Opts[o_##id])->t = new vector<LPCSTR>({ UNPACK text }); \
-  (Opts[o_##id])->traits |= (optsNeedArgByDefault? optNeedsArg : optNoSpec); 
-#define _3_ARGS(id,text,v) if(Opts[o_##id]->t) optRedefinitions[o_##id] = 1; (Opts[o_##id])->t = new vector<LPCSTR>({ UNPACK text }); \
-  if(v & optHasNoArg) (Opts[o_##id])->traits |= v; else (Opts[o_##id])->traits |= v | (optsNeedArgByDefault? optNeedsArg : optNoSpec);
-#define GET_4TH_ARG(arg1, arg2, arg3, arg4, ...) arg4
-#define _MACRO_CHOOSER(...) GET_4TH_ARG(__VA_ARGS__, _3_ARGS, _2_ARGS)
-#define _MACRO_CHOOSER0(...) _MACRO_CHOOSER __VA_ARGS__ __VA_ARGS__
-#define optAdd(...) FOR_EACH(_MACRO_CHOOSER0, __VA_ARGS__)
-// optAdd(cg, ("-cg", "--change-group"), chgGroup);
-
-#define optSetIndicator1(id,v) (*(Opts[o_##id])).bPresence = & v; 
-#define optSetIndicator11(X) optSetIndicator1 X
-#define optSetIndicator(...) FOR_EACH(optSetIndicator11, __VA_ARGS__)
-
-#define optMakeComma1(X) X,
-#define optMakeCommaList(X,...) FOR_EACH(optMakeComma1,__VA_ARGS__) X
-#define optFill1(X)        Opts.push_back(new Opt({ .id = optCnt })); short o_##X = opt2idT[X] = optCnt++; optByUserI.push_back(X); optByUser[X] = #X;
-#define optFillList(X,...) Opts.push_back(new Opt({ .id = optCnt })); short o_##X = opt2idT[X] = optCnt++; optByUserI.push_back(X); optByUser[X] = #X; \
-  FOR_EACH(optFill1,__VA_ARGS__)
-#define optList(X,...) optCnt = 1+PP_NARG(__VA_ARGS__); opt2Argi = new short[optCnt](); optArgi = new short[optCnt](); opt2idT = new short[optCnt](); \
-  optArgi2Opt = new short[optCnt](); optidArgs = new short[optCnt](); optByUser = new LPCSTR[optCnt](); optRedefinitions = new short[optCnt](); optCnt = 0;  \
-  typedef enum { X = 0, optMakeCommaList(__VA_ARGS__) } optId; optFill1(X); optFillList(__VA_ARGS__);  
-#define optsMustHaveOneOf(...) optVIPs.push_back({ optMakeCommaList(__VA_ARGS__) });
-
-enum class optRel{ unrelated, require, excludeEachOther, requireEachOther, comesBefore, comesAfter };
+#define optArgOptional 0b10000  // takes the argument following it, if any
+
+// Option id (its optId), its forms (blank-separated : "-f --from -from"), its traits
+struct optDef{ short id; const char *forms; int traits = optNoSpec; };
+// Indicator : *on = true when option id is used
+struct optFlag{ short id; bool *on; };
+
+enum class optRel{ unrelated, require, excludeEachOther, requireEachOther, comesBefore, comesAfter, oneOf };
 static const optRel optRequires = optRel::require, optUnrelated = optRel::unrelated, optExcludeEachOther = optRel::excludeEachOther,
 optComesAfter = optRel::comesAfter, optRequireEachOther = optRel::requireEachOther, optComesBefore = optRel::comesBefore;
-static optRel optRelTmp;
+// oneOf : depOpId, on a group's first, is the number of options in the group (0 on the others)
 struct optRelation{ short opId; optRel rel = optRel::unrelated; short depOpId; LPCWSTR errMsg = nullptr; };
-static vector<optRelation *> optRels;
-#pragma warning (disable: 5103)
-#define _2_ARGS1(id1,id2)      optRels.push_back(new optRelation({ o_##id1, optRelTmp, o_##id2, nullptr }));
-#define _3_ARGS1(id1,id2,msg)  optRels.push_back(new optRelation({ o_##id1, optRelTmp, o_##id2, msg }));
-#define GET_4TH_ARG1(arg1, arg2, arg3, arg4, ...) arg4
-#define _MACRO_CHOOSER1(...) GET_4TH_ARG1(__VA_ARGS__, _3_ARGS1, _2_ARGS1)
-#define optsRelated1(...) _MACRO_CHOOSER1 __VA_ARGS__ __VA_ARGS__
-#define optsRelation(X,...) optRelTmp = X; FOR_EACH(optsRelated1, __VA_ARGS__)
+// Two options related : { a, b }, or { a, b, L"custom error message" }
+struct optPair{ short a, b; LPCWSTR errMsg = nullptr; };
+
+// Each form of forms, in turn, to f (true : stop there) : true if stopped
+template <typename F> constexpr bool optEachForm(const char *forms, F f){
+  for(string_view s = forms; !s.empty(); ){
+    size_t n = s.find(' ');
+    if(n && f(s.substr(0, n))) return true;
+    if(n == string_view::npos) break;
+    s.remove_prefix(n + 1);
+  }
+  return false;
+}
+constexpr string_view optFirstForm(const char *forms){ string_view s = forms; return s.substr(0, s.find(' ')); }
+
+template <size_t N> consteval array<optRelation, N> optsRelation(optRel rel, const optPair (&p)[N]){
+  array<optRelation, N> r{}; for(size_t i = 0; i < N; i++) r[i] = { p[i].a, rel, p[i].b, p[i].errMsg };
+  return r;
+}
+// One of these at least must be used
+template <typename... Id> consteval array<optRelation, sizeof...(Id)> optsMustHaveOneOf(Id... ids){
+  array<optRelation, sizeof...(Id)> r{{ { (short) ids, optRel::oneOf, 0 }... }};
+  r[0].depOpId = (short) sizeof...(Id); return r;
+}
+template <size_t... N> consteval array<optRelation, (N + ... + 0)> optRules(const array<optRelation, N>&... parts){
+  array<optRelation, (N + ... + 0)> r{}; size_t i = 0;
+  ((copy(parts.begin(), parts.end(), r.begin() + i), i += N), ...);
+  return r;
+}
+
+// Compile-time checks (static_assert) : each option defined once, in the order of optId, each form of them all spelled
+// once, no option both needing and refusing an argument
+template <size_t N> consteval bool optsDefined(const optDef (&d)[N]){
+  for(size_t i = 0; i < N; i++){
+    if(d[i].id != (short) i || !d[i].forms || optFirstForm(d[i].forms).empty()) return false;
+    if((d[i].traits & optNeedsArg) && (d[i].traits & (optHasNoArg | optArgOptional))) return false;
+    bool twice = optEachForm(d[i].forms, [&](string_view f){
+      int seen = 0; for(size_t j = 0; j < N; j++) optEachForm(d[j].forms, [&](string_view g){ seen += f == g; return false; });
+      return seen > 1;
+    });
+    if(twice) return false;
+  }
+  return true;
+}
+// Relations between defined options, none contradicting another : requiring what it excludes, two mandatory options
+// excluding each other, an order and its opposite
+template <size_t N, size_t M> consteval bool optsConsistent(const optDef (&d)[N], const array<optRelation, M> &r){
+  auto has = [&](short a, optRel rel, short b){
+    for(auto &x : r) if(x.rel == rel && x.opId == a && x.depOpId == b) return true;
+    return false;
+  };
+  auto excluded = [&](short a, short b){ return has(a, optRel::excludeEachOther, b) || has(b, optRel::excludeEachOther, a); };
+  for(size_t i = 0; i < M; i++){
+    short a = r[i].opId, b = r[i].depOpId;
+    if(a < 0 || a >= (short) N) return false;
+    if(r[i].rel == optRel::oneOf){ if(b && i + b > M) return false; continue; }
+    if(b < 0 || b >= (short) N || a == b) return false;
+    switch(r[i].rel){
+      case optRel::require: case optRel::requireEachOther: if(excluded(a, b)) return false; break;
+      case optRel::excludeEachOther: if((d[a].traits & optMandatory) && (d[b].traits & optMandatory)) return false; break;
+      case optRel::comesBefore: if(has(a, optRel::comesAfter, b) || has(b, optRel::comesBefore, a)) return false; break;
+      case optRel::comesAfter:  if(has(b, optRel::comesAfter, a)) return false; break;
+      default: break;
+    }
+  }
+  return true;
+}
+
+// Per option (by optId), set by optLoad(). Per thread : command lines parsed on several at once don't mix.
+static thread_local short *optArgi;           // index in argv of its argument (of its last occurence having one), 0 : none
+static thread_local LPCSTR *optByUser;        // form used (its forms, if unused)
+static thread_local short *optAt;             // index in argv of its last occurence, 0 : unused
+static thread_local vector<short> *optArgis;  // argument of each occurence (0 : none)
+static thread_local vector<short> optArgNotAnOpt;
+static thread_local span<const optDef> optTable; static thread_local span<const optRelation> optRuleSet;
+static thread_local bool optsNeedArgByDefault = false, OPT_GRACEFUL = false;
 
 #define OPT_ERR_REPEAT       166
 #define OPT_ERR_MISSING      167
@@ -211,118 +173,253 @@ static vector<optRelation *> optRels;
 #define OPT_ERR_EXTRA_ARGS   176
 #define OPT_ERR_ERR          177
 
-inline int optErr(long long Err, char const* const* argv, Opt const* op1, 
-  Opt const* op2 = nullptr, LPCWSTR errMsg = nullptr){
-  if(errMsg){ flushOut("\n %s\n\n", *wide2uf8(errMsg)); return (int)Err; }
-  #define OPTERR(I) if(!op##I){ cerr << "\n Error: internal: bad call to optErr(): op#I missing\n\n"; return OPT_ERR_ERR; }
-  if(Err>=LLONG_MAX-10000){         long long i = LLONG_MAX-10000; i = Err - i;
-    if(optVIPs[i].size()==1) cerr << "\n Error: required option missing : ";
-    else cerr << "\n Error: at least one of these options must be provided : "; 
-    for(auto n : optVIPs[i]) cerr << *((Opts[opt2idT[n]]->t)->begin()) << " "; cerr <<"\n\n";
-    usage(); return OPT_ERR_VIP_MISS;
-  }
-  OPTERR(1);
+inline int optTraits(short id){
+  int t = optTable[id].traits;
+  return (t & (optHasNoArg | optArgOptional)) || !optsNeedArgByDefault ? t : t | optNeedsArg;
+}
+
+// OPT_ERR_VIP_MISS : id1 is the index in optRuleSet of the group's first
+inline int optErr(int Err, char const* const* argv, short id1, short id2 = -1, LPCWSTR errMsg = nullptr){
+  if(errMsg){ flushErr("\n %s\n\n", *wide2uf8(errMsg)); return Err; }
+  auto first = [](short id){ return optFirstForm(optTable[id].forms); };
+  #define OPTERR2 if(id2 < 0){ flushErr("\n Error: internal: bad call to optErr(): second option missing\n\n"); return OPT_ERR_ERR; }
   switch(Err){
+    case OPT_ERR_VIP_MISS: {
+      short n = optRuleSet[id1].depOpId;
+      if(n==1) flushErr("\n Error: required option missing : ");
+      else flushErr("\n Error: at least one of these options must be provided : ");
+      for(short k = 0; k < n; k++){ auto f = first(optRuleSet[id1 + k].opId); flushErr("%.*s ", (int) f.size(), f.data()); }
+      flushErr("\n\n"); usage(); break;
+    }
     case OPT_ERR_REPEAT:
-      cerr << "\n Error: option \""<< argv[op1->argi] <<"\" provided more than once\n\n"; usage(); break;
-    case OPT_ERR_MISSING: cerr << "\n Error: option \""<< *(*op1->t).begin() <<"\" missing\n\n"; usage(); break;
-    case OPT_ERR_CONFLICT:  OPTERR(2);
-      cerr << "\n Error: option conflict: \""<< argv[op1->argi] <<"\" and \""<< *((*op2->t).begin()) <<"\"\n\n"; usage(); break;
-    case OPT_ERR_DEP_MISS: OPTERR(2);
-      cerr << "\n Error: option \""<< argv[op1->argi] <<"\" requires missing option \""<< *((*op2->t).begin()) <<"\"\n\n"; usage(); break;
-    case OPT_ERR_ARG_MISS: cerr << "\n Error: missing argument for option \""<< argv[op1->argi] <<"\"\n\n"; usage(); break;
+      flushErr("\n Error: option \"%s\" provided more than once\n\n", argv[optAt[id1]]); usage(); break;
+    case OPT_ERR_MISSING: { auto f = first(id1); flushErr("\n Error: option \"%.*s\" missing\n\n", (int) f.size(), f.data()); usage(); break; }
+    case OPT_ERR_CONFLICT: { OPTERR2; auto f = first(id2);
+      flushErr("\n Error: option conflict: \"%s\" and \"%.*s\"\n\n", argv[optAt[id1]], (int) f.size(), f.data()); usage(); break; }
+    case OPT_ERR_DEP_MISS: { OPTERR2; auto f = first(id2);
+      flushErr("\n Error: option \"%s\" requires missing option \"%.*s\"\n\n", argv[optAt[id1]], (int) f.size(), f.data()); usage(); break; }
+    case OPT_ERR_ARG_MISS: flushErr("\n Error: missing argument for option \"%s\"\n\n", argv[optAt[id1]]); usage(); break;
     case OPT_ERR_UNWANTED_ARG: 
-      cerr << "\n Error: \""<<argv[op1->argi]<<"\" takes no argument, and \""<<argv[optidArgs[op1->id]]<<"\" not a supported option\n\n"; usage(); break;
-    case OPT_ERR_BAD_ORDER:
-      cerr << "\n Error: option \""<< argv[op2->argi] <<"\" shouldn't appear before \""<< argv[op1->argi] <<"\"\n\n"; usage(); break;
+      flushErr("\n Error: \"%s\" takes no argument, and \"%s\" not a supported option\n\n", argv[optAt[id1]], argv[optArgi[id1]]); usage(); break;
+    case OPT_ERR_BAD_ORDER: OPTERR2;
+      flushErr("\n Error: option \"%s\" shouldn't appear before \"%s\"\n\n", argv[optAt[id2]], argv[optAt[id1]]); usage(); break;
     case OPT_ERR_MISUSE:
-      cerr << "\n Error: internal: optErr() misused.\n\n"; break;
-    default: cerr << "\n Error: internal: unknown problem with provided options/arguments.\n\n"; return OPT_ERR_ERR; break;
+      flushErr("\n Error: internal: optErr() misused.\n\n"); break;
+    default: flushErr("\n Error: internal: unknown problem with provided options/arguments.\n\n"); return OPT_ERR_ERR; break;
   }
-  #undef OPTERR
-  return (int) Err;
+  #undef OPTERR2
+  return Err;
 }
 
-inline int optLoad(int argc, char const* const* argv){
-  string sArg; vector<short> idUsedOpts; { 
-  for(auto k=0; k<optCnt; k++) if(optRedefinitions[k])    // optByUser : user of this header
-    cerr <<"\n  Warning: internal: option #"<<(1+k)<<" ("<<optByUser[optByUserI[k]]<<") in call to optList() defined more than once with optAdd()\n"; }
-  bool argIsAnOpt = false; short idLastOpt = 0;
+// Option argument arg is a form of, -1 : none
+inline short optFind(string_view arg){
+  for(auto &d : optTable) if(optEachForm(d.forms, [&](string_view f){ return f == arg; })) return d.id;
+  return -1;
+}
+
+inline int optLoad(int argc, char const* const* argv, span<const optDef> defs, span<const optRelation> rules, initializer_list<optFlag> flags){
+  optTable = defs; optRuleSet = rules; optCnt = (short) defs.size(); optArgNotAnOpt.clear();
+  for(short k = 0; k < optCnt; k++){ optArgi[k] = optAt[k] = 0; optByUser[k] = defs[k].forms; optArgis[k].clear(); }
+
+  short idLastOpt = -1;  // option whose argument may follow
   for(short i=1; i<argc; i++){
-    sArg = argv[i];
-    if(sArg=="-h" || sArg=="--help"){ cerr << "\n  arg #"<<i<<" : "<<sArg<<endl; usage(); return 1; }
+    string_view sArg = argv[i];
+    if(sArg=="-h" || sArg=="--help"){ flushErr("\n  arg #%d : %s\n", i, argv[i]); usage(); return 1; }
     
-    bool argIsAnOptLoc = false;
-    for(short j=0; j<Opts.size(); j++){ Opt *op = Opts[j];
-      if(!op->t){ cerr << "\n Error: internal: option #"<<++op->id<<" in call to optList() not defined (with optAdd())\n\n"; return OPT_ERR_MISUSE; }
-      LPCSTR arg = argv[i];
-      if(vectContainsStr((*(op->t)), arg)){  
-        optArgi2Opt[i] = 1+j; opt2Argi[optByUserI[op->id]] = op->argi = i; idUsedOpts.push_back(op->id);
-        idLastOpt = op->id; optByUser[optByUserI[op->id]] = argv[i];  // optByUser update : now holds the opt form used by program caller
-        if((op->occurences.size() >= 1) && !(op->traits & optCanRepeat))
-          return optErr(OPT_ERR_REPEAT, argv, op);
-        op->occurences.push_back(i); if(op->bPresence) *(op->bPresence) = true;
-        argIsAnOpt = argIsAnOptLoc = true; break;
-      }
+    short id = optFind(sArg);
+    if(id >= 0){
+      bool again = optAt[id] != 0; optAt[id] = i; optByUser[id] = argv[i];  // optByUser : now holds the opt form used by program caller
+      if(again && !(optTable[id].traits & optCanRepeat)) return optErr(OPT_ERR_REPEAT, argv, id);
+      optArgis[id].push_back(0); for(auto &fl : flags) if(fl.id == id) *fl.on = true;
+      idLastOpt = id; continue;
     }
-    if(argIsAnOptLoc) continue;
-
-    optArgNotAnOpt.push_back(i);
-    if(argIsAnOpt){  // we're in the shadow of an option
-      if(all_of(sArg.begin(), sArg.end(), std::isspace)){ optArgNotAnOpt.pop_back(); continue; }  // skip empty args, traced in optArgNotAnOpt
-      optArgNotAnOpt.pop_back(); optArgi[optByUserI[idLastOpt]] = optidArgs[idLastOpt] = i;
-      argIsAnOpt = false;
+    if(idLastOpt >= 0){  // we're in the shadow of an option
+      if(all_of(sArg.begin(), sArg.end(), [](unsigned char c){ return isspace(c); })) continue;  // skip empty args
+      optArgi[idLastOpt] = optArgis[idLastOpt].back() = i; idLastOpt = -1; continue;
     }
+    optArgNotAnOpt.push_back(i);
   }
   
   // VIP options
-  for(short i=0; i<optVIPs.size(); i++){   if(optVIPs[i].size()==0) continue;
-    bool b = true; for(auto id : optVIPs[i]) b = b & (opt2Argi[id]==0);
-    if(b) return optErr(LLONG_MAX-10000+i, argv, nullptr);
+  for(short r = 0; r < (short) rules.size(); r++){
+    if(rules[r].rel != optRel::oneOf || !rules[r].depOpId) continue;
+    bool none = true; for(short k = 0; k < rules[r].depOpId; k++) none = none && !optAt[rules[r + k].opId];
+    if(none) return optErr(OPT_ERR_VIP_MISS, argv, r);
   }
   // Mandatory options, missing args
-  for(auto op : Opts){
-    if((op->traits & optMandatory) && op->argi == 0)           return optErr(OPT_ERR_MISSING,  argv, op);
-    if(op->argi == 0) continue;
-    if((op->traits & optNeedsArg)){ if(optidArgs[op->id] == 0) return optErr(OPT_ERR_ARG_MISS, argv, op); }
-    else if(optidArgs[op->id] != 0){
-      if(OPT_GRACEFUL) cerr <<"\n  Warning: \""<<argv[op->argi]<<"\" takes no argument, and \""<<argv[optidArgs[op->id]]<<"\" not a supported option\n";
-      else return optErr(OPT_ERR_UNWANTED_ARG, argv, op);
+  for(short k = 0; k < optCnt; k++){ int traits = optTraits(k);
+    if((traits & optMandatory) && !optAt[k])  return optErr(OPT_ERR_MISSING,  argv, k);
+    if(!optAt[k]) continue;
+    if(traits & optNeedsArg){ if(!optArgi[k]) return optErr(OPT_ERR_ARG_MISS, argv, k); }
+    else if(optArgi[k] && !(traits & optArgOptional)){
+      if(OPT_GRACEFUL) flushErr("\n  Warning: \"%s\" takes no argument, and \"%s\" not a supported option\n", argv[optAt[k]], argv[optArgi[k]]);
+      else return optErr(OPT_ERR_UNWANTED_ARG, argv, k);
     }
-    
   }
   // Relations between opts
-  for(auto r : optRels){
-    optRelation rel = *r; short id1 = rel.opId, id2 = rel.depOpId;
-    bool op1 = vectContains(idUsedOpts, id1), op2 = vectContains(idUsedOpts, id2);
-    #define OPTERR(err,i1,i2) return optErr(err, argv, Opts[i1], Opts[i2], rel.errMsg); break;
+  for(auto &rel : rules){
+    short id1 = rel.opId, id2 = rel.depOpId;
+    if(rel.rel == optRel::oneOf) continue;
+    bool op1 = optAt[id1] != 0, op2 = optAt[id2] != 0;
+    #define OPTERR(err,i1,i2) return optErr(err, argv, i1, i2, rel.errMsg)
     switch(rel.rel){
-      case optRequires:         if(op1 && !op2)	OPTERR(OPT_ERR_DEP_MISS,id1,id2);
-      case optExcludeEachOther: if(op1 &&  op2) OPTERR(OPT_ERR_CONFLICT,id1,id2);
-      case optRequireEachOther: if(op1 && !op2) OPTERR(OPT_ERR_DEP_MISS,id1,id2);
-                                if(op2 && !op1) OPTERR(OPT_ERR_DEP_MISS,id2,id1);
-      case optComesBefore: if(op1 && op2 && Opts[id1]->argi > Opts[id2]->argi) OPTERR(OPT_ERR_BAD_ORDER,id1,id2);
-      case optComesAfter:  if(op1 && op2 && Opts[id1]->argi < Opts[id2]->argi) OPTERR(OPT_ERR_BAD_ORDER,id2,id1);
-      default: cerr << "\n Error: internal: unknown relation specification between options \""<<(op1? *((*Opts[id1]->t).begin()) : "")
-        <<"\" and \""<<(op1 ? *((*Opts[id2]->t).begin()) : "")<<"\".\n\n"; return OPT_ERR_MISUSE; break;
+      case optRel::require:          if(op1 && !op2) OPTERR(OPT_ERR_DEP_MISS,id1,id2); break;
+      case optRel::excludeEachOther: if(op1 &&  op2) OPTERR(OPT_ERR_CONFLICT,id1,id2); break;
+      case optRel::requireEachOther: if(op1 && !op2) OPTERR(OPT_ERR_DEP_MISS,id1,id2);
+                                     if(op2 && !op1) OPTERR(OPT_ERR_DEP_MISS,id2,id1);
+                                     break;
+      case optRel::comesBefore: if(op1 && op2 && optAt[id1] > optAt[id2]) OPTERR(OPT_ERR_BAD_ORDER,id1,id2); break;
+      case optRel::comesAfter:  if(op1 && op2 && optAt[id1] < optAt[id2]) OPTERR(OPT_ERR_BAD_ORDER,id2,id1); break;
+      default: { auto f1 = optFirstForm(defs[id1].forms), f2 = optFirstForm(defs[id2].forms);
+        flushErr("\n Error: internal: unknown relation specification between options \"%.*s\" and \"%.*s\".\n\n",
+          (int) f1.size(), f1.data(), (int) f2.size(), f2.data()); return OPT_ERR_MISUSE; }
     }
     #undef OPTERR
   }
 
   return 0;
 }
+// Options defs (optsDefined()), rules (optsConsistent()), flags : indicators. Per option state in static storage (per
+// thread), sized when compiled
+template <size_t N, size_t M>
+int optLoad(int argc, char const* const* argv, const optDef (&defs)[N], const array<optRelation, M> &rules, initializer_list<optFlag> flags = {}){
+  static thread_local short argi[N], at[N]; static thread_local LPCSTR byUser[N]; static thread_local vector<short> argis[N];
+  optArgi = argi; optAt = at; optByUser = byUser; optArgis = argis;
+  return optLoad(argc, argv, span<const optDef>(defs), span<const optRelation>(rules), flags);
+}
+// Argument index of each occurence of a repeatable option (optArgi[] : the last one's)
+inline const vector<short>& optArgsOf(short userId){ return optArgis[userId]; }
+
 int optNoExtraArgs(char const* const* const& argv, bool graceful = false){
   short sz = (short)optArgNotAnOpt.size();
   if(sz==0) return 0;
 
   graceful |= OPT_GRACEFUL;
-  if(graceful) cerr <<"\n  Warning: unused arguments:";
-  else         cerr <<"\n  Error: unused arguments:";
+  if(graceful) flushErr("\n  Warning: unused arguments:");
+  else         flushErr("\n  Error: unused arguments:");
 
-  for(short i=0; i<sz-1; i++) cerr <<" arg#"<<optArgNotAnOpt[i]<<" \""<< argv[optArgNotAnOpt[i]]<<"\","; 
-  cerr <<" arg#"<<optArgNotAnOpt[(size_t)sz-1]<<" \""<<argv[optArgNotAnOpt[(size_t)sz-1]]<<"\"\n";
+  for(short i=0; i<sz-1; i++) flushErr(" arg#%d \"%s\",", optArgNotAnOpt[i], argv[optArgNotAnOpt[i]]); 
+  flushErr(" arg#%d \"%s\"\n", optArgNotAnOpt[(size_t)sz-1], argv[optArgNotAnOpt[(size_t)sz-1]]);
   
-  if(!graceful){ cerr <<"\n"; return OPT_ERR_EXTRA_ARGS; }
+  if(!graceful){ flushErr("\n"); return OPT_ERR_EXTRA_ARGS; }
   return 0;
 }
 
+
+// Done with the options (optArgi, optByUser.. are gone) : frees what the repeated options and extra arguments took
+inline void optFree(){
+  for(short k = 0; k < optCnt; k++) vector<short>().swap(optArgis[k]);
+  vector<short>().swap(optArgNotAnOpt);
+  optArgi = optAt = nullptr; optByUser = nullptr; optArgis = nullptr; optTable = {}; optRuleSet = {}; optCnt = 0;
+}
+
+
+// Response files : an argument "@file" stands for the arguments the file holds, blank-separated ("double quotes" around
+// those with blanks, # : comment to end of line). The file is mapped copy-on-write and tokenized in place, each argument
+// NUL-terminated where it lies : argv points into the mapping, no argument is copied (only the pages written to are).
+// The UTF-16 form of an argument (args[i]) is made on first use : few are read as such. The command line is read once :
+// UTF-16 (Windows, wmain()), converted to UTF-8 here in one go, or UTF-8 (elsewhere).
+//
+//   optArgs args; if(args.load(argc, nullptr, wargv)) return ..;   optLoad(args.argc(), args.argv.data());
+class optArgs{
+  struct mapping{ char *base = nullptr; size_t size = 0;
+#ifdef _WIN32
+    HANDLE hFile = INVALID_HANDLE_VALUE, hMap = nullptr;
+#endif
+  };
+  vector<mapping> maps;
+  vector<int> from;          // index in the command line, -1 : read from a file
+  vector<wstring> wide;      // UTF-16 form of those read from a file, on first use
+  vector<string> tails;      // last argument of a file, when it ends the file (no room for its NUL)
+  LPWSTR const* cmdW = nullptr;  // command line as UTF-16, if given so
+  string cmd8;                   // and as UTF-8 : NUL-separated
+
+  bool map(LPCWSTR path, mapping &m){
+#ifdef _WIN32
+    m.hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER sz; if(m.hFile==INVALID_HANDLE_VALUE || !GetFileSizeEx(m.hFile, &sz)) return false;
+    if(!(m.size = (size_t) sz.QuadPart)) return true;
+    if(!(m.hMap = CreateFileMappingW(m.hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr))) return false;
+    m.base = (char *) MapViewOfFile(m.hMap, FILE_MAP_COPY, 0, 0, 0);
+#else
+    int fd = open(*wide2uf8(path), O_RDONLY); if(fd < 0) return false;
+    struct stat st{}; if(fstat(fd, &st)){ close(fd); return false; }
+    if(!(m.size = (size_t) st.st_size)){ close(fd); return true; }
+    void *v = mmap(nullptr, m.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0); close(fd);
+    m.base = v==MAP_FAILED ? nullptr : (char *) v;
+#endif
+    return m.base != nullptr;
+  }
+
+  // Arguments of mapping m, appended to argv
+  void tokenize(mapping &m){
+    char *e = m.base + m.size;
+    tokenize(m.base, e, [this, e](char *arg, char *w){
+      if(w < e){ *w = 0; argv.push_back(arg); }
+      else{ tails.emplace_back(arg, w); argv.push_back(nullptr); }  // pointed to once tails is complete
+      from.push_back(-1);
+    });
+  }
+
+public:
+  vector<char const*> argv;
+
+  // Arguments in [p, e) as in a response file, unquoted in place : add(arg, w) for each, w its end (where its NUL goes,
+  // if before e). Also the lines of a batch (batch.hpp).
+  template <typename F>
+  static void tokenize(char *p, char *e, F add){
+    auto blank = [](char c){ return c==' ' || c=='\t' || c=='\r' || c=='\n'; };
+    while(p < e){
+      if(blank(*p)){ p++; continue; }
+      if(*p=='#'){ while(p < e && *p!='\n') p++; continue; }
+      char *arg = p, *w = p; bool quoted = false;
+      for(; p < e && (quoted || !blank(*p)); p++) if(*p=='"') quoted = !quoted; else *w++ = *p;  // unquoted in place
+      add(arg, w); if(p < e) p++;
+    }
+  }
+
+  int argc() const { return (int) argv.size(); }
+
+  // Command line : av (UTF-8), or aw (UTF-16, av null). 0, or 39 : a response file could not be read, or too many arguments
+  int load(int argc, char const* const* av, LPWSTR const* aw){
+    cmdW = aw; vector<char const*> av8;
+    if(!av){
+      vector<size_t> at(argc); size_t n = 0;
+      for(int i = 0; i < argc; i++){ at[i] = n; n += (size_t) WideCharToMultiByte(CP_UTF8, 0, aw[i], -1, nullptr, 0, nullptr, nullptr); }
+      cmd8.resize(n);
+      for(int i = 0; i < argc; i++){
+        if(!WideCharToMultiByte(CP_UTF8, 0, aw[i], -1, &cmd8[at[i]], (int) (n - at[i]), nullptr, nullptr)) cmd8[at[i]] = 0;
+        av8.push_back(&cmd8[at[i]]);
+      }
+      av = av8.data();
+    }
+    for(int i = 0; i < argc; i++){
+      if(i==0 || av[i][0]!='@'){ argv.push_back(av[i]); from.push_back(i); continue; }
+      maps.emplace_back();
+      if(!map(aw ? aw[i] + 1 : *uf8toWide(av[i] + 1), maps.back())){ flushErr("\n  Error: cannot read the response file \"%s\"\n\n", av[i] + 1); return 39; }
+      if(maps.back().size) tokenize(maps.back());
+    }
+    for(size_t i = 0, t = 0; i < argv.size(); i++) if(!argv[i]) argv[i] = tails[t++].c_str();
+    if(argv.size() > SHRT_MAX){ flushErr("\n  Error: too many arguments (%zu, at most %d)\n\n", argv.size(), SHRT_MAX); return 39; }
+    wide.resize(argv.size());
+    return 0;
+  }
+
+  LPWSTR operator[](size_t i){
+    if(from[i] >= 0 && cmdW) return cmdW[from[i]];
+    if(wide[i].empty() && *argv[i]) wide[i] = *uf8toWide(argv[i]);
+    return wide[i].data();
+  }
+
+  ~optArgs(){
+    for(auto &m : maps){
+#ifdef _WIN32
+      if(m.base) UnmapViewOfFile(m.base);
+      if(m.hMap) CloseHandle(m.hMap);
+      if(m.hFile!=INVALID_HANDLE_VALUE) CloseHandle(m.hFile);
+#else
+      if(m.base) munmap(m.base, m.size);
+#endif
+    }
+  }
+};
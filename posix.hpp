@@ -0,0 +1,134 @@
+// posix.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// The few Win32 types and calls mv_tb_btn.cpp uses outside of its _WIN32 blocks, on POSIX : with MVBTN_TTSIM
+// (ttsim.hpp standing in for TTLib), the tool builds and runs on Linux, for the tests and benchmarks.
+// DWORD/ULONG stay unsigned long as in the Windows headers (the %lu formats), 64-bit here : checks against the
+// Windows range use uint32_t.
+//   g++ -std=c++20 -O2 -DMVBTN_TTSIM mv_tb_btn.cpp -o mv_tb_btn -pthread    (or CMakeLists.txt)
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdarg>
+#include <csignal>
+#include <string>
+#include <unistd.h>
+
+typedef int BOOL;                typedef unsigned long DWORD;     typedef unsigned long ULONG;    typedef long LONG;
+typedef unsigned int UINT;       typedef unsigned short USHORT;   typedef long HRESULT;           typedef uint64_t ULONGLONG;
+typedef uintptr_t ULONG_PTR;     typedef void *HANDLE, *HLOCAL;   typedef struct HWND__ *HWND;
+typedef wchar_t WCHAR;           typedef char CHAR;               typedef char *LPSTR;            typedef const char *LPCSTR;
+typedef wchar_t *LPWSTR;         typedef const wchar_t *LPCWSTR;  typedef const void *LPCVOID;  typedef const char *LPCCH;
+typedef DWORD *LPDWORD;
+
+#define TRUE  1
+#define FALSE 0
+#define WINAPI
+#define INFINITE   0xFFFFFFFF
+#define CP_UTF8    65001
+#define MB_ERR_INVALID_CHARS 8
+#define FAILED(hr) ((HRESULT)(hr) < 0)
+#define FORMAT_MESSAGE_ALLOCATE_BUFFER 0x100
+#define FORMAT_MESSAGE_FROM_SYSTEM     0x1000
+#define FORMAT_MESSAGE_IGNORE_INSERTS  0x200
+#define STRSAFE_E_INSUFFICIENT_BUFFER  ((HRESULT)0x8007007AL)
+#define STRSAFE_E_INVALID_PARAMETER    ((HRESULT)0x80070057L)
+#define STRSAFE_MAX_CCH                2147483647
+#define ERROR_ENVVAR_NOT_FOUND         203
+
+inline DWORD GetLastError(){ return (DWORD) errno; }
+// No system message table : printErr() then shows the message alone
+inline DWORD FormatMessageW(DWORD, LPCVOID, DWORD, DWORD, LPWSTR, DWORD, va_list*){ return 0; }
+inline HLOCAL LocalFree(HLOCAL p){ free(p); return nullptr; }
+
+// UTF-16 (wchar_t : UTF-32 here) <-> UTF-8, the only code page used (CP_UTF8). n < 0 : zero terminated, counted.
+inline std::string posixU8(LPCWSTR w, int n){
+  std::string s;
+  for(int i = 0; n < 0 ? w[i] != 0 : i < n; i++){
+    auto c = (uint32_t) w[i];
+    if(c < 0x80) s += (char) c;
+    else if(c < 0x800){ s += (char)(0xC0 | c >> 6); s += (char)(0x80 | (c & 63)); }
+    else if(c < 0x10000){ s += (char)(0xE0 | c >> 12); s += (char)(0x80 | (c >> 6 & 63)); s += (char)(0x80 | (c & 63)); }
+    else { s += (char)(0xF0 | c >> 18); s += (char)(0x80 | (c >> 12 & 63)); s += (char)(0x80 | (c >> 6 & 63)); s += (char)(0x80 | (c & 63)); }
+  }
+  if(n < 0) s.push_back(0);
+  return s;
+}
+inline std::wstring posixWide(LPCSTR c, int n){
+  std::wstring w; auto p = (const unsigned char*) c, end = p + (n < 0 ? strlen(c) : (size_t) n);
+  while(p < end){
+    uint32_t u = *p++; int more = u >= 0xF0 ? 3 : u >= 0xE0 ? 2 : u >= 0xC0 ? 1 : 0;
+    if(more) u &= 0x3F >> more;
+    for(; more && p < end; more--) u = u << 6 | (*p++ & 63);
+    w += (wchar_t) u;
+  }
+  if(n < 0) w.push_back(0);
+  return w;
+}
+inline int WideCharToMultiByte(UINT, DWORD, LPCWSTR w, int n, LPSTR out, int cap, LPCSTR, BOOL*){
+  auto s = posixU8(w, n); if(cap == 0) return (int) s.size();
+  if((int) s.size() > cap) return 0;
+  memcpy(out, s.data(), s.size()); return (int) s.size();
+}
+inline int MultiByteToWideChar(UINT, DWORD, LPCSTR c, int n, LPWSTR out, int cap){
+  auto w = posixWide(c, n); if(cap == 0) return (int) w.size();
+  if((int) w.size() > cap) return 0;
+  wmemcpy(out, w.data(), w.size()); return (int) w.size();
+}
+
+// As on Windows : the length without the terminator, or the size needed (with it) when buf is too small
+inline DWORD GetEnvironmentVariableW(LPCWSTR name, LPWSTR buf, DWORD cap){
+  const char *v = getenv(posixU8(name, -1).c_str()); if(!v){ errno = ERROR_ENVVAR_NOT_FOUND; return 0; }
+  auto w = posixWide(v, -1); if(w.size() > cap) return (DWORD) w.size();
+  wmemcpy(buf, w.data(), w.size()); return (DWORD)(w.size() - 1);
+}
+
+// Ctrl+C : SIGINT and SIGTERM, to the one handler
+typedef BOOL (WINAPI *PHANDLER_ROUTINE)(DWORD);
+inline PHANDLER_ROUTINE posixCtrl = nullptr;
+inline BOOL SetConsoleCtrlHandler(PHANDLER_ROUTINE h, BOOL add){
+  posixCtrl = add ? h : nullptr;
+  auto on = [](int){ if(posixCtrl) posixCtrl(0); };
+  signal(SIGINT, on); signal(SIGTERM, on); return TRUE;
+}
+inline void Sleep(DWORD ms){ usleep((useconds_t) ms * 1000); }
+
+inline int lstrlenW(LPCWSTR s){ return s ? (int) wcslen(s) : 0; }
+inline int lstrcmpW(LPCWSTR a, LPCWSTR b){ return wcscmp(a, b); }
+inline int lstrcmpiW(LPCWSTR a, LPCWSTR b){ return wcscasecmp(a, b); }
+// Digits compared as numbers : "a2" before "a10"
+inline int StrCmpLogicalW(LPCWSTR a, LPCWSTR b){
+  while(*a && *b){
+    if(iswdigit(*a) && iswdigit(*b)){
+      while(*a == L'0') a++;
+      while(*b == L'0') b++;
+      size_t na = 0, nb = 0; while(iswdigit(a[na])) na++; while(iswdigit(b[nb])) nb++;
+      if(na != nb) return na < nb ? -1 : 1;
+      if(int c = wcsncmp(a, b, na)) return c < 0 ? -1 : 1;
+      a += na; b += nb; continue;
+    }
+    wint_t x = towlower(*a), y = towlower(*b); if(x != y) return x < y ? -1 : 1;
+    a++; b++;
+  }
+  return *a ? 1 : *b ? -1 : 0;
+}
+
+inline HRESULT StringCchCatA(LPSTR dst, size_t cch, LPCSTR src){
+  size_t n = strlen(dst), m = strlen(src); if(n + m >= cch) return STRSAFE_E_INSUFFICIENT_BUFFER;
+  memcpy(dst + n, src, m + 1); return 0;
+}
+inline HRESULT StringCchCatW(LPWSTR dst, size_t cch, LPCWSTR src){
+  size_t n = wcslen(dst), m = wcslen(src); if(n + m >= cch) return STRSAFE_E_INSUFFICIENT_BUFFER;
+  wmemcpy(dst + n, src, m + 1); return 0;
+}
+inline HRESULT StringCchCopyW(LPWSTR dst, size_t cch, LPCWSTR src){
+  if(cch == 0 || cch > STRSAFE_MAX_CCH) return STRSAFE_E_INVALID_PARAMETER;
+  size_t m = wcslen(src); if(m >= cch){ wmemcpy(dst, src, cch - 1); dst[cch - 1] = 0; return STRSAFE_E_INSUFFICIENT_BUFFER; }
+  wmemcpy(dst, src, m + 1); return 0;
+}
+#define _snprintf snprintf
@@ -0,0 +1,74 @@
+// procinfo.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Process metadata cache : image path, name and command line of the processes owning taskbar windows, keyed by PID and
+// checked against the process start time (a PID reused is another process : queried again). Within a run, a process is
+// checked once : a window then costs the lookup of its PID only. Kept across runs in a file : when saved, entries not
+// seen for a week are dropped, and past the 1024 seen last. The command line stays in memory : it is not written.
+//
+// File : "MVPC" then, per process, numbers as LEB128 varints, strings as length + UTF-16 code units :
+//   pid start seen path cmdLine      start : FILETIME, seen : ms since the epoch, cmdLine : empty (skipped when read)
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+using namespace std;
+
+struct procInfo{
+  uint64_t start = 0, seen = 0;  // start 0 : not known (gone, or not allowed)
+  wstring path, name, cmdLine;   // name : of the image, path's last part
+  uint32_t run = 0;              // last checked in
+};
+
+class procCache{
+  unordered_map<uint32_t, procInfo> procs;
+  uint32_t run = 1;
+  static constexpr uint64_t keepMs = 7ull*24*3600*1000; static constexpr size_t keepMax = 1024;
+
+public:
+  bool dirty = false;
+  size_t hits = 0, queries = 0;  // this run's
+
+  void newRun(){ run++; }  // checked again from now on (another enumeration, by a resident process)
+
+  // Process pid : startOf(pid) gives its start time, query(pid, info) its path and command line, when not cached
+  template <typename S, typename Q>
+  const procInfo& get(uint32_t pid, S startOf, Q query){
+    procInfo &p = procs[pid]; if(p.run == run) return p;
+    uint64_t start = startOf(pid);
+    if(!start || p.start != start || p.path.empty()){
+      p = {}; p.start = start; query(pid, p);
+      p.name = p.path.substr(p.path.find_last_of(L"\\/") + 1); queries++;
+    }
+    else hits++;
+    p.run = run; p.seen = snapNow(); dirty = true;
+    return p;
+  }
+
+  bool load(const filesystem::path &f){
+    string s; if(!undoReadAll(f, s) || s.compare(0, 4, "MVPC")) return false;
+    size_t at = 4; uint64_t pid; wstring cmdLine;
+    while(at < s.size()){
+      procInfo p; p.run = 0;
+      if(!undoGet(s, at, pid) || !undoGet(s, at, p.start) || !undoGet(s, at, p.seen) || !traceGetStr(s, at, p.path) || !traceGetStr(s, at, cmdLine))
+        { procs.clear(); return false; }
+      p.name = p.path.substr(p.path.find_last_of(L"\\/") + 1);
+      procs[(uint32_t) pid] = move(p);
+    }
+    return true;
+  }
+  bool save(const filesystem::path &f){
+    uint64_t now = snapNow(); vector<pair<uint32_t, const procInfo*>> kept;
+    for(auto &[pid, p] : procs) if(p.start && !p.path.empty() && p.seen + keepMs > now) kept.emplace_back(pid, &p);
+    sort(kept.begin(), kept.end(), [](auto &a, auto &b){ return a.second->seen > b.second->seen; });
+    if(kept.size() > keepMax) kept.resize(keepMax);
+    string s = "MVPC";
+    for(auto [pid, p] : kept){ undoPut(s, pid); undoPut(s, p->start); undoPut(s, p->seen); tracePutStr(s, p->path); tracePutStr(s, L""); }
+    error_code ec; filesystem::create_directories(f.parent_path(), ec);
+    FILE *fp = undoOpen(f, "wb"); if(!fp) return false;
+    bool ok = fwrite(s.data(), 1, s.size(), fp) == s.size();
+    dirty = false; return fclose(fp)==0 && ok;
+  }
+};
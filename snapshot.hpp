@@ -0,0 +1,227 @@
+// snapshot.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Taskbar snapshot (groups, buttons) published in shared memory by the last session, or a resident process,
+// for listings and shell completion without loading TTLib.
+//
+// One segment per taskbar. Windows : file mapping of %LOCALAPPDATA%\mv_tb_btn\snapshot<tb>.bin (outlives its
+// publisher). Elsewhere (tests) : POSIX shared memory /mv_tb_btn.snapshot.<uid>.<tb>.
+// Readers take no lock (seqlock) : the generation is odd while a publisher writes, readers copy the data out and
+// retry if the generation moved meanwhile.
+//
+// Layout : snapHeader, then per group : u64 hash, u32 AppId length, u32 button count, AppId (UTF-16),
+//          then per button : u64 HWND, u32 title length, title (UTF-16)
+//
+// Each group carries a hash of its AppId, button HWNDs and titles, the taskbar one of its groups' hashes, in order :
+// snapDiff() compares hashes first, and only looks into the groups that differ. Groups and buttons are matched through
+// hash maps : linear in the size of the taskbar.
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <filesystem>
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+using namespace std;
+
+struct snapButton{ uint64_t hwnd = 0; wstring title; };
+struct snapGroup{ wstring appId; vector<snapButton> buttons; uint64_t hash = 0; };
+struct snapshot{ uint64_t gen = 0, time = 0, hash = 0; uint32_t tb = 0; vector<snapGroup> groups; };
+
+struct snapHeader{ uint32_t magic, version, gen, bytes; uint64_t time, hash; uint32_t tb, nGroups; };
+static const uint32_t snapMagic = 0x706E5354, snapVersion = 2;
+static const size_t snapSegSize = 2 << 20;
+
+inline uint64_t snapNow(){
+  return (uint64_t) chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// FNV-1a, 64 bits
+inline uint64_t snapHashBytes(uint64_t h, const void *p, size_t n){
+  for(size_t i = 0; i < n; i++) h = (h ^ ((const unsigned char *) p)[i]) * 0x100000001B3ull;
+  return h;
+}
+inline uint64_t snapHashStr(uint64_t h, const wstring &str){
+  for(wchar_t c : str){ uint16_t u = (uint16_t) c; h = snapHashBytes(h, &u, 2); }
+  return snapHashBytes(h, "", 1);  // terminator : "ab"+"c" != "a"+"bc"
+}
+inline uint64_t snapHashButton(const snapButton &b){ return snapHashStr(snapHashBytes(0xCBF29CE484222325ull, &b.hwnd, 8), b.title); }
+inline void snapRehash(snapshot &s){
+  s.hash = 0xCBF29CE484222325ull;
+  for(auto &g : s.groups){
+    g.hash = snapHashStr(0xCBF29CE484222325ull, g.appId);
+    for(auto &b : g.buttons){ uint64_t bh = snapHashButton(b); g.hash = snapHashBytes(g.hash, &bh, 8); }
+    s.hash = snapHashBytes(s.hash, &g.hash, 8);
+  }
+}
+
+// Changes from one snapshot to another. Positions 0-based (from : in the old one, to : in the new one), -1 if none.
+// Reordered : only the groups/buttons that moved relative to the others (outside a longest run kept in order).
+struct snapChange{
+  enum kind_t{ groupAdded, groupRemoved, groupMoved, buttonAdded, buttonRemoved, buttonMoved, buttonRetitled } kind;
+  wstring appId; uint64_t hwnd = 0; int from = -1, to = -1; wstring title;
+};
+
+// Indices of seq (a longest increasing run) left in place
+inline vector<bool> snapInPlace(const vector<int> &seq){
+  size_t n = seq.size(); vector<int> tails, tailIdx, prev(n, -1); vector<bool> keep(n, false);
+  for(size_t i = 0; i < n; i++){
+    size_t k = lower_bound(tails.begin(), tails.end(), seq[i]) - tails.begin();
+    if(k == tails.size()){ tails.push_back(seq[i]); tailIdx.push_back((int) i); } else{ tails[k] = seq[i]; tailIdx[k] = (int) i; }
+    prev[i] = k ? tailIdx[k-1] : -1;
+  }
+  for(int i = tailIdx.empty() ? -1 : tailIdx.back(); i >= 0; i = prev[i]) keep[i] = true;
+  return keep;
+}
+
+inline vector<snapChange> snapDiff(const snapshot &a, const snapshot &b){
+  vector<snapChange> cs; if(a.hash == b.hash) return cs;
+  // Groups matched by AppId, then by order among same AppIds : (AppId, n) is b's group byId[AppId][n]
+  unordered_map<wstring, vector<int>> byId; for(size_t j = 0; j < b.groups.size(); j++) byId[b.groups[j].appId].push_back((int) j);
+  unordered_map<wstring, size_t> nth;
+  vector<int> inB(a.groups.size(), -1);  // a's group i is b's group inB[i]
+  for(size_t i = 0; i < a.groups.size(); i++){
+    size_t n = nth[a.groups[i].appId]++; auto it = byId.find(a.groups[i].appId);
+    if(it != byId.end() && n < it->second.size()) inB[i] = it->second[n];
+  }
+  vector<bool> matched(b.groups.size(), false);
+  for(size_t i = 0; i < inB.size(); i++)
+    if(inB[i] < 0) cs.push_back({ snapChange::groupRemoved, a.groups[i].appId, 0, (int) i, -1, {} });
+    else matched[inB[i]] = true;
+  for(size_t j = 0; j < matched.size(); j++) if(!matched[j]) cs.push_back({ snapChange::groupAdded, b.groups[j].appId, 0, -1, (int) j, {} });
+
+  vector<int> seq, idx; for(size_t i = 0; i < inB.size(); i++) if(inB[i] >= 0){ seq.push_back(inB[i]); idx.push_back((int) i); }
+  auto keep = snapInPlace(seq);
+  for(size_t k = 0; k < seq.size(); k++) if(!keep[k]) cs.push_back({ snapChange::groupMoved, a.groups[idx[k]].appId, 0, idx[k], seq[k], {} });
+
+  // Into the groups that differ : buttons matched by HWND
+  for(size_t k = 0; k < seq.size(); k++){
+    const snapGroup &ga = a.groups[idx[k]], &gb = b.groups[seq[k]];
+    if(ga.hash == gb.hash) continue;
+    unordered_map<uint64_t, vector<int>> byHwnd; unordered_map<uint64_t, size_t> nthH;  // as groups : (HWND, n)
+    for(size_t j = 0; j < gb.buttons.size(); j++) byHwnd[gb.buttons[j].hwnd].push_back((int) j);
+    vector<int> bIn(ga.buttons.size(), -1); vector<bool> bMatched(gb.buttons.size(), false);
+    for(size_t i = 0; i < ga.buttons.size(); i++){
+      size_t n = nthH[ga.buttons[i].hwnd]++; auto it = byHwnd.find(ga.buttons[i].hwnd);
+      if(it != byHwnd.end() && n < it->second.size()){ bIn[i] = it->second[n]; bMatched[bIn[i]] = true; }
+    }
+    vector<int> bseq, bidx;
+    for(size_t i = 0; i < bIn.size(); i++){
+      const snapButton &ba = ga.buttons[i];
+      if(bIn[i] < 0){ cs.push_back({ snapChange::buttonRemoved, ga.appId, ba.hwnd, (int) i, -1, ba.title }); continue; }
+      bseq.push_back(bIn[i]); bidx.push_back((int) i);
+      if(ba.title != gb.buttons[bIn[i]].title) cs.push_back({ snapChange::buttonRetitled, ga.appId, ba.hwnd, (int) i, bIn[i], gb.buttons[bIn[i]].title });
+    }
+    for(size_t j = 0; j < bMatched.size(); j++)
+      if(!bMatched[j]) cs.push_back({ snapChange::buttonAdded, gb.appId, gb.buttons[j].hwnd, -1, (int) j, gb.buttons[j].title });
+    auto bkeep = snapInPlace(bseq);
+    for(size_t m = 0; m < bseq.size(); m++)
+      if(!bkeep[m]) cs.push_back({ snapChange::buttonMoved, ga.appId, ga.buttons[bidx[m]].hwnd, bidx[m], bseq[m], gb.buttons[bseq[m]].title });
+  }
+  return cs;
+}
+
+class snapSegment{
+  char *base = nullptr;
+#ifdef _WIN32
+  HANDLE hFile = INVALID_HANDLE_VALUE, hMap = nullptr;
+#endif
+
+  snapHeader* hdr(){ return (snapHeader *) base; }
+  atomic_ref<uint32_t> gen(){ return atomic_ref<uint32_t>(hdr()->gen); }
+
+public:
+  // Maps the segment of taskbar tb (creating it if create), false if there is none
+  bool open(uint32_t tb, const filesystem::path &dir, bool create){
+#ifdef _WIN32
+    error_code ec; if(create) filesystem::create_directories(dir, ec);
+    auto file = dir / (L"snapshot" + to_wstring(tb) + L".bin");
+    hFile = CreateFileW(file.c_str(), GENERIC_READ | (create ? GENERIC_WRITE : 0), FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      nullptr, create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(hFile==INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz; if(!create && (!GetFileSizeEx(hFile, &sz) || (size_t) sz.QuadPart < snapSegSize)) return false;  // a header, and h.bytes to read
+    hMap = CreateFileMappingW(hFile, nullptr, create ? PAGE_READWRITE : PAGE_READONLY, 0, create ? (DWORD) snapSegSize : 0, nullptr);
+    if(!hMap) return false;
+    base = (char *) MapViewOfFile(hMap, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+#else
+    // Shared memory, named after the directory (the scope of the files, as on Windows)
+    string name = "/mv_tb_btn.snapshot." + to_string(getuid()) + "." + to_string(hash<string>{}(dir.string()) & 0xffffffff) + "." + to_string(tb);
+    int fd = shm_open(name.c_str(), create ? O_RDWR | O_CREAT : O_RDONLY, 0600); if(fd < 0) return false;
+    struct stat st{}; fstat(fd, &st);
+    if(create && (size_t) st.st_size < snapSegSize && 0 != ftruncate(fd, snapSegSize)){ close(fd); return false; }
+    if(!create && (size_t) st.st_size < snapSegSize){ close(fd); return false; }
+    void *p = mmap(nullptr, snapSegSize, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0); close(fd);
+    base = p==MAP_FAILED ? nullptr : (char *) p;
+#endif
+    return base != nullptr;
+  }
+  ~snapSegment(){
+#ifdef _WIN32
+    if(base) UnmapViewOfFile(base);
+    if(hMap) CloseHandle(hMap);
+    if(hFile!=INVALID_HANDLE_VALUE) CloseHandle(hFile);
+#else
+    if(base) munmap(base, snapSegSize);
+#endif
+  }
+
+  bool publish(snapshot s){
+    snapRehash(s); string data;
+    auto put32 = [&data](uint32_t v){ data.append((const char *) &v, 4); };
+    auto putStr = [&data](const wstring &str){ for(wchar_t c : str){ uint16_t u = (uint16_t) c; data.append((const char *) &u, 2); } };
+    for(auto &g : s.groups){
+      data.append((const char *) &g.hash, 8); put32((uint32_t) g.appId.size()); put32((uint32_t) g.buttons.size()); putStr(g.appId);
+      for(auto &b : g.buttons){ data.append((const char *) &b.hwnd, 8); put32((uint32_t) b.title.size()); putStr(b.title); }
+    }
+    if(!base || sizeof(snapHeader) + data.size() > snapSegSize) return false;
+
+    uint32_t g0 = gen().load(memory_order_relaxed) | 1;
+    gen().store(g0, memory_order_relaxed); atomic_thread_fence(memory_order_release);  // odd : being written
+    snapHeader *h = hdr(); h->magic = snapMagic; h->version = snapVersion; h->bytes = (uint32_t) data.size();
+    h->time = s.time ? s.time : snapNow(); h->hash = s.hash; h->tb = s.tb; h->nGroups = (uint32_t) s.groups.size();
+    memcpy(base + sizeof(snapHeader), data.data(), data.size());
+    gen().store(g0 + 1, memory_order_release);
+    return true;
+  }
+
+  // Consistent copy of the last publication, false if none (or a publisher keeps it busy)
+  bool read(snapshot &s){
+    if(!base) return false;
+    string data; snapHeader h;
+    for(int tries = 0; ; tries++){
+      if(tries==1000) return false;
+      uint32_t g1 = gen().load(memory_order_acquire);
+      if(g1 & 1){ this_thread::yield(); continue; }
+      memcpy(&h, base, sizeof(h));
+      if(h.magic != snapMagic || h.version != snapVersion) return false;
+      if(h.bytes <= snapSegSize - sizeof(snapHeader)) data.assign(base + sizeof(snapHeader), h.bytes);
+      atomic_thread_fence(memory_order_acquire);
+      if(g1 == gen().load(memory_order_relaxed) && h.bytes <= snapSegSize - sizeof(snapHeader)) break;
+    }
+    s = {}; s.gen = h.gen/2; s.time = h.time; s.hash = h.hash; s.tb = h.tb;
+    size_t at = 0; uint32_t n, m;
+    auto get32 = [&](uint32_t &v){ if(at+4 > data.size()) return false; memcpy(&v, data.data()+at, 4); at += 4; return true; };
+    auto getStr = [&](wstring &str, uint32_t len){ if(at + (size_t) len*2 > data.size()) return false;
+      str.resize(len); for(auto &c : str){ uint16_t u; memcpy(&u, data.data()+at, 2); c = (wchar_t) u; at += 2; } return true; };
+    for(uint32_t i = 0; i < h.nGroups; i++){
+      snapGroup g; if(at+8 > data.size()) return false; memcpy(&g.hash, data.data()+at, 8); at += 8;
+      if(!get32(n) || !get32(m) || !getStr(g.appId, n)) return false;
+      if(m > (data.size() - at) / 12) return false;  // a button : 12 bytes at least
+      g.buttons.resize(m);
+      for(auto &b : g.buttons){ if(at+8 > data.size()) return false; memcpy(&b.hwnd, data.data()+at, 8); at += 8;
+        if(!get32(n) || !getStr(b.title, n)) return false; }
+      s.groups.push_back(move(g));
+    }
+    return true;
+  }
+};
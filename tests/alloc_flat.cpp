@@ -0,0 +1,42 @@
+// alloc_flat.cpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Memory stays flat over many simulated operations in one process (mv_tb_btn.cpp with MVBTN_NO_MAIN, MVBTN_ALLOCSTATS,
+// MVBTN_TTSIM) : live heap bytes after a warm-up, then after all of them, must be within a few KB.
+// Moves, swaps, a button by label, a list, a bad option : their paths all run, each an invocation of its own.
+//   alloc_flat [operations=100000]    rc 0 : flat
+
+#define MVBTN_NO_MAIN
+#define MVBTN_ALLOCSTATS
+#include "../mv_tb_btn.cpp"
+
+int main(int argc, char **argv){
+  long n = argc > 1 ? atol(argv[1]) : 100000, warm = n / 10 ? n / 10 : 1;
+  auto dir = filesystem::temp_directory_path() / ("mvbtn_alloc_" + to_string(getpid()));
+  filesystem::create_directories(dir);
+  setenv("MVBTN_COALESCE_MS", "0", 1);  // alone : no window to wait for other invocations
+  vector<vector<const char*>> ops = {
+    { "mv_tb_btn", "-g", "Notepad", "-f", "1", "-t", "3", "--json" },
+    { "mv_tb_btn", "-g", "Notepad", "-f", "4", "-t", "2", "-s", "--json", "--stats" },
+    { "mv_tb_btn", "-g", "Notepad", "-b", "b.txt", "-t", "end", "--json" },
+    { "mv_tb_btn", "--list", "--json" },
+    { "mv_tb_btn", "-g", "Notepad", "--json" },
+  };
+
+  unsigned long long liveWarm = 0; long failed = 0;
+  for(long i = 0; i < n; i++){
+    if(i == warm) liveWarm = allocStats::live;
+    auto &av = ops[i % ops.size()];
+    invocation iv; iv.dir = dir; iv.scope = "alloc." + to_string(getpid()); iv.out.capture = true;
+    iv.tt->sim.spec = "Notepad=a.txt,b.txt,c.txt,d.txt;7-Zip=archive.7z";
+    int rc; { invBind in(iv); rc = mvInvoke((int) av.size(), av.data()); }
+    if(i % ops.size() != 4 && rc != 0){ if(!failed++) fprintf(stderr, "operation %ld : rc %d\n%s", i, rc, iv.out.outText.c_str()); }
+  }
+  unsigned long long liveEnd = allocStats::live;
+
+  error_code ec; filesystem::remove_all(dir, ec);
+  long long grown = (long long) liveEnd - (long long) liveWarm;
+  printf("%ld operations : live heap %llu bytes after %ld, %llu bytes after all (%+lld), peak %llu, %ld failed\n",
+    n, liveWarm, warm, liveEnd, grown, allocStats::peak.load(), failed);
+  return failed || grown > 16384 ? 1 : 0;
+}
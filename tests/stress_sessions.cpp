@@ -0,0 +1,44 @@
+// stress_sessions.cpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Many simulated invocations at once, in one process (mv_tb_btn.cpp with MVBTN_NO_MAIN, MVBTN_TTSIM) : each on a
+// thread of its own, with its own data directory, session scope, taskbars and output (captured). Each moves a button of
+// its own group, a few rounds : its record must show its own group and button only, its undo log in its own directory.
+//   stress_sessions [threads=32] [rounds=8]    rc 0 : all as expected
+
+#define MVBTN_NO_MAIN
+#include "../mv_tb_btn.cpp"
+
+int main(int argc, char **argv){
+  int n = argc > 1 ? atoi(argv[1]) : 32, rounds = argc > 2 ? atoi(argv[2]) : 8;
+  auto base = filesystem::temp_directory_path() / ("mvbtn_stress_" + to_string(getpid()));
+  atomic<int> bad{ 0 };
+
+  auto session = [&](int i){
+    string g = "G" + to_string(i), t = "t" + to_string(i) + "_";
+    for(int r = 0; r < rounds; r++){
+      invocation iv; iv.dir = base / g; iv.scope = g + "." + to_string(getpid()); iv.out.capture = true;
+      iv.tt->sim.spec = g + "=" + t + "1," + t + "2," + t + "3;Other=o1,o2";
+      filesystem::create_directories(iv.dir);
+      string from = to_string(r % 3 + 1);
+      const char *av[] = { "mv_tb_btn", "-g", g.c_str(), "-f", from.c_str(), "-t", "end", "--json" };
+      int rc; { invBind in(iv); rc = mvInvoke(8, av); }
+
+      string &o = iv.out.outText, want = "\"appId\":\"" + g + "\",\"hwnd\":";
+      size_t ids = 0; for(size_t at = 0; (at = o.find("\"appId\"", at)) != string::npos; at++) ids++;
+      bool ok = rc == 0 && o.find("\"result\":\"ok\"") != string::npos && o.find("\"group\":\"" + g + "\"") != string::npos
+        && (r % 3 == 2 || (ids == 1 && o.find(want) != string::npos && o.find("\"title\":\"" + t + from + "\"") != string::npos))
+        && iv.out.errText.empty();
+      if(!ok){ bad++; fprintf(stderr, "session %d round %d : rc %d\n%s%s\n", i, r, rc, o.c_str(), iv.out.errText.c_str()); }
+    }
+    error_code ec;
+    if(!filesystem::exists(base / g / "undo.log", ec)){ bad++; fprintf(stderr, "session %d : no undo log\n", i); }
+  };
+
+  vector<thread> ts; for(int i = 0; i < n; i++) ts.emplace_back(session, i);
+  for(auto &t : ts) t.join();
+
+  error_code ec; filesystem::remove_all(base, ec);
+  printf("%d sessions x %d rounds : %d failed\n", n, rounds, bad.load());
+  return bad ? 1 : 0;
+}
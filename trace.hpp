@@ -0,0 +1,170 @@
+// trace.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Session trace (--record-trace) : the operation, the taskbar as first enumerated, and every backend call made, with its
+// arguments, result and latency. A build on ttsim.hpp replays it (--replay-trace) : same operation, same taskbar, each
+// call taking the time it took then, to compare planners and executors on real-world workloads, on any machine.
+//
+// File : "MVTR" then records, numbers as LEB128 varints, strings as length + UTF-16 code units :
+//   'O' len bytes                                  the operation (opPack())
+//   'T' tb nGroups (appId nButtons (hwnd title)..)..  a taskbar, as enumerated
+//   'F' name                                       backend function, numbered from 0 in order of appearance
+//   'C' fn us nArgs (value)..  result              call, us : latency (µs)
+//   'E' rc ms                                      end of the run
+// A value : tag ('i' number, 'h' handle, 'o' output number, 's' string) then the number, or the string.
+// Every TTLib call goes through traceCall() (macros at the end), a no-op unless recording.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <type_traits>
+#include <cwchar>
+
+using namespace std;
+
+struct traceVal{ char tag = 'i'; uint64_t n = 0; wstring s; };
+struct traceCallRec{ string fn; uint64_t us = 0; vector<traceVal> args; traceVal result; };
+struct traceData{ string op; vector<snapshot> tbs; vector<traceCallRec> calls; uint64_t rc = 0, ms = 0; };
+
+static const char traceMagic[] = "MVTR";
+
+inline void tracePutStr(string &s, const wstring &str){ undoPut(s, str.size()); for(WCHAR c : str) undoPut(s, (uint16_t) c); }
+inline bool traceGetStr(const string &s, size_t &at, wstring &str){
+  uint64_t n, c; if(!undoGet(s, at, n) || n > s.size() - at) return false;  // a byte a code unit at least
+  str.clear(); while(n--){ if(!undoGet(s, at, c)) return false; str += (WCHAR) c; }
+  return true;
+}
+inline void tracePutVal(string &s, const traceVal &v){ s += v.tag; if(v.tag=='s') tracePutStr(s, v.s); else undoPut(s, v.n); }
+inline bool traceGetVal(const string &s, size_t &at, traceVal &v){
+  if(at >= s.size()){ return false; }
+  v = {}; v.tag = s[at++];
+  return v.tag=='s' ? traceGetStr(s, at, v.s) : undoGet(s, at, v.n);
+}
+
+inline bool traceWrite(const filesystem::path &p, const traceData &t){
+  string s = traceMagic; map<string, uint64_t> fns;
+  s += 'O'; undoPut(s, t.op.size()); s += t.op;
+  for(auto &tb : t.tbs){
+    s += 'T'; undoPut(s, tb.tb); undoPut(s, tb.groups.size());
+    for(auto &g : tb.groups){
+      tracePutStr(s, g.appId); undoPut(s, g.buttons.size());
+      for(auto &b : g.buttons){ undoPut(s, b.hwnd); tracePutStr(s, b.title); }
+    }
+  }
+  for(auto &c : t.calls){
+    auto [it, added] = fns.emplace(c.fn, fns.size());
+    if(added){ s += 'F'; tracePutStr(s, wstring(c.fn.begin(), c.fn.end())); }
+    s += 'C'; undoPut(s, it->second); undoPut(s, c.us); undoPut(s, c.args.size());
+    for(auto &a : c.args) tracePutVal(s, a);
+    tracePutVal(s, c.result);
+  }
+  s += 'E'; undoPut(s, t.rc); undoPut(s, t.ms);
+  FILE *f = undoOpen(p, "wb"); if(!f) return false;
+  bool ok = fwrite(s.data(), 1, s.size(), f) == s.size();
+  return fclose(f)==0 && ok;
+}
+
+inline bool traceRead(const filesystem::path &p, traceData &t){
+  string s; if(!undoReadAll(p, s) || s.compare(0, 4, traceMagic)) return false;
+  t = {}; vector<string> fns; size_t at = 4; uint64_t a, b, n;
+  while(at < s.size()){
+    char kind = s[at++];
+    if(kind=='O'){ if(!undoGet(s, at, a) || at + a > s.size()) return false; t.op = s.substr(at, a); at += a; }
+    else if(kind=='T'){
+      snapshot tb; if(!undoGet(s, at, a) || !undoGet(s, at, n)) return false; tb.tb = (uint32_t) a;
+      while(n--){
+        snapGroup g; if(!traceGetStr(s, at, g.appId) || !undoGet(s, at, b)) return false;
+        while(b--){ snapButton bt; if(!undoGet(s, at, bt.hwnd) || !traceGetStr(s, at, bt.title)) return false; g.buttons.push_back(move(bt)); }
+        tb.groups.push_back(move(g));
+      }
+      t.tbs.push_back(move(tb));
+    }
+    else if(kind=='F'){ wstring name; if(!traceGetStr(s, at, name)) return false; fns.emplace_back(name.begin(), name.end()); }
+    else if(kind=='C'){
+      traceCallRec c; if(!undoGet(s, at, a) || a >= fns.size() || !undoGet(s, at, c.us) || !undoGet(s, at, n)) return false;
+      if(n > (s.size() - at) / 2) return false;  // an argument : tag and value, 2 bytes at least
+      c.fn = fns[a]; c.args.resize(n);
+      for(auto &v : c.args) if(!traceGetVal(s, at, v)) return false;
+      if(!traceGetVal(s, at, c.result)) return false;
+      t.calls.push_back(move(c));
+    }
+    else if(kind=='E'){ if(!undoGet(s, at, t.rc) || !undoGet(s, at, t.ms)) return false; }
+    else return false;
+  }
+  return true;
+}
+
+// First call where b parts from a (function, numbers, strings : handles differ from one run to the other), -1 if none
+inline long long traceDiverge(const traceData &a, const traceData &b){
+  auto same = [](const traceVal &x, const traceVal &y){ return x.tag==y.tag && (x.tag=='h' || (x.n==y.n && x.s==y.s)); };
+  size_t n = min(a.calls.size(), b.calls.size());
+  for(size_t i = 0; i < n; i++){
+    auto &x = a.calls[i], &y = b.calls[i];
+    bool eq = x.fn==y.fn && x.args.size()==y.args.size() && same(x.result, y.result);
+    for(size_t j = 0; eq && j < x.args.size(); j++) eq = same(x.args[j], y.args[j]);
+    if(!eq) return (long long) i;
+  }
+  return a.calls.size()==b.calls.size() ? -1 : (long long) n;
+}
+
+// A run's recording. The one calls go to : tracerAt, set for the threads working for the run.
+struct traceState{
+  bool on = false; traceData data; mutex mx; chrono::steady_clock::time_point t0;
+  void begin(const string &op){ lock_guard<mutex> lk(mx); on = true; data = {}; data.op = op; t0 = chrono::steady_clock::now(); }
+  void taskbar(const snapshot &s){
+    lock_guard<mutex> lk(mx); if(!on) return;
+    for(auto &tb : data.tbs) if(tb.tb == s.tb) return;  // as first enumerated
+    data.tbs.push_back(s);
+  }
+  bool end(const filesystem::path &p, int rc){
+    lock_guard<mutex> lk(mx); if(!on) return true; on = false;
+    data.rc = (uint64_t) rc; data.ms = (uint64_t) chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t0).count();
+    return p.empty() || traceWrite(p, data);
+  }
+};
+inline traceState tracerProcess;
+inline thread_local traceState *tracerAt = &tracerProcess;
+
+// Arguments, read after the call : pointers to numbers are outputs, strings are read up to MAX_APPID_LENGTH
+template <typename T>
+inline traceVal traceArg(T a){
+  if constexpr(is_pointer_v<T>){
+    using P = remove_cv_t<remove_pointer_t<T>>;
+    if(!a) return { 'h', 0, {} };
+    if constexpr(is_same_v<P, WCHAR>) return { 's', 0, wstring(a, wcsnlen(a, MAX_APPID_LENGTH)) };
+    else if constexpr(is_integral_v<P> || is_enum_v<P>) return { 'o', (uint64_t) *a, {} };
+    else return { 'h', (uint64_t) (uintptr_t) a, {} };
+  }
+  else return { 'i', (uint64_t) a, {} };
+}
+
+template <typename F, typename ... A>
+inline auto traceCall(const char *fn, F f, A ... a){
+  traceState &tracer = *tracerAt; if(!tracer.on) return f(a...);
+  auto t = chrono::steady_clock::now(); auto r = f(a...);
+  traceCallRec c{ fn, (uint64_t) chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t).count(), { traceArg(a)... }, traceArg(r) };
+  lock_guard<mutex> lk(tracer.mx); if(tracer.on) tracer.data.calls.push_back(move(c));
+  return r;
+}
+
+#define TTLib_Init()                        traceCall("Init", ::TTLib_Init)
+#define TTLib_Uninit()                      traceCall("Uninit", ::TTLib_Uninit)
+#define TTLib_LoadIntoExplorer()            traceCall("LoadIntoExplorer", ::TTLib_LoadIntoExplorer)
+#define TTLib_UnloadFromExplorer()          traceCall("UnloadFromExplorer", ::TTLib_UnloadFromExplorer)
+#define TTLib_ManipulationStart()           traceCall("ManipulationStart", ::TTLib_ManipulationStart)
+#define TTLib_ManipulationEnd()             traceCall("ManipulationEnd", ::TTLib_ManipulationEnd)
+#define TTLib_GetMainTaskbar()              traceCall("GetMainTaskbar", ::TTLib_GetMainTaskbar)
+#define TTLib_GetSecondaryTaskbarCount(...) traceCall("GetSecondaryTaskbarCount", ::TTLib_GetSecondaryTaskbarCount, __VA_ARGS__)
+#define TTLib_GetSecondaryTaskbar(...)      traceCall("GetSecondaryTaskbar", ::TTLib_GetSecondaryTaskbar, __VA_ARGS__)
+#define TTLib_GetButtonGroupCount(...)      traceCall("GetButtonGroupCount", ::TTLib_GetButtonGroupCount, __VA_ARGS__)
+#define TTLib_GetButtonGroup(...)           traceCall("GetButtonGroup", ::TTLib_GetButtonGroup, __VA_ARGS__)
+#define TTLib_GetActiveButtonGroup(...)     traceCall("GetActiveButtonGroup", ::TTLib_GetActiveButtonGroup, __VA_ARGS__)
+#define TTLib_GetButtonGroupType(...)       traceCall("GetButtonGroupType", ::TTLib_GetButtonGroupType, __VA_ARGS__)
+#define TTLib_GetButtonGroupAppId(...)      traceCall("GetButtonGroupAppId", ::TTLib_GetButtonGroupAppId, __VA_ARGS__)
+#define TTLib_GetButtonCount(...)           traceCall("GetButtonCount", ::TTLib_GetButtonCount, __VA_ARGS__)
+#define TTLib_GetButton(...)                traceCall("GetButton", ::TTLib_GetButton, __VA_ARGS__)
+#define TTLib_GetButtonWindow(...)          traceCall("GetButtonWindow", ::TTLib_GetButtonWindow, __VA_ARGS__)
+#define TTLib_ButtonMoveInButtonGroup(...)  traceCall("ButtonMoveInButtonGroup", ::TTLib_ButtonMoveInButtonGroup, __VA_ARGS__)
+#define TTLib_ButtonGroupMove(...)          traceCall("ButtonGroupMove", ::TTLib_ButtonGroupMove, __VA_ARGS__)
@@ -0,0 +1,235 @@
+// ttsim.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Simulated TTLib : taskbars in memory, no Explorer. Build with MVBTN_TTSIM defined (instead of linking TTLib) to try
+// timeouts, traces and the like on any machine.
+//
+// Env. var. MVBTN_SIM_TASKBAR : taskbars separated by |, groups by ; as AppId=button titles separated by ,
+//   "Notepad=a.txt,b.txt;Explorer=Docs,Downloads|Notepad=c.txt" : 2 groups in the primary taskbar, 1 secondary taskbar.
+// Env. var. MVBTN_SIM_STALL : calls that stall, call=ms[@n] separated by , (call : TTLib function without "TTLib_",
+//   * for any ; @n : only its n-th call) : "LoadIntoExplorer=3000", "ButtonMoveInButtonGroup=60000@2"
+// Env. var. MVBTN_SIM_PROCS : processes owning windows, separated by ; as image path=window titles separated by ,
+//   "C:\\Office\\EXCEL.EXE=Book1.xlsx,Book2.xlsx". Other windows : a process per group, "C:\\sim\\<AppId's last part>.exe".
+// A window AppId set (ttsimSetAppId()) regroups the window at the next TTLib_ManipulationStart(), as Explorer would.
+// A trace replay seeds the taskbars (ttsimSeed()) and the latency of each call (ttsimState::script) instead.
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+#ifndef MAX_APPID_LENGTH
+  #define MAX_APPID_LENGTH 260
+#endif
+#define TTLIB_OK                  0
+#define TTLIB_ERR_NOT_INITIALIZED 1
+#define TTLIB_ERR_EXE_NOT_LOADED  2
+
+typedef enum {
+  TTLIB_GROUPTYPE_UNKNOWN = 0, TTLIB_GROUPTYPE_NORMAL, TTLIB_GROUPTYPE_PINNED, TTLIB_GROUPTYPE_COMBINED, TTLIB_GROUPTYPE_TEMPORARY
+} TTLIB_GROUPTYPE;
+
+struct ttsimGroup{ wstring appId; vector<HWND> buttons; };
+struct ttsimProc{ uint64_t start; wstring path, cmdLine; };
+struct ttsimTaskbar{ list<ttsimGroup> groups; };  // list : group handles stay valid
+
+// The simulated Explorer : one per run (ttsimAt, set for the threads working for it), runs on distinct ones in parallel
+struct ttsimState{
+  string spec;  // taskbars, as MVBTN_SIM_TASKBAR (empty : from it)
+  mutex mx;     // calls counted from any thread
+  bool ready = false, init = false, loaded = false, manip = false;
+  vector<ttsimTaskbar> tbs;
+  map<HWND, wstring> titles, appIds, homes;  // window title, AppId set on it, AppId of the group it opened in
+  set<HWND> regroup;                         // AppId changed, regrouped at the next manipulation start
+  map<string, pair<DWORD, int>> stalls; map<string, int> calls;
+  map<string, vector<DWORD>> script;          // latency (µs) of the n-th call of a function
+  map<wstring, wstring> exes;                 // window title -> image path (MVBTN_SIM_PROCS)
+  map<HWND, DWORD> pids; map<DWORD, ttsimProc> procs;
+};
+inline ttsimState ttsimProcess;
+inline thread_local ttsimState *ttsimAt = &ttsimProcess;
+
+inline vector<string> ttsimSplit(const string &s, char sep){
+  vector<string> v; size_t at = 0;
+  for(size_t end; (end = s.find(sep, at)) != string::npos; at = end+1) v.push_back(s.substr(at, end-at));
+  v.push_back(s.substr(at)); return v;
+}
+inline wstring ttsimWide(const string &s){ return wstring(s.begin(), s.end()); }
+
+inline void ttsimSetup(){
+  if(ttsimAt->ready) return;
+  ttsimAt->ready = true;
+  const char *spec = ttsimAt->spec.empty() ? getenv("MVBTN_SIM_TASKBAR") : ttsimAt->spec.c_str();
+  string tbs = spec && *spec ? spec : "Microsoft.Windows.Explorer=Documents,Downloads,Pictures;Notepad=a.txt,b.txt,c.txt,d.txt;7-Zip=archive.7z";
+  ULONG_PTR next = 0x10010;
+  for(auto &tb : ttsimSplit(tbs, '|')){
+    ttsimAt->tbs.emplace_back();
+    for(auto &grp : ttsimSplit(tb, ';')){
+      size_t eq = grp.find('='); if(grp.empty()) continue;
+      ttsimGroup g; g.appId = ttsimWide(grp.substr(0, eq));
+      if(eq != string::npos) for(auto &title : ttsimSplit(grp.substr(eq+1), ',')){
+        HWND h = (HWND) next; next += 0x10;
+        g.buttons.push_back(h); ttsimAt->titles[h] = ttsimWide(title); ttsimAt->homes[h] = g.appId;
+      }
+      ttsimAt->tbs.back().groups.push_back(g);
+    }
+  }
+  if(const char *pr = getenv("MVBTN_SIM_PROCS")) for(auto &proc : ttsimSplit(pr, ';')){
+    size_t eq = proc.find('='); if(eq == string::npos) continue;
+    for(auto &title : ttsimSplit(proc.substr(eq+1), ',')) ttsimAt->exes[ttsimWide(title)] = ttsimWide(proc.substr(0, eq));
+  }
+  if(const char *st = getenv("MVBTN_SIM_STALL")) for(auto &item : ttsimSplit(st, ',')){
+    size_t eq = item.find('='), at = item.find('@'); if(eq == string::npos) continue;
+    ttsimAt->stalls[item.substr(0, eq)] = { (DWORD) strtoul(item.c_str()+eq+1, nullptr, 10), at == string::npos ? 0 : atoi(item.c_str()+at+1) };
+  }
+}
+// The simulated Explorer a process runs on : its taskbars, processes and stalls, and its data (env.), as a session scope
+// (sessScope) : processes share a session (and hand their operations over) only on the same one, as on one Explorer
+inline string ttsimScope(){
+  string k; for(const char *v : { "MVBTN_SIM_TASKBAR", "MVBTN_SIM_PROCS", "MVBTN_SIM_STALL", "LOCALAPPDATA" }){ const char *s = getenv(v); k += s ? s : ""; k += '\n'; }
+  return "sim" + to_string(hash<string>{}(k) & 0xffffffff);
+}
+// Every call goes through here : counted, and stalled if asked to (from any thread : titles are fetched in parallel)
+inline void ttsimCall(const char *fn){
+  DWORD stallMs = 0, us = 0;
+  { lock_guard<mutex> lk(ttsimAt->mx);
+    ttsimSetup(); int n = ++ttsimAt->calls[fn];
+    auto it = ttsimAt->stalls.find(fn); if(it == ttsimAt->stalls.end()) it = ttsimAt->stalls.find("*");
+    if(it != ttsimAt->stalls.end() && (it->second.second == 0 || it->second.second == n)) stallMs = it->second.first;
+    auto sc = ttsimAt->script.find(fn);
+    if(sc != ttsimAt->script.end() && n <= (int) sc->second.size()) us = sc->second[n-1];
+  }
+  if(stallMs) this_thread::sleep_for(chrono::milliseconds(stallMs));
+  if(us) this_thread::sleep_for(chrono::microseconds(us));
+}
+// Taskbars from elsewhere (a trace) : a group of taskbar tb, its buttons as (window, title)
+inline void ttsimSeed(size_t tb, const wstring &appId, const vector<pair<HWND, wstring>> &buttons){
+  ttsimAt->ready = true; if(ttsimAt->tbs.size() <= tb) ttsimAt->tbs.resize(tb+1);
+  ttsimGroup g{ appId, {} };
+  for(auto &[h, title] : buttons){ g.buttons.push_back(h); ttsimAt->titles[h] = title; ttsimAt->homes[h] = appId; }
+  ttsimAt->tbs[tb].groups.push_back(g);
+}
+
+inline ttsimTaskbar* ttsimTb(HANDLE h){ for(auto &tb : ttsimAt->tbs) if((HANDLE) &tb == h) return &tb; return nullptr; }
+inline ttsimGroup* ttsimGrp(HANDLE h){
+  for(auto &tb : ttsimAt->tbs) for(auto &g : tb.groups) if((HANDLE) &g == h) return &g;
+  return nullptr;
+}
+
+inline void ttsimRegroup(){
+  for(HWND h : ttsimAt->regroup) for(auto &tb : ttsimAt->tbs){
+    auto has = [h](const ttsimGroup &x){ return find(x.buttons.begin(), x.buttons.end(), h) != x.buttons.end(); };
+    auto src = find_if(tb.groups.begin(), tb.groups.end(), has); if(src == tb.groups.end()) continue;
+    src->buttons.erase(find(src->buttons.begin(), src->buttons.end(), h));
+    wstring to = ttsimAt->appIds[h].empty() ? ttsimAt->homes[h] : ttsimAt->appIds[h];
+    auto dst = find_if(tb.groups.begin(), tb.groups.end(), [&to](const ttsimGroup &x){ return x.appId == to; });
+    if(dst == tb.groups.end()) dst = tb.groups.insert(tb.groups.end(), { to, {} });
+    dst->buttons.push_back(h); break;
+  }
+  for(auto &tb : ttsimAt->tbs) tb.groups.remove_if([](const ttsimGroup &g){ return g.buttons.empty(); });
+  ttsimAt->regroup.clear();
+}
+
+inline DWORD TTLib_Init(){ ttsimCall("Init"); ttsimAt->init = true; return TTLIB_OK; }
+inline BOOL TTLib_Uninit(){ ttsimCall("Uninit"); ttsimAt->init = false; return TRUE; }
+inline DWORD TTLib_LoadIntoExplorer(){
+  ttsimCall("LoadIntoExplorer"); if(!ttsimAt->init) return TTLIB_ERR_NOT_INITIALIZED;
+  ttsimAt->loaded = true; return TTLIB_OK;
+}
+inline BOOL TTLib_UnloadFromExplorer(){ ttsimCall("UnloadFromExplorer"); if(!ttsimAt->loaded) return FALSE; ttsimAt->loaded = false; return TRUE; }
+inline BOOL TTLib_ManipulationStart(){
+  ttsimCall("ManipulationStart"); if(!ttsimAt->loaded || ttsimAt->manip) return FALSE;
+  ttsimRegroup(); return ttsimAt->manip = true;
+}
+inline BOOL TTLib_ManipulationEnd(){ ttsimCall("ManipulationEnd"); if(!ttsimAt->manip) return FALSE; ttsimAt->manip = false; return TRUE; }
+
+inline HANDLE TTLib_GetMainTaskbar(){ ttsimCall("GetMainTaskbar"); return ttsimAt->manip && ttsimAt->tbs.size() ? (HANDLE) &ttsimAt->tbs[0] : nullptr; }
+inline BOOL TTLib_GetSecondaryTaskbarCount(int *pn){ ttsimCall("GetSecondaryTaskbarCount"); *pn = ttsimAt->tbs.size() ? (int) ttsimAt->tbs.size()-1 : 0; return ttsimAt->manip; }
+inline HANDLE TTLib_GetSecondaryTaskbar(int i){
+  ttsimCall("GetSecondaryTaskbar"); return ttsimAt->manip && i >= 1 && i < (int) ttsimAt->tbs.size() ? (HANDLE) &ttsimAt->tbs[i] : nullptr;
+}
+
+inline BOOL TTLib_GetButtonGroupCount(HANDLE hTaskbar, int *pn){
+  ttsimCall("GetButtonGroupCount"); auto tb = ttsimTb(hTaskbar); if(!tb) return FALSE;
+  *pn = (int) tb->groups.size(); return TRUE;
+}
+inline HANDLE TTLib_GetButtonGroup(HANDLE hTaskbar, int i){
+  ttsimCall("GetButtonGroup"); auto tb = ttsimTb(hTaskbar); if(!tb || i < 0 || i >= (int) tb->groups.size()) return nullptr;
+  return (HANDLE) &*next(tb->groups.begin(), i);
+}
+inline HANDLE TTLib_GetActiveButtonGroup(HANDLE hTaskbar){
+  ttsimCall("GetActiveButtonGroup"); auto tb = ttsimTb(hTaskbar); return tb && tb->groups.size() ? (HANDLE) &tb->groups.front() : nullptr;
+}
+inline BOOL TTLib_ButtonGroupMove(HANDLE hTaskbar, int from, int to){
+  ttsimCall("ButtonGroupMove"); auto tb = ttsimTb(hTaskbar); int n = tb ? (int) tb->groups.size() : 0;
+  if(from < 0 || to < 0 || from >= n || to >= n) return FALSE;
+  auto it = next(tb->groups.begin(), from);
+  tb->groups.splice(next(tb->groups.begin(), to > from ? to+1 : to), tb->groups, it);
+  return TRUE;
+}
+inline BOOL TTLib_GetButtonGroupType(HANDLE hGroup, TTLIB_GROUPTYPE *pType){
+  ttsimCall("GetButtonGroupType"); if(!ttsimGrp(hGroup)) return FALSE;
+  *pType = TTLIB_GROUPTYPE_NORMAL; return TRUE;
+}
+inline BOOL TTLib_GetButtonGroupAppId(HANDLE hGroup, WCHAR *pszAppId, int nMaxSize){
+  ttsimCall("GetButtonGroupAppId"); auto g = ttsimGrp(hGroup); if(!g || nMaxSize <= 0) return FALSE;
+  size_t n = min(g->appId.size(), (size_t) nMaxSize-1); copy_n(g->appId.c_str(), n, pszAppId); pszAppId[n] = 0;
+  return TRUE;
+}
+inline BOOL TTLib_GetButtonCount(HANDLE hGroup, int *pn){
+  ttsimCall("GetButtonCount"); auto g = ttsimGrp(hGroup); if(!g) return FALSE;
+  *pn = (int) g->buttons.size(); return TRUE;
+}
+inline HANDLE TTLib_GetButton(HANDLE hGroup, int i){
+  ttsimCall("GetButton"); auto g = ttsimGrp(hGroup); if(!g || i < 0 || i >= (int) g->buttons.size()) return nullptr;
+  return (HANDLE) g->buttons[i];  // a button is its window
+}
+inline HWND TTLib_GetButtonWindow(HANDLE hButton){ ttsimCall("GetButtonWindow"); return (HWND) hButton; }
+inline BOOL TTLib_ButtonMoveInButtonGroup(HANDLE hGroup, int from, int to){
+  ttsimCall("ButtonMoveInButtonGroup"); auto g = ttsimGrp(hGroup); int n = g ? (int) g->buttons.size() : 0;
+  if(from < 0 || to < 0 || from >= n || to >= n) return FALSE;
+  HWND h = g->buttons[from]; g->buttons.erase(g->buttons.begin()+from); g->buttons.insert(g->buttons.begin()+to, h);
+  return TRUE;
+}
+
+// Windows of the simulated taskbars : title, AppId
+inline int ttsimWindowText(HWND hWnd, LPWSTR buf, int n){
+  ttsimCall("GetWindowText"); if(n <= 0) return 0;
+  auto it = ttsimAt->titles.find(hWnd); wstring t = it == ttsimAt->titles.end() ? L"" : it->second;
+  size_t len = min(t.size(), (size_t) n-1); copy_n(t.c_str(), len, buf); buf[len] = 0;
+  return (int) len;
+}
+inline BOOL ttsimSetAppId(HWND hWnd, LPCWSTR pAppId){
+  ttsimCall("SetAppId"); if(!ttsimAt->titles.count(hWnd)) return FALSE;
+  ttsimAt->appIds[hWnd] = pAppId ? pAppId : L""; ttsimAt->regroup.insert(hWnd);
+  return TRUE;
+}
+inline wstring ttsimGetAppId(HWND hWnd){ ttsimSetup(); auto it = ttsimAt->appIds.find(hWnd); return it == ttsimAt->appIds.end() ? L"" : it->second; }
+
+// Processes owning the windows : a window's, assigned at first sight. The start time follows from the path : another
+// process table (MVBTN_SIM_PROCS) is another set of processes, as after a reboot.
+inline DWORD ttsimWndPid(HWND hWnd, LPDWORD pid){
+  ttsimCall("GetWindowThreadProcessId"); *pid = 0;
+  if(auto it = ttsimAt->pids.find(hWnd); it != ttsimAt->pids.end()) return *pid = it->second;
+  auto t = ttsimAt->titles.find(hWnd); if(t == ttsimAt->titles.end()) return 0;
+  wstring path; if(auto ex = ttsimAt->exes.find(t->second); ex != ttsimAt->exes.end()) path = ex->second;
+  else{ wstring &a = ttsimAt->homes[hWnd]; path = L"C:\\sim\\" + a.substr(a.find_last_of(L".!\\/") + 1) + L".exe"; }
+  DWORD p = 0; for(auto &[id, pr] : ttsimAt->procs) if(pr.path == path){ p = id; break; }
+  if(!p){ p = 1000 + 4 * (DWORD) ttsimAt->procs.size(); ttsimAt->procs[p] = { 133000000000000000ull + (hash<wstring>{}(path) & 0xffffffff) * 16 + p, path, L"\"" + path + L"\"" }; }
+  return *pid = ttsimAt->pids[hWnd] = p;
+}
+inline uint64_t ttsimProcStart(DWORD pid){ ttsimCall("GetProcessTimes"); auto it = ttsimAt->procs.find(pid); return it == ttsimAt->procs.end() ? 0 : it->second.start; }
+inline void ttsimProcQuery(DWORD pid, wstring &path, wstring &cmdLine){
+  ttsimCall("QueryFullProcessImageName"); auto it = ttsimAt->procs.find(pid); if(it == ttsimAt->procs.end()) return;
+  path = it->second.path; cmdLine = it->second.cmdLine;
+}
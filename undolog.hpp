@@ -0,0 +1,149 @@
+// undolog.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Append-only log of the changes made to the taskbar, one session per operation, to undo them later.
+//
+// Records, numbers as LEB128 varints :
+//   'S' time tb          session start (unix time, taskbar id)
+//   'A' len code units   AppId, numbered from 0 within the session (UTF-16)
+//   'M' grp from to      move in group : grp = AppId number, positions 0-based
+//   'W' hwnd prior next  window AppId changed : AppId number + 1, 0 for none (Windows' default)
+//   'G' from to          group moved
+// A move costs 4 bytes, a session a dozen : thousands of sessions fit in the size kept (undoLogMax).
+// Undone sessions are dropped from the log : it is cut at their start.
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+
+using namespace std;
+
+struct undoOp{ char kind = 0; uint32_t grp = 0, from = 0, to = 0; uint64_t hwnd = 0; uint32_t prior = 0, next = 0; };
+struct undoSession{ uint64_t time = 0; uint32_t tb = 0; vector<wstring> appIds; vector<undoOp> ops; uint64_t offset = 0; };
+
+static const uintmax_t undoLogMax = 1 << 20;  // compacted to half when larger
+
+inline void undoPut(string &s, uint64_t v){ do{ s += (char) ((v & 0x7F) | (v > 0x7F ? 0x80 : 0)); v >>= 7; } while(v); }
+inline bool undoGet(const string &s, size_t &at, uint64_t &v){
+  v = 0; for(int sh = 0; at < s.size() && sh < 64; sh += 7){
+    unsigned char c = s[at++]; v |= (uint64_t) (c & 0x7F) << sh;
+    if(!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+inline FILE* undoOpen(const filesystem::path &p, const char *mode){
+#ifdef _WIN32
+  wchar_t wmode[4] = { 0 }; for(int i = 0; i < 3 && mode[i]; i++) wmode[i] = mode[i];
+  return _wfopen(p.c_str(), wmode);
+#else
+  return fopen(p.c_str(), mode);
+#endif
+}
+inline bool undoReadAll(const filesystem::path &p, string &s){
+  FILE *f = undoOpen(p, "rb"); if(!f) return false;
+  char buf[1 << 14]; size_t n; s.clear();
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+  fclose(f); return true;
+}
+
+class undoLog{
+  filesystem::path path; FILE *f = nullptr;
+  undoSession cur; bool started = false;
+
+  void write(const string &rec){
+    if(!f) return;
+    if(!started){
+      started = true; fseek(f, 0, SEEK_END); cur.offset = (uint64_t) ftell(f);
+      string hdr = "S"; undoPut(hdr, cur.time); undoPut(hdr, cur.tb); fwrite(hdr.data(), 1, hdr.size(), f);
+    }
+    fwrite(rec.data(), 1, rec.size(), f); fflush(f);  // survives a crash mid-operation
+  }
+  uint32_t appId(const WCHAR *str){
+    for(uint32_t i = 0; i < cur.appIds.size(); i++) if(cur.appIds[i] == str) return i;
+    cur.appIds.emplace_back(str);
+    string rec = "A"; undoPut(rec, cur.appIds.back().size());
+    for(WCHAR c : cur.appIds.back()) undoPut(rec, (uint16_t) c);
+    write(rec); return (uint32_t) cur.appIds.size()-1;
+  }
+
+public:
+  bool enabled = true;
+
+  void open(const filesystem::path &p){
+    path = p; error_code ec;
+    filesystem::create_directories(p.parent_path(), ec);
+    if(filesystem::file_size(p, ec) > undoLogMax && !ec) compact(undoLogMax/2);
+    f = undoOpen(p, "ab");
+  }
+  ~undoLog(){ if(f) fclose(f); }
+
+  void begin(uint32_t tb){ cur = {}; cur.tb = tb; cur.time = (uint64_t) ::time(nullptr); started = false; }
+  const undoSession& session() const { return cur; }
+  // Current session undone (rolled back) : out of the log
+  void drop(){ if(f && started){ fflush(f); cut(path, cur.offset); } begin(cur.tb); }
+
+  void move(const WCHAR *grpAppId, uint32_t from, uint32_t to){
+    if(!enabled) return;
+    undoOp op{ 'M', appId(grpAppId), from, to }; cur.ops.push_back(op);
+    string rec = "M"; undoPut(rec, op.grp); undoPut(rec, from); undoPut(rec, to); write(rec);
+  }
+  void setAppId(uint64_t hwnd, const WCHAR *prior, const WCHAR *next){
+    if(!enabled) return;
+    undoOp op{ 'W' }; op.hwnd = hwnd;
+    op.prior = prior && *prior ? 1 + appId(prior) : 0; op.next = next && *next ? 1 + appId(next) : 0; cur.ops.push_back(op);
+    string rec = "W"; undoPut(rec, hwnd); undoPut(rec, op.prior); undoPut(rec, op.next); write(rec);
+  }
+  void groupMove(uint32_t from, uint32_t to){
+    if(!enabled) return;
+    undoOp op{ 'G', 0, from, to }; cur.ops.push_back(op);
+    string rec = "G"; undoPut(rec, from); undoPut(rec, to); write(rec);
+  }
+
+  // Sessions in the log, oldest first. A damaged tail is ignored.
+  static vector<undoSession> load(const filesystem::path &p){
+    vector<undoSession> ss; string s; if(!undoReadAll(p, s)) return ss;
+    size_t at = 0; uint64_t a, b, c;
+    while(at < s.size()){
+      size_t recAt = at; char kind = s[at++];
+      if(kind=='S'){
+        if(!undoGet(s, at, a) || !undoGet(s, at, b)) break;
+        ss.emplace_back(); ss.back().time = a; ss.back().tb = (uint32_t) b; ss.back().offset = recAt; continue;
+      }
+      if(ss.empty()) break;
+      undoSession &cs = ss.back();
+      if(kind=='A'){
+        if(!undoGet(s, at, a)) break;
+        wstring id; while(a-- && undoGet(s, at, b)) id += (WCHAR) b;
+        cs.appIds.push_back(id); continue;
+      }
+      undoOp op{ kind };
+      if(kind=='M'){ if(!undoGet(s, at, a) || !undoGet(s, at, b) || !undoGet(s, at, c) || a >= cs.appIds.size()) break;
+        op.grp = (uint32_t) a; op.from = (uint32_t) b; op.to = (uint32_t) c; }
+      else if(kind=='W'){ if(!undoGet(s, at, a) || !undoGet(s, at, b) || !undoGet(s, at, c) || b > cs.appIds.size() || c > cs.appIds.size()) break;
+        op.hwnd = a; op.prior = (uint32_t) b; op.next = (uint32_t) c; }
+      else if(kind=='G'){ if(!undoGet(s, at, a) || !undoGet(s, at, b)) break;
+        op.from = (uint32_t) a; op.to = (uint32_t) b; }
+      else break;
+      cs.ops.push_back(op);
+    }
+    return ss;
+  }
+
+  // Drops the sessions from offset on (undone)
+  static bool cut(const filesystem::path &p, uint64_t offset){
+    error_code ec; filesystem::resize_file(p, offset, ec); return !ec;
+  }
+  // Keeps the newest sessions, within keep bytes
+  void compact(uintmax_t keep){
+    string s; if(!undoReadAll(path, s)) return;
+    auto ss = load(path); size_t from = s.size();
+    for(auto it = ss.rbegin(); it != ss.rend() && s.size() - it->offset <= keep; ++it) from = (size_t) it->offset;
+    filesystem::path tmp = path; tmp += ".tmp";
+    FILE *w = undoOpen(tmp, "wb"); if(!w) return;
+    fwrite(s.data() + from, 1, s.size() - from, w); fclose(w);
+    error_code ec; filesystem::rename(tmp, path, ec);
+  }
+};
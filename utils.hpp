@@ -8,45 +8,50 @@
 
 
 //#include <windows.h>
-#include <iostream>
 #include <vector>
 #include <algorithm>
 #include <memory>
-#include <sstream>
 #include <random>
+#include <string>
+#include <cstdarg>
+#include <cstdio>
+#include <clocale>
 
 using namespace std;
 #define sysErr 10000+GetLastError()
-#define dbg(x) cout <<x<<endl<<flush;
+#define dbg(...) flushErr(__VA_ARGS__);  // the run's error output (outSink())
+
+// C string returned by the conversion/concatenation helpers, owning its buffer. *s : the string, valid as long as s
+// (keep s, not *s, beyond the statement).
+template <typename C>
+class cstrOwned {
+	unique_ptr<C[]> buf;
+public:
+	explicit cstrOwned(C* p) : buf(p) {}
+	C* operator*() const { return buf.get(); }
+	C* get() const { return buf.get(); }
+};
 
 void printErr(LPCSTR msg, LONG errCode, int exitCode);
-unique_ptr<LPSTR> wide2uf8(LPCWSTR str);
+inline void flushErr(LPCSTR format, ...);
+cstrOwned<char> wide2uf8(LPCWSTR str);
 
-inline void chkAlloc(size_t count) {};
+inline void chkAlloc(size_t) {};
 template <typename T, class ... Ts>
 inline void chkAlloc(size_t count, T*& x, Ts&& ...args) {
 	try { x = new T[count](); }
-	catch (const bad_alloc) {
-		fprintf(stderr, "Error allocating memory (%zu x %zu bytes).\n\n", count, sizeof(T));
+	catch (const bad_alloc &) {
+		flushErr("Error allocating memory (%zu x %zu bytes).\n\n", count, sizeof(T));
     clean_exit(15);
 	}
 	chkAlloc(count, args...);
 }
 
-template <typename T>
-inline void chkRealloc(T*& x, size_t count) {
-  if(x==nullptr) printErr("Error: chkRealloc(): cannot be realloc null pointer\n", 0, 15);
-  x = (T*)realloc((void*)x, count * sizeof(T));
-  if (nullptr == x) {
-    fprintf(stderr, "\n  Error: not enough memory (trying to reserve %zu x %zu bytes).\n\n", count, sizeof(T)); clean_exit(14);;
-  }
-}
-
-void checkedVectResz(size_t count){}
+void checkedVectResz(size_t){}
 template <typename T, class ... Ts>
 void checkedVectResz(size_t count, vector<T> &x, Ts&& ...args){
-  try{ x.resize(count); } catch(const bad_alloc){
-    fprintf(stderr, "Error allocating memory (%zu x %zu bytes).\n\n", count, sizeof(T));
+  try{ x.resize(count); } catch(const bad_alloc &){
+    flushErr("Error allocating memory (%zu x %zu bytes).\n\n", count, sizeof(T));
     clean_exit(14);
   }
   checkedVectResz(count, args...);
@@ -72,19 +77,82 @@ bool iequals(const string& a, const string& b)
 		});
 }
 
+// Output sink : flushOut()/flushErr() fragments are buffered per operation, and written at once by outFlush().
+// outMode::quiet drops normal output (errors are kept), outMode::json writes one record per operation instead :
+// fields set with outSet(), error text in "message". A run has a sink of its own (outAt, set for the threads working for
+// it), captured : what outFlush() writes is kept in outText/errText instead.
+enum class outMode{ text, quiet, json };
+struct outBuffer{ outMode mode = outMode::text; string out, err; vector<pair<string, string>> rec; bool capture = false; string outText, errText; };
+inline outBuffer outProcess;
+inline thread_local outBuffer *outAt = &outProcess;
+inline outBuffer& outSink() { return *outAt; }
+
+inline void vappendf(string &s, LPCSTR format, va_list args) {
+	va_list args2; va_copy(args2, args);
+	int n = vsnprintf(nullptr, 0, format, args2); va_end(args2);
+	if (n <= 0) return;
+	size_t sz = s.size(); s.resize(sz + n + 1);
+	vsnprintf(&s[sz], (size_t)n + 1, format, args); s.resize(sz + n);
+}
 inline void flushErr(LPCSTR format, ...) {
 	va_list args;
 	va_start(args, format);
-	vfprintf(stderr, format, args); fflush(stderr);
+	vappendf(outSink().err, format, args);
 	va_end(args);
 }
 inline void flushOut(LPCSTR format, ...) {
+	if (outSink().mode != outMode::text) return;
 	va_list args;
 	va_start(args, format);
-	vfprintf(stdout, format, args); fflush(stdout);
+	vappendf(outSink().out, format, args);
 	va_end(args);
 }
 
+inline string jsonStr(const string& str) {
+	string s = "\""; char hex[8];
+	for (unsigned char c : str) switch (c) {
+		case '"': s += "\\\""; break;   case '\\': s += "\\\\"; break;
+		case '\n': s += "\\n"; break;   case '\r': s += "\\r"; break;  case '\t': s += "\\t"; break;
+		default: if (c < 0x20) { snprintf(hex, sizeof(hex), "\\u%04x", c); s += hex; } else s += (char)c;
+	}
+	return s += "\"";
+}
+inline void outSetRaw(LPCSTR key, const string& json) {
+	for (auto& [k, v] : outSink().rec) if (k == key) { v = json; return; }
+	outSink().rec.emplace_back(key, json);
+}
+inline void outSet(LPCSTR key, LPCSTR str) { outSetRaw(key, str ? jsonStr(str) : "null"); }
+inline void outSet(LPCSTR key, long long n) { outSetRaw(key, to_string(n)); }
+template <typename C>
+inline void outSetList(LPCSTR key, const C& c) {
+	string s = "["; for (auto x : c) { if (s.size() > 1) s += ","; s += to_string(x); }
+	outSetRaw(key, s += "]");
+}
+
+// Renders the operation's output (what outFlush() writes) into out/err, and resets the sink
+inline void outRender(string& out, string& err) {
+	outBuffer& o = outSink(); out.clear(); err.clear();
+	if (o.mode == outMode::json) {
+		if (!o.rec.empty() || !o.err.empty()) {
+			out = "{";
+			for (auto& [k, v] : o.rec) { if (out.size() > 1) out += ","; out += jsonStr(k) + ":" + v; }
+			if (!o.err.empty()) { trim(o.err); out += (out.size() > 1 ? ",\"message\":" : "\"message\":") + jsonStr(o.err); }
+			out += "}\n";
+		}
+	}
+	else { out = move(o.out); err = move(o.err); }
+	o.out.clear(); o.err.clear(); o.rec.clear();
+}
+// Console locale (UTF-8), set with the first output : not paid for by runs that print nothing
+inline void outLocale() { static const bool set = setlocale(LC_ALL, "en-US.65001") != nullptr; (void)set; }  // once, whichever thread
+inline void outWrite(const string& out, const string& err) {
+	if (outSink().capture) { outSink().outText += out; outSink().errText += err; return; }
+	if (!out.empty() || !err.empty()) outLocale();
+	if (!out.empty()) { fwrite(out.data(), 1, out.size(), stdout); fflush(stdout); }
+	if (!err.empty()) { fwrite(err.data(), 1, err.size(), stderr); fflush(stderr); }
+}
+inline void outFlush() { string out, err; outRender(out, err); outWrite(out, err); }
+
 inline void printErr(LPCSTR msg, LONG errCode, int exitCode) {
 	if (errCode > 10000) {  // query system
 		errCode -= 10000;
@@ -92,7 +160,7 @@ inline void printErr(LPCSTR msg, LONG errCode, int exitCode) {
 		LPWSTR messageBuffer = nullptr;
 		if (0 < FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
 			nullptr, (DWORD)errCode, 0, (LPWSTR)&messageBuffer, 0, nullptr)) {
-			LPSTR u8str = *wide2uf8(messageBuffer);
+			auto u8 = wide2uf8(messageBuffer); LPSTR u8str = *u8;
 			size_t n = strlen(u8str) - 1; while (u8str[n] == '\n') u8str[(n--)] = 0;  // thank you
 			flushErr("  (Err %d) %s\n\n", errCode, u8str);
 			LocalFree(messageBuffer); //delete[] u8str; //free((void *)u8str);
@@ -104,7 +172,7 @@ inline void printErr(LPCSTR msg, LONG errCode, int exitCode) {
 	if (exitCode != 0) clean_exit(exitCode);
 }
 
-inline unique_ptr<LPSTR> wide2uf8(LPCWSTR str) {
+inline cstrOwned<char> wide2uf8(LPCWSTR str) {
 	auto dwCount = WideCharToMultiByte(CP_UTF8, 0, str, -1, nullptr, 0, nullptr, nullptr);
 	if (0 == dwCount) {
 		DWORD errorID = GetLastError();
@@ -114,10 +182,10 @@ inline unique_ptr<LPSTR> wide2uf8(LPCWSTR str) {
 	char* pText = nullptr; chkAlloc(dwCount, pText);
 	if (0 == WideCharToMultiByte(CP_UTF8, 0, str, -1, pText, dwCount, nullptr, nullptr))
 		printErr("Error: uf8toWide(): WideCharToMultiByte() failed\n", sysErr, 58);
-	return make_unique<LPSTR>(pText);
+	return cstrOwned<char>(pText);
 }
 
-inline unique_ptr<LPWSTR> uf8toWide(LPCCH str) {
+inline cstrOwned<WCHAR> uf8toWide(LPCCH str) {
   auto dwCount = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, str, -1, nullptr, 0);
   if (0==dwCount){ DWORD errorMessageID = GetLastError();
     fprintf(stderr, "Error: MultiByteToWideChar() failed: %s\n",str); fflush(stderr);
@@ -125,42 +193,37 @@ inline unique_ptr<LPWSTR> uf8toWide(LPCCH str) {
   wchar_t *pText = nullptr; chkAlloc(dwCount, pText);
   if(0==MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, str, -1, pText, dwCount))
     printErr("Error: uf8toWide(): MultiByteToWideChar() failed\n", sysErr, 55);
-  return make_unique<LPWSTR>(pText);
+  return cstrOwned<WCHAR>(pText);
 }
 
-inline unique_ptr<LPSTR> catStr(initializer_list<LPCSTR> list){
-  size_t sz = 0;
-  HRESULT hRslt = S_OK;
-  LPSTR buff; chkAlloc(1, buff); buff[0] = '\0';
+inline cstrOwned<char> catStr(initializer_list<LPCSTR> list){
+  size_t sz = 1; for(auto x : list) sz += strlen(x);
+  LPSTR buff; chkAlloc(sz, buff);
   for(auto x : list){
-    chkRealloc(buff, sz = 1 + strlen(x) + strlen(buff));
-    hRslt = StringCchCatA(buff, sz, x);
+    HRESULT hRslt = StringCchCatA(buff, sz, x);
     if(FAILED(hRslt)){
-      fprintf(stderr, "Error: catStr(): StringCchCatA() failed: ");
-      if(hRslt==STRSAFE_E_INSUFFICIENT_BUFFER) fprintf(stderr, "INSUFFICIENT_BUFFER of %zu bytes\n", sz * sizeof(CHAR));
+      flushErr("Error: catStr(): StringCchCatA() failed: ");
+      if(hRslt==STRSAFE_E_INSUFFICIENT_BUFFER) flushErr("INSUFFICIENT_BUFFER of %zu bytes\n", sz * sizeof(CHAR));
       else printErr(nullptr, sysErr, 23);
       clean_exit(16);
     }
   }
-  return make_unique<LPSTR>(buff);
+  return cstrOwned<char>(buff);
 }
 
-inline unique_ptr<LPWSTR> catWstr(initializer_list<LPCWSTR> list) {
-  size_t sz = 0;
-  HRESULT hRslt = S_OK;
-  LPWSTR buff; chkAlloc(1, buff); buff[0] = '\0';
+inline cstrOwned<WCHAR> catWstr(initializer_list<LPCWSTR> list) {
+  size_t sz = 1; for (auto x : list) sz += (size_t)lstrlenW(x);
+  LPWSTR buff; chkAlloc(sz, buff);
   for (auto x : list) {
-    sz = 1 + (size_t)lstrlenW(x) + lstrlenW(buff);
-    chkRealloc(buff, sz);
-    hRslt = StringCchCatW(buff, sz, x);
+    HRESULT hRslt = StringCchCatW(buff, sz, x);
     if (FAILED(hRslt)) {
-      fprintf(stderr, "Error: catWstr(): StringCchCatW() failed: ");
-      if (hRslt == STRSAFE_E_INSUFFICIENT_BUFFER) fprintf(stderr, "INSUFFICIENT_BUFFER of %zu bytes\n", sz * sizeof(WCHAR));
+      flushErr("Error: catWstr(): StringCchCatW() failed: ");
+      if (hRslt == STRSAFE_E_INSUFFICIENT_BUFFER) flushErr("INSUFFICIENT_BUFFER of %zu bytes\n", sz * sizeof(WCHAR));
       else printErr(nullptr, sysErr, 24);
       clean_exit(16);
     }
   }
-  return make_unique<LPWSTR>(buff);
+  return cstrOwned<WCHAR>(buff);
 }
 
 inline void wstrCopy(LPWSTR dst, size_t sz, LPWSTR src, bool truncate){
@@ -173,28 +236,22 @@ inline void wstrCopy(LPWSTR dst, size_t sz, LPWSTR src, bool truncate){
     printErr("Error: StringCchCopyW() failed: insufficient buffer\n", 0, 17);
 }
 
-inline bool getEnvVar(LPCWSTR var, LPWSTR &val){
-	DWORD bufSz = 1025;
-	LPWSTR buf; chkAlloc(bufSz, buf);
-
-  DWORD ret = GetEnvironmentVariableW(var, buf, bufSz);
+// Values up to 255 characters (all of ours) are read on the stack : no allocation for a variable not set, or short
+inline bool getEnvVar(LPCWSTR var, wstring &val){
+  WCHAR buf[256];
+  DWORD ret = GetEnvironmentVariableW(var, buf, 256);
   if(0 == ret){
-		DWORD err = GetLastError();
-    if(ERROR_ENVVAR_NOT_FOUND == err){
-			//flushOut("Environment variable does not exist.\n");
-      return FALSE;
-    }
-  } 
-	else if(bufSz < ret){
-		chkRealloc(buf, ret);
-		ret = GetEnvironmentVariable(var, buf, ret);
-		if(!ret){
-			printErr("GetEnvironmentVariable failed", sysErr, 0);
-			return FALSE;
-		}
-	}
-
-	val = *catWstr({buf});
+    if(ERROR_ENVVAR_NOT_FOUND == GetLastError()) return FALSE;
+    val.clear(); return TRUE;  // set, empty
+  }
+  if(ret < 256){ val.assign(buf, ret); return TRUE; }
+  val.resize(ret);  // ret : size needed, NUL included
+  ret = GetEnvironmentVariableW(var, val.data(), ret);
+  if(!ret || ret >= val.size()){  // failed, or grown meanwhile
+    printErr("GetEnvironmentVariable failed", sysErr, 0);
+    return FALSE;
+  }
+  val.resize(ret);
   return TRUE;
 }
 
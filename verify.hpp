@@ -0,0 +1,53 @@
+// verify.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Expected state of the groups an operation changes (--verify) : their windows in order, as the changes made should have
+// left them, and the range of positions the changes touched. Kept in step with the changes (moved(), regrouped()), then
+// checked by reading back those positions only : the cost is that of the buttons moved, not of the taskbar.
+
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+struct expectGroup{
+  int grp = -1;                // index as enumerated, -1 : a group made by the operation
+  vector<HWND> order;          // windows, in expected order
+  int lo = INT_MAX, hi = -1;   // positions changed
+
+  void touch(int a, int b){ lo = min(lo, min(a, b)); hi = max(hi, max(a, b)); }
+  bool changed() const { return lo <= hi; }
+};
+
+class btnExpect{
+  map<wstring, expectGroup> groups;
+
+public:
+  bool unseen = false;  // windows regrouped since TTLib was (re)loaded
+
+  void clear(){ groups.clear(); unseen = false; }
+  bool empty() const { return groups.empty(); }
+  const map<wstring, expectGroup>& all() const { return groups; }
+
+  // Group appId, first changed : its windows as enumerated (grp : its index then, -1 if none)
+  expectGroup& group(const wstring &appId, int grp, const vector<HWND> &enumerated){
+    auto [it, added] = groups.try_emplace(appId);
+    if(added){ it->second.grp = grp; it->second.order = enumerated; }
+    return it->second;
+  }
+  // Button moved from -> to (0-based) within its group
+  void moved(expectGroup &g, int from, int to){
+    auto &o = g.order; if(from < 0 || to < 0 || from >= (int) o.size() || to >= (int) o.size()) return;
+    HWND h = o[from]; o.erase(o.begin()+from); o.insert(o.begin()+to, h);
+    g.touch(from, to);
+  }
+  // Window h moved to the end of another group (AppId changed) : those after it in its group shift by one
+  void regrouped(HWND h, expectGroup &from, expectGroup &to){
+    auto &o = from.order; auto it = find(o.begin(), o.end(), h);
+    if(it != o.end()){ int p = (int) (it - o.begin()); o.erase(it); from.touch(p, (int) o.size()); }
+    to.order.push_back(h); to.touch((int) to.order.size()-1, (int) to.order.size()-1); unseen = true;
+  }
+};
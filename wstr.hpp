@@ -0,0 +1,102 @@
+// wstr.hpp
+// Copyright (c) 2022 Wasfi JAOUAD. All rights reserved.
+// v0.1 2022.07
+// Case-insensitive UTF-16 search and compare, portable (no locale, no shlwapi).
+//
+// Folding is simple case folding (one code unit to one code unit) for Latin, Greek, Cyrillic, Armenian, Georgian,
+// fullwidth forms, roman numerals and circled letters. No non-ASCII code unit folds to ASCII (long s, Kelvin sign
+// and dotted capital I keep their case), so an ASCII needle only ever matches ASCII : the SSE2 filter on the first
+// character folds 8 code units at a time with no lookup.
+//
+//   wstrStrI(L"Microsoft.Windows.Explorer", L"EXPLORER")  -> pointer to "Explorer", as StrStrIW()
+//   wstrEqI(arg, L"All")                                   -> as 0==StrCmpIW()
+
+#include <cstddef>
+#include <cwchar>
+#include <bit>
+#include <iterator>
+#include <algorithm>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+  #include <emmintrin.h>
+  #define WSTR_SSE2
+#endif
+
+struct wstrFoldRange{ char16_t lo, hi; short delta; bool alt; };  // alt : lo, lo+2, .. fold to the next code unit
+
+static const wstrFoldRange wstrFolds[] = {
+  { 0x00C0, 0x00D6,   32, 0 }, { 0x00D8, 0x00DE,   32, 0 },
+  { 0x0100, 0x012F,    1, 1 }, { 0x0132, 0x0137,    1, 1 }, { 0x0139, 0x0148,    1, 1 }, { 0x014A, 0x0177,    1, 1 },
+  { 0x0178, 0x0178, -121, 0 }, { 0x0179, 0x017E,    1, 1 },
+  { 0x01CD, 0x01DC,    1, 1 }, { 0x01DE, 0x01EF,    1, 1 }, { 0x01F8, 0x021F,    1, 1 }, { 0x0222, 0x0233,    1, 1 },
+  { 0x0386, 0x0386,   38, 0 }, { 0x0388, 0x038A,   37, 0 }, { 0x038C, 0x038C,   64, 0 }, { 0x038E, 0x038F,   63, 0 },
+  { 0x0391, 0x03A1,   32, 0 }, { 0x03A3, 0x03AB,   32, 0 }, { 0x03C2, 0x03C2,    1, 0 }, { 0x03D8, 0x03EF,    1, 1 },
+  { 0x0400, 0x040F,   80, 0 }, { 0x0410, 0x042F,   32, 0 }, { 0x0460, 0x0481,    1, 1 }, { 0x048A, 0x04BF,    1, 1 },
+  { 0x04C0, 0x04C0,   15, 0 }, { 0x04C1, 0x04CE,    1, 1 }, { 0x04D0, 0x052F,    1, 1 },
+  { 0x0531, 0x0556,   48, 0 },
+  { 0x10A0, 0x10C5, 7264, 0 },
+  { 0x1E00, 0x1E95,    1, 1 }, { 0x1EA0, 0x1EFF,    1, 1 },
+  { 0x2160, 0x216F,   16, 0 }, { 0x24B6, 0x24CF,   26, 0 }, { 0x2C00, 0x2C2E,   48, 0 },
+  { 0xFF21, 0xFF3A,   32, 0 }
+};
+
+template <typename C>
+inline C wstrFold(C c){
+  if(c < 0x80) return (c >= 'A' && c <= 'Z') ? (C) (c | 0x20) : c;
+  if(c < 0xC0 || c > 0xFF3A) return c;
+  auto r = std::lower_bound(std::begin(wstrFolds), std::end(wstrFolds), c,
+    [](const wstrFoldRange &f, C x){ return f.hi < x; });
+  if(r == std::end(wstrFolds) || c < r->lo) return c;
+  if(r->alt) return (c - r->lo) % 2 ? c : (C) (c + 1);
+  return (C) (c + r->delta);
+}
+
+// Index of the first case-insensitive match of pat (m code units) in hay (n code units), -1 if none
+template <typename C>
+ptrdiff_t wstrFindI(const C *hay, size_t n, const C *pat, size_t m){
+  if(m == 0) return 0;
+  if(m > n) return -1;
+  const C f0 = wstrFold(pat[0]); const size_t last = n - m;
+  auto matchAt = [&](size_t i){
+    for(size_t k = 0; k < m; k++){ C a = hay[i+k], b = pat[k]; if(a != b && wstrFold(a) != wstrFold(b)) return false; }
+    return true;
+  };
+  size_t i = 0;
+#ifdef WSTR_SSE2
+  if constexpr(sizeof(C) == 2){
+    const __m128i vF0 = _mm_set1_epi16((short) f0), vAm1 = _mm_set1_epi16('A'-1), vZp1 = _mm_set1_epi16('Z'+1),
+      v20 = _mm_set1_epi16(0x20), vNonAscii = _mm_set1_epi16((short) 0xFF80), vZero = _mm_setzero_si128();
+    for(; i + 8 <= n && i <= last; i += 8){
+      __m128i v = _mm_loadu_si128((const __m128i *) (hay + i));
+      unsigned mask;
+      if(f0 < 0x80){  // fold A-Z, then exact compare
+        __m128i up = _mm_and_si128(_mm_cmpgt_epi16(v, vAm1), _mm_cmplt_epi16(v, vZp1));
+        mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_or_si128(v, _mm_and_si128(up, v20)), vF0));
+      }
+      else  // any non-ASCII code unit may fold to f0
+        mask = 0xFFFFu & ~(unsigned) _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, vNonAscii), vZero));
+      while(mask){
+        size_t j = i + std::countr_zero(mask)/2;
+        if(j > last) break;
+        if(matchAt(j)) return (ptrdiff_t) j;
+        mask &= mask - 1; mask &= mask - 1;  // both bytes of the code unit
+      }
+    }
+  }
+#endif
+  for(; i <= last; i++) if(wstrFold(hay[i]) == f0 && matchAt(i)) return (ptrdiff_t) i;
+  return -1;
+}
+
+// StrStrIW() : pointer to the first match of needle in hay, nullptr if none
+template <typename C>
+inline const C* wstrStrI(const C *hay, const C *needle){
+  size_t n = 0, m = 0; while(hay[n]) n++; while(needle[m]) m++;
+  ptrdiff_t i = wstrFindI(hay, n, needle, m);
+  return i < 0 ? nullptr : hay + i;
+}
+// 0==StrCmpIW() / 0==lstrcmpiW()
+template <typename C>
+inline bool wstrEqI(const C *a, const C *b){
+  for(; *a && *b; a++, b++) if(*a != *b && wstrFold(*a) != wstrFold(*b)) return false;
+  return *a == *b;
+}